@@ -0,0 +1,166 @@
+#include "BlueNoise.h"
+
+#include <cfloat>
+#include <random>
+
+
+void BlueNoise::generateRanks()
+{
+	const uint32_t numTexels = BLUE_NOISE_SIZE * BLUE_NOISE_SIZE;
+
+	// Energy a point spreads around it, wrapped so that the tile repeats seamlessly
+	splatKernel.resize(numTexels);
+
+	for (uint32_t y = 0; y < BLUE_NOISE_SIZE; y++)
+	{
+		for (uint32_t x = 0; x < BLUE_NOISE_SIZE; x++)
+		{
+			float dx = float(glm::min(x, BLUE_NOISE_SIZE - x));
+			float dy = float(glm::min(y, BLUE_NOISE_SIZE - y));
+			splatKernel[y * BLUE_NOISE_SIZE + x] = exp(-(dx * dx + dy * dy) / (2 * BLUE_NOISE_SIGMA * BLUE_NOISE_SIGMA));
+		}
+	}
+
+	energy.assign(numTexels, 0);
+	pattern.assign(numTexels, false);
+
+	// Fixed seed, the same tile every run
+	std::mt19937 generator(0);
+	std::uniform_int_distribution<uint32_t> distribution(0, numTexels - 1);
+	uint32_t numInitial = uint32_t(numTexels * BLUE_NOISE_INITIAL_DENSITY);
+
+	for (uint32_t i = 0; i < numInitial; )
+	{
+		uint32_t texel = distribution(generator);
+
+		if (!pattern[texel])
+		{
+			splat(texel, 1);
+			i++;
+		}
+	}
+
+	// Move points out of the tightest clusters into the largest voids until it is evenly spread
+	while (true)
+	{
+		uint32_t cluster = findTightestCluster();
+		splat(cluster, -1);
+		uint32_t emptiest = findLargestVoid();
+		splat(emptiest, 1);
+
+		if (emptiest == cluster)
+			break;
+	}
+
+	std::vector<float> initialEnergy = energy;
+	std::vector<bool> initialPattern = pattern;
+	std::vector<uint32_t> rankOrder(numTexels);
+
+	// Points of the initial pattern, ranked from the last removed one down
+	for (uint32_t rank = numInitial; rank > 0; rank--)
+	{
+		uint32_t cluster = findTightestCluster();
+		splat(cluster, -1);
+		rankOrder[cluster] = rank - 1;
+	}
+
+	energy = initialEnergy;
+	pattern = initialPattern;
+
+	// Then every other texel, in the order the largest voids get filled
+	for (uint32_t rank = numInitial; rank < numTexels; rank++)
+	{
+		uint32_t emptiest = findLargestVoid();
+		splat(emptiest, 1);
+		rankOrder[emptiest] = rank;
+	}
+
+	ranks.resize(numTexels);
+
+	for (uint32_t i = 0; i < numTexels; i++)
+	{
+		ranks[i] = (rankOrder[i] + 0.5f) / numTexels;
+	}
+
+	splatKernel.clear();
+	energy.clear();
+	pattern.clear();
+}
+
+void BlueNoise::splat(uint32_t texel, float sign)
+{
+	uint32_t texelX = texel % BLUE_NOISE_SIZE;
+	uint32_t texelY = texel / BLUE_NOISE_SIZE;
+
+	for (uint32_t y = 0; y < BLUE_NOISE_SIZE; y++)
+	{
+		uint32_t dy = (y + BLUE_NOISE_SIZE - texelY) % BLUE_NOISE_SIZE;
+
+		for (uint32_t x = 0; x < BLUE_NOISE_SIZE; x++)
+		{
+			uint32_t dx = (x + BLUE_NOISE_SIZE - texelX) % BLUE_NOISE_SIZE;
+			energy[y * BLUE_NOISE_SIZE + x] += sign * splatKernel[dy * BLUE_NOISE_SIZE + dx];
+		}
+	}
+
+	pattern[texel] = sign > 0;
+}
+
+uint32_t BlueNoise::findTightestCluster() const
+{
+	uint32_t cluster = 0;
+	float maxEnergy = -1;
+
+	for (uint32_t i = 0; i < energy.size(); i++)
+	{
+		if (pattern[i] && energy[i] > maxEnergy)
+		{
+			maxEnergy = energy[i];
+			cluster = i;
+		}
+	}
+
+	return cluster;
+}
+
+uint32_t BlueNoise::findLargestVoid() const
+{
+	uint32_t emptiest = 0;
+	float minEnergy = FLT_MAX;
+
+	for (uint32_t i = 0; i < energy.size(); i++)
+	{
+		if (!pattern[i] && energy[i] < minEnergy)
+		{
+			minEnergy = energy[i];
+			emptiest = i;
+		}
+	}
+
+	return emptiest;
+}
+
+// Every layer shifts the values by the same amount: each one is blue noise on its own and,
+// over the cycle, every texel walks through values spread as evenly as possible
+void BlueNoise::computeTexels()
+{
+	texels.resize(2 * BLUE_NOISE_LAYERS * ranks.size());
+
+	for (uint32_t layer = 0; layer < BLUE_NOISE_LAYERS; layer++)
+	{
+		for (uint32_t i = 0; i < ranks.size(); i++)
+		{
+			float value = glm::fract(ranks[i] + layer * BLUE_NOISE_LAYER_OFFSET);
+			float angle = 2 * glm::pi<float>() * value;
+			size_t texel = layer * ranks.size() + i;
+
+			texels[2 * texel] = int8_t(glm::round(cos(angle) * 127));
+			texels[2 * texel + 1] = int8_t(glm::round(sin(angle) * 127));
+		}
+	}
+}
+
+void BlueNoise::loadTexture()
+{
+	texture = new Texture((void*)texels.data(), BLUE_NOISE_SIZE, BLUE_NOISE_SIZE * BLUE_NOISE_LAYERS, VK_FORMAT_R8G8_SNORM);
+}
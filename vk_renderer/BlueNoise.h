@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+
+#include "Texture.h"
+
+
+#define BLUE_NOISE_SIZE		64
+// Tiles stacked vertically in the texture, one per frame of a cycle
+#define BLUE_NOISE_LAYERS	16
+// Standard deviation of the energy each point spreads around it, in texels
+#define BLUE_NOISE_SIGMA	1.5f
+// Fraction of the tile set in the initial binary pattern
+#define BLUE_NOISE_INITIAL_DENSITY	0.1f
+// Inverse of the golden ratio, each layer offsets the whole tile by it so that consecutive frames stay far apart
+#define BLUE_NOISE_LAYER_OFFSET	0.61803399f
+
+
+// Void-and-cluster blue noise, generated once and shared by the passes that jitter their samples with it.
+// Each texel of an R8G8_SNORM layer holds the unit direction whose angle is the noise value, so that it can rotate
+// kernels as is and still give back a uniform scalar with atan
+class BlueNoise {
+public:
+	BlueNoise()
+	{
+		generateRanks();
+		computeTexels();
+		loadTexture();
+	}
+	~BlueNoise() { delete texture; }
+
+	Texture* getTexture() { return texture; }
+
+private:
+	// Order in which the void-and-cluster process filled each texel, normalized to [0, 1)
+	std::vector<float> ranks;
+	std::vector<int8_t> texels;
+	Texture* texture;
+
+	// Working state of the generation
+	std::vector<float> splatKernel;
+	std::vector<float> energy;
+	std::vector<bool> pattern;
+
+	void generateRanks();
+	void computeTexels();
+	void loadTexture();
+
+	void splat(uint32_t texel, float sign);
+	uint32_t findTightestCluster() const;
+	uint32_t findLargestVoid() const;
+};
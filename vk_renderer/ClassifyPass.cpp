@@ -0,0 +1,389 @@
+#include "ClassifyPass.h"
+
+#include "VkPool.h"
+#include "VkUtils.h"
+
+
+// Compute-only: no attachments, framebuffers or mesh resources
+void ClassifyPass::initLayouts()
+{
+	initDescriptorSetLayout();
+}
+
+void ClassifyPass::initPipelines()
+{
+	initComputePipeline();
+}
+
+void ClassifyPass::initResources()
+{
+	initUniformBuffer();
+	initDescriptorSets();
+	initCommandBuffers();
+	// Constant for the pass' lifetime, and a swapchain recreation does not run initBufferData
+	loadInfoUniforms();
+}
+
+void ClassifyPass::initComputePipeline()
+{
+	std::vector<char> cs = readFile(csPath);
+
+	PipelineData pipelineData = VkEngine::getEngine().getPool()->createComputePipeline(descriptorSetLayout, cs);
+
+	pipeline = pipelineData.pipeline;
+	pipelineLayout = pipelineData.pipelineLayout;
+}
+
+void ClassifyPass::initCommandBuffers()
+{
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = VkEngine::getEngine().getCommandPool();
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = 1;
+
+	VK_CHECK(vkAllocateCommandBuffers(VkEngine::getEngine().getDevice(), &allocInfo, &commandBuffer));
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+	beginInfo.pInheritanceInfo = nullptr;
+
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+	// Last frame's consumers must be done with the lists before they are reset
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0,
+		0,
+		nullptr,
+		0,
+		nullptr,
+		0,
+		nullptr);
+
+	// Empty lists: no workgroup along x until segments are appended
+	uint32_t emptyDispatch[] = { 0, 1, 1 };
+
+	vkCmdFillBuffer(commandBuffer, segmentFlagsBuffer, 0, VK_WHOLE_SIZE, 0);
+	vkCmdUpdateBuffer(commandBuffer, tiles.sssWorkBuffers[0], 0, sizeof(emptyDispatch), emptyDispatch);
+	vkCmdUpdateBuffer(commandBuffer, tiles.sssWorkBuffers[1], 0, sizeof(emptyDispatch), emptyDispatch);
+
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0,
+		1,
+		&barrier,
+		0,
+		nullptr,
+		0,
+		nullptr);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(
+		commandBuffer,
+		VK_PIPELINE_BIND_POINT_COMPUTE,
+		pipelineLayout,
+		0,
+		1,
+		&descriptorSets[0],
+		0,
+		nullptr);
+
+	VkExtent2D extent = VkEngine::getEngine().getSwapchainExtent();
+
+	vkCmdDispatch(
+		commandBuffer, 
+		(extent.width + CLASSIFY_TILE_SIZE - 1) / CLASSIFY_TILE_SIZE, 
+		(extent.height + CLASSIFY_TILE_SIZE - 1) / CLASSIFY_TILE_SIZE, 
+		1);
+
+	// Classes are read by the lighting fragments, lists by the SSS dispatches themselves
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		0,
+		1,
+		&barrier,
+		0,
+		nullptr,
+		0,
+		nullptr);
+
+	VK_CHECK(vkEndCommandBuffer(commandBuffer));
+}
+
+void ClassifyPass::initDescriptorSets()
+{
+	descriptorSets.resize(1);
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = VkEngine::getEngine().getDescriptorPool();
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &descriptorSetLayout;
+
+	VK_CHECK(vkAllocateDescriptorSets(VkEngine::getEngine().getDevice(), &allocInfo, &descriptorSets[0]));
+
+	uint32_t bindingIndex = 0;
+
+	std::vector<VkWriteDescriptorSet> descriptorWrites;
+
+	VkDescriptorImageInfo stencilImageInfo = {};
+	stencilImageInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	stencilImageInfo.imageView = gBuffer->attachments[GBUFFER_DEPTH_ATTACH_ID].stencilView;
+	stencilImageInfo.sampler = gBuffer->attachments[GBUFFER_DEPTH_ATTACH_ID].imageSampler;
+
+	VkWriteDescriptorSet stencilDescriptorSet = {};
+	stencilDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	stencilDescriptorSet.dstSet = descriptorSets[0];
+	stencilDescriptorSet.dstBinding = bindingIndex++;
+	stencilDescriptorSet.dstArrayElement = 0;
+	stencilDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	stencilDescriptorSet.descriptorCount = 1;
+	stencilDescriptorSet.pImageInfo = &stencilImageInfo;
+
+	descriptorWrites.push_back(stencilDescriptorSet);
+
+	VkDescriptorImageInfo materialImageInfo = {};
+	materialImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	materialImageInfo.imageView = gBuffer->attachments[GBUFFER_MATERIAL_ATTACH_ID].imageView;
+	materialImageInfo.sampler = gBuffer->attachments[GBUFFER_MATERIAL_ATTACH_ID].imageSampler;
+
+	VkWriteDescriptorSet materialDescriptorSet = {};
+	materialDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	materialDescriptorSet.dstSet = descriptorSets[0];
+	materialDescriptorSet.dstBinding = bindingIndex++;
+	materialDescriptorSet.dstArrayElement = 0;
+	materialDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	materialDescriptorSet.descriptorCount = 1;
+	materialDescriptorSet.pImageInfo = &materialImageInfo;
+
+	descriptorWrites.push_back(materialDescriptorSet);
+
+	VkDescriptorBufferInfo infoBufferInfo = {};
+	infoBufferInfo.buffer = infoUniformBuffer;
+	infoBufferInfo.offset = 0;
+	infoBufferInfo.range = sizeof(CLPInfoUniformBufferObject);
+
+	VkWriteDescriptorSet infoDescriptorSet = {};
+	infoDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	infoDescriptorSet.dstSet = descriptorSets[0];
+	infoDescriptorSet.dstBinding = bindingIndex++;
+	infoDescriptorSet.dstArrayElement = 0;
+	infoDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	infoDescriptorSet.descriptorCount = 1;
+	infoDescriptorSet.pBufferInfo = &infoBufferInfo;
+
+	descriptorWrites.push_back(infoDescriptorSet);
+
+	VkDescriptorBufferInfo tileClassesBufferInfo = {};
+	tileClassesBufferInfo.buffer = tiles.tileClassesBuffer;
+	tileClassesBufferInfo.offset = 0;
+	tileClassesBufferInfo.range = tiles.tileClassesBufferSize;
+
+	VkWriteDescriptorSet tileClassesDescriptorSet = {};
+	tileClassesDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	tileClassesDescriptorSet.dstSet = descriptorSets[0];
+	tileClassesDescriptorSet.dstBinding = bindingIndex++;
+	tileClassesDescriptorSet.dstArrayElement = 0;
+	tileClassesDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	tileClassesDescriptorSet.descriptorCount = 1;
+	tileClassesDescriptorSet.pBufferInfo = &tileClassesBufferInfo;
+
+	descriptorWrites.push_back(tileClassesDescriptorSet);
+
+	VkDescriptorBufferInfo horizontalWorkBufferInfo = {};
+	horizontalWorkBufferInfo.buffer = tiles.sssWorkBuffers[0];
+	horizontalWorkBufferInfo.offset = 0;
+	horizontalWorkBufferInfo.range = tiles.sssWorkBufferSizes[0];
+
+	VkWriteDescriptorSet horizontalWorkDescriptorSet = {};
+	horizontalWorkDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	horizontalWorkDescriptorSet.dstSet = descriptorSets[0];
+	horizontalWorkDescriptorSet.dstBinding = bindingIndex++;
+	horizontalWorkDescriptorSet.dstArrayElement = 0;
+	horizontalWorkDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	horizontalWorkDescriptorSet.descriptorCount = 1;
+	horizontalWorkDescriptorSet.pBufferInfo = &horizontalWorkBufferInfo;
+
+	descriptorWrites.push_back(horizontalWorkDescriptorSet);
+
+	VkDescriptorBufferInfo verticalWorkBufferInfo = {};
+	verticalWorkBufferInfo.buffer = tiles.sssWorkBuffers[1];
+	verticalWorkBufferInfo.offset = 0;
+	verticalWorkBufferInfo.range = tiles.sssWorkBufferSizes[1];
+
+	VkWriteDescriptorSet verticalWorkDescriptorSet = {};
+	verticalWorkDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	verticalWorkDescriptorSet.dstSet = descriptorSets[0];
+	verticalWorkDescriptorSet.dstBinding = bindingIndex++;
+	verticalWorkDescriptorSet.dstArrayElement = 0;
+	verticalWorkDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	verticalWorkDescriptorSet.descriptorCount = 1;
+	verticalWorkDescriptorSet.pBufferInfo = &verticalWorkBufferInfo;
+
+	descriptorWrites.push_back(verticalWorkDescriptorSet);
+
+	VkDescriptorBufferInfo segmentFlagsBufferInfo = {};
+	segmentFlagsBufferInfo.buffer = segmentFlagsBuffer;
+	segmentFlagsBufferInfo.offset = 0;
+	segmentFlagsBufferInfo.range = segmentFlagsBufferSize;
+
+	VkWriteDescriptorSet segmentFlagsDescriptorSet = {};
+	segmentFlagsDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	segmentFlagsDescriptorSet.dstSet = descriptorSets[0];
+	segmentFlagsDescriptorSet.dstBinding = bindingIndex++;
+	segmentFlagsDescriptorSet.dstArrayElement = 0;
+	segmentFlagsDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	segmentFlagsDescriptorSet.descriptorCount = 1;
+	segmentFlagsDescriptorSet.pBufferInfo = &segmentFlagsBufferInfo;
+
+	descriptorWrites.push_back(segmentFlagsDescriptorSet);
+
+	vkUpdateDescriptorSets(VkEngine::getEngine().getDevice(), descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
+}
+
+void ClassifyPass::initDescriptorSetLayout()
+{
+	std::vector<VkDescriptorSetLayoutBinding> bindings;
+
+	uint32_t bindingIndex = 0;
+
+	VkDescriptorSetLayoutBinding stencilLayoutBinding = {};
+	stencilLayoutBinding.binding = bindingIndex++;
+	stencilLayoutBinding.descriptorCount = 1;
+	stencilLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	stencilLayoutBinding.pImmutableSamplers = nullptr;
+	stencilLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings.push_back(stencilLayoutBinding);
+
+	VkDescriptorSetLayoutBinding materialLayoutBinding = {};
+	materialLayoutBinding.binding = bindingIndex++;
+	materialLayoutBinding.descriptorCount = 1;
+	materialLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	materialLayoutBinding.pImmutableSamplers = nullptr;
+	materialLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings.push_back(materialLayoutBinding);
+
+	VkDescriptorSetLayoutBinding infoLayoutBinding = {};
+	infoLayoutBinding.binding = bindingIndex++;
+	infoLayoutBinding.descriptorCount = 1;
+	infoLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	infoLayoutBinding.pImmutableSamplers = nullptr;
+	infoLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings.push_back(infoLayoutBinding);
+
+	VkDescriptorSetLayoutBinding tileClassesLayoutBinding = {};
+	tileClassesLayoutBinding.binding = bindingIndex++;
+	tileClassesLayoutBinding.descriptorCount = 1;
+	tileClassesLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	tileClassesLayoutBinding.pImmutableSamplers = nullptr;
+	tileClassesLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings.push_back(tileClassesLayoutBinding);
+
+	VkDescriptorSetLayoutBinding horizontalWorkLayoutBinding = {};
+	horizontalWorkLayoutBinding.binding = bindingIndex++;
+	horizontalWorkLayoutBinding.descriptorCount = 1;
+	horizontalWorkLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	horizontalWorkLayoutBinding.pImmutableSamplers = nullptr;
+	horizontalWorkLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings.push_back(horizontalWorkLayoutBinding);
+
+	VkDescriptorSetLayoutBinding verticalWorkLayoutBinding = {};
+	verticalWorkLayoutBinding.binding = bindingIndex++;
+	verticalWorkLayoutBinding.descriptorCount = 1;
+	verticalWorkLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	verticalWorkLayoutBinding.pImmutableSamplers = nullptr;
+	verticalWorkLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings.push_back(verticalWorkLayoutBinding);
+
+	VkDescriptorSetLayoutBinding segmentFlagsLayoutBinding = {};
+	segmentFlagsLayoutBinding.binding = bindingIndex++;
+	segmentFlagsLayoutBinding.descriptorCount = 1;
+	segmentFlagsLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	segmentFlagsLayoutBinding.pImmutableSamplers = nullptr;
+	segmentFlagsLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings.push_back(segmentFlagsLayoutBinding);
+
+	descriptorSetLayout = VkEngine::getEngine().getPool()->createDescriptorSetLayout(bindings);
+}
+
+void ClassifyPass::initUniformBuffer()
+{
+	VkExtent2D extent = VkEngine::getEngine().getSwapchainExtent();
+	uint32_t numTiles = 
+		((extent.width + CLASSIFY_TILE_SIZE - 1) / CLASSIFY_TILE_SIZE) * 
+		((extent.height + CLASSIFY_TILE_SIZE - 1) / CLASSIFY_TILE_SIZE);
+
+	// The blurs work at their own resolution, lists are sized for every segment of it
+	uint32_t sssWidth = (extent.width + sssDownsample - 1) / sssDownsample;
+	uint32_t sssHeight = (extent.height + sssDownsample - 1) / sssDownsample;
+	uint32_t numSegments[] = {
+		((sssWidth + CLASSIFY_SSS_SEGMENT_SIZE - 1) / CLASSIFY_SSS_SEGMENT_SIZE) * sssHeight,
+		((sssHeight + CLASSIFY_SSS_SEGMENT_SIZE - 1) / CLASSIFY_SSS_SEGMENT_SIZE) * sssWidth
+	};
+
+	tiles.tileClassesBufferSize = sizeof(uint32_t) * numTiles;
+
+	std::vector<BufferData> tileClassesBufferDataVec = VkEngine::getEngine().getPool()->createStorageBuffer(tiles.tileClassesBufferSize, false);
+	tiles.tileClassesBuffer = tileClassesBufferDataVec[0].buffer;
+
+	for (size_t i = 0; i < 2; i++)
+	{
+		// Dispatch arguments are padded to the alignment of the pairs that follow
+		tiles.sssWorkBufferSizes[i] = 4 * sizeof(uint32_t) + 2 * sizeof(uint32_t) * numSegments[i];
+
+		std::vector<BufferData> workBufferDataVec = VkEngine::getEngine().getPool()->createStorageBuffer(tiles.sssWorkBufferSizes[i], false, true);
+		tiles.sssWorkBuffers[i] = workBufferDataVec[0].buffer;
+	}
+
+	segmentFlagsBufferSize = sizeof(uint32_t) * (numSegments[0] + numSegments[1]);
+
+	std::vector<BufferData> segmentFlagsBufferDataVec = VkEngine::getEngine().getPool()->createStorageBuffer(segmentFlagsBufferSize, false);
+	segmentFlagsBuffer = segmentFlagsBufferDataVec[0].buffer;
+
+	VkDeviceSize infoBufferSize = sizeof(CLPInfoUniformBufferObject);
+
+	std::vector<BufferData> infoBufferDataVec = VkEngine::getEngine().getPool()->createUniformBuffer(infoBufferSize, true);
+	infoUniformStagingBuffer = infoBufferDataVec[0].buffer;
+	infoUniformStagingBufferMemory = infoBufferDataVec[0].bufferMemory;
+	infoUniformBuffer = infoBufferDataVec[1].buffer;
+	infoUniformBufferMemory = infoBufferDataVec[1].bufferMemory;
+}
+
+void ClassifyPass::loadInfoUniforms()
+{
+	CLPInfoUniformBufferObject ubo = {};
+	ubo.sssDownsample = sssDownsample;
+
+	updateBuffer(
+		VkEngine::getEngine().getDevice(),
+		VkEngine::getEngine().getCommandPool(),
+		VkEngine::getEngine().getGraphicsQueue(),
+		&ubo,
+		sizeof(ubo),
+		infoUniformStagingBufferMemory,
+		infoUniformBuffer,
+		infoUniformStagingBuffer);
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Pass.h"
+#include "Scene.h"
+
+
+#define CLASSIFY_TILE_SIZE		16
+#define TILE_CLASS_BACKGROUND	0
+#define TILE_CLASS_OPAQUE		1
+// At least one pixel has a subsurface width, transmittance has to be evaluated
+#define TILE_CLASS_TRANSLUCENT	2
+// Length of the pixel runs SSS workgroups blur, must match SS_TILE_SIZE
+#define CLASSIFY_SSS_SEGMENT_SIZE	128
+
+
+struct CLPInfoUniformBufferObject {
+	int sssDownsample;
+};
+
+// Buffers shared with the passes that only run where the classification says they have to
+struct TileClassification {
+	VkBuffer tileClassesBuffer;
+	VkDeviceSize tileClassesBufferSize;
+	// Per blur direction (horizontal first): indirect dispatch arguments followed by the (segment, run) pairs to blur
+	VkBuffer sssWorkBuffers[2];
+	VkDeviceSize sssWorkBufferSizes[2];
+};
+
+
+class ClassifyPass : public Pass {
+public:
+	// sssDownsample is the reduced resolution factor the SSS blurs run at
+	ClassifyPass(std::string csPath, GBuffer* gBuffer, uint32_t sssDownsample) :
+		csPath(csPath), gBuffer(gBuffer), sssDownsample(sssDownsample) { }
+	~ClassifyPass() { }
+
+	virtual void initLayouts() override;
+	virtual void initPipelines() override;
+	virtual void initResources() override;
+
+	VkCommandBuffer getCurrentCmdBuffer() const { return commandBuffer; }
+	TileClassification* getTiles() { return &tiles; }
+
+private:
+	std::string csPath;
+
+	VkCommandBuffer commandBuffer;
+	GBuffer* gBuffer;
+	uint32_t sssDownsample;
+	TileClassification tiles;
+
+	// One flag per (segment, run) of each blur direction, so that a segment is listed only once
+	VkBuffer segmentFlagsBuffer;
+	VkDeviceSize segmentFlagsBufferSize;
+	VkBuffer infoUniformStagingBuffer;
+	VkDeviceMemory infoUniformStagingBufferMemory;
+	VkBuffer infoUniformBuffer;
+	VkDeviceMemory infoUniformBufferMemory;
+
+	virtual void initAttachments() override { /*NOP*/ }
+	virtual void initCommandBuffers() override;
+	virtual void initDescriptorSets() override;
+	virtual void initDescriptorSetLayout() override;
+	virtual void initGraphicsPipeline() override { /*NOP*/ }
+	virtual void initUniformBuffer() override;
+
+	void initComputePipeline();
+	void loadInfoUniforms();
+};
\ No newline at end of file
@@ -0,0 +1,295 @@
+#include "ClusterPass.h"
+
+#include "Camera.h"
+#include "ShadowPass.h"
+#include "VkPool.h"
+#include "VkUtils.h"
+
+
+// Compute-only: no attachments, framebuffers or mesh resources
+void ClusterPass::initLayouts()
+{
+	initDescriptorSetLayout();
+}
+
+void ClusterPass::initPipelines()
+{
+	initComputePipeline();
+}
+
+void ClusterPass::initResources()
+{
+	initUniformBuffer();
+	initDescriptorSets();
+	initCommandBuffers();
+	// Lights are static, and a swapchain recreation builds a new pass without running initBufferData
+	loadLights();
+}
+
+void ClusterPass::initComputePipeline()
+{
+	std::string csPath = this->csPath;
+	VkDescriptorSetLayout descriptorSetLayout = this->descriptorSetLayout;
+
+	pipelinePermutations = PipelinePermutations([csPath, descriptorSetLayout](const SpecializationConstants& constants)
+	{
+		return VkEngine::getEngine().getPool()->createComputePipeline(descriptorSetLayout, readFile(csPath), constants);
+	});
+
+	PipelineData pipelineData = pipelinePermutations.get({ lightsPerCluster });
+
+	pipeline = pipelineData.pipeline;
+	pipelineLayout = pipelineData.pipelineLayout;
+}
+
+// The grid is rebuilt every frame, so the next one already shades with the new cap
+void ClusterPass::setLightsPerCluster(uint32_t lightsPerCluster)
+{
+	lightsPerCluster = glm::min(lightsPerCluster, uint32_t(MAX_LIGHTS_PER_CLUSTER));
+
+	if (lightsPerCluster == this->lightsPerCluster)
+		return;
+
+	// The previous recording may still be in flight
+	vkQueueWaitIdle(VkEngine::getEngine().getGraphicsQueue());
+	vkFreeCommandBuffers(
+		VkEngine::getEngine().getDevice(),
+		VkEngine::getEngine().getCommandPool(),
+		1,
+		&commandBuffer);
+
+	this->lightsPerCluster = lightsPerCluster;
+
+	PipelineData pipelineData = pipelinePermutations.get({ lightsPerCluster });
+
+	pipeline = pipelineData.pipeline;
+	pipelineLayout = pipelineData.pipelineLayout;
+
+	initCommandBuffers();
+}
+
+void ClusterPass::initCommandBuffers()
+{
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = VkEngine::getEngine().getCommandPool();
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = 1;
+
+	VK_CHECK(vkAllocateCommandBuffers(VkEngine::getEngine().getDevice(), &allocInfo, &commandBuffer));
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+	beginInfo.pInheritanceInfo = nullptr;
+
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+	vkCmdBindDescriptorSets(
+		commandBuffer,
+		VK_PIPELINE_BIND_POINT_COMPUTE,
+		pipelineLayout,
+		0,
+		1,
+		&descriptorSets[0],
+		0,
+		nullptr);
+
+	vkCmdDispatch(commandBuffer, (NUM_CLUSTERS + CLUSTER_WORKGROUP_SIZE - 1) / CLUSTER_WORKGROUP_SIZE, 1, 1);
+
+	// Light lists have to be complete before any fragment shader walks them
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = grid.clustersBuffer;
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		0,
+		0,
+		nullptr,
+		1,
+		&barrier,
+		0,
+		nullptr);
+
+	VK_CHECK(vkEndCommandBuffer(commandBuffer));
+}
+
+void ClusterPass::initDescriptorSets()
+{
+	descriptorSets.resize(1);
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = VkEngine::getEngine().getDescriptorPool();
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &descriptorSetLayout;
+
+	VK_CHECK(vkAllocateDescriptorSets(VkEngine::getEngine().getDevice(), &allocInfo, &descriptorSets[0]));
+
+	std::vector<VkWriteDescriptorSet> descriptorWrites;
+
+	VkDescriptorBufferInfo lightsBufferInfo = {};
+	lightsBufferInfo.buffer = grid.lightsBuffer;
+	lightsBufferInfo.offset = 0;
+	lightsBufferInfo.range = grid.lightsBufferSize;
+
+	VkWriteDescriptorSet lightsDescriptorSet = {};
+	lightsDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	lightsDescriptorSet.dstSet = descriptorSets[0];
+	lightsDescriptorSet.dstBinding = 0;
+	lightsDescriptorSet.dstArrayElement = 0;
+	lightsDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	lightsDescriptorSet.descriptorCount = 1;
+	lightsDescriptorSet.pBufferInfo = &lightsBufferInfo;
+
+	descriptorWrites.push_back(lightsDescriptorSet);
+
+	VkDescriptorBufferInfo clustersBufferInfo = {};
+	clustersBufferInfo.buffer = grid.clustersBuffer;
+	clustersBufferInfo.offset = 0;
+	clustersBufferInfo.range = grid.clustersBufferSize;
+
+	VkWriteDescriptorSet clustersDescriptorSet = {};
+	clustersDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	clustersDescriptorSet.dstSet = descriptorSets[0];
+	clustersDescriptorSet.dstBinding = 1;
+	clustersDescriptorSet.dstArrayElement = 0;
+	clustersDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	clustersDescriptorSet.descriptorCount = 1;
+	clustersDescriptorSet.pBufferInfo = &clustersBufferInfo;
+
+	descriptorWrites.push_back(clustersDescriptorSet);
+
+	VkDescriptorBufferInfo cameraBufferInfo = {};
+	cameraBufferInfo.buffer = cameraUniformBuffer;
+	cameraBufferInfo.offset = 0;
+	cameraBufferInfo.range = sizeof(CPCameraUniformBufferObject);
+
+	VkWriteDescriptorSet cameraDescriptorSet = {};
+	cameraDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	cameraDescriptorSet.dstSet = descriptorSets[0];
+	cameraDescriptorSet.dstBinding = 2;
+	cameraDescriptorSet.dstArrayElement = 0;
+	cameraDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	cameraDescriptorSet.descriptorCount = 1;
+	cameraDescriptorSet.pBufferInfo = &cameraBufferInfo;
+
+	descriptorWrites.push_back(cameraDescriptorSet);
+
+	vkUpdateDescriptorSets(VkEngine::getEngine().getDevice(), descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
+}
+
+void ClusterPass::initDescriptorSetLayout()
+{
+	std::vector<VkDescriptorSetLayoutBinding> bindings(3);
+
+	VkDescriptorSetLayoutBinding lightsLayoutBinding = {};
+	lightsLayoutBinding.binding = 0;
+	lightsLayoutBinding.descriptorCount = 1;
+	lightsLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	lightsLayoutBinding.pImmutableSamplers = nullptr;
+	lightsLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings[0] = lightsLayoutBinding;
+
+	VkDescriptorSetLayoutBinding clustersLayoutBinding = {};
+	clustersLayoutBinding.binding = 1;
+	clustersLayoutBinding.descriptorCount = 1;
+	clustersLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	clustersLayoutBinding.pImmutableSamplers = nullptr;
+	clustersLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings[1] = clustersLayoutBinding;
+
+	VkDescriptorSetLayoutBinding cameraLayoutBinding = {};
+	cameraLayoutBinding.binding = 2;
+	cameraLayoutBinding.descriptorCount = 1;
+	cameraLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	cameraLayoutBinding.pImmutableSamplers = nullptr;
+	cameraLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings[2] = cameraLayoutBinding;
+
+	descriptorSetLayout = VkEngine::getEngine().getPool()->createDescriptorSetLayout(bindings);
+}
+
+void ClusterPass::initUniformBuffer()
+{
+	// Never zero-sized, so that an empty scene still gets a valid descriptor
+	size_t numLights = MAX(VkEngine::getEngine().getScene()->getLights().size(), (size_t) 1);
+	grid.lightsBufferSize = sizeof(CPShaderLight) * numLights;
+	grid.clustersBufferSize = sizeof(CPClusterData) * NUM_CLUSTERS;
+
+	std::vector<BufferData> lightsBufferDataVec = VkEngine::getEngine().getPool()->createStorageBuffer(grid.lightsBufferSize, true);
+	lightsStagingBuffer = lightsBufferDataVec[0].buffer;
+	lightsStagingBufferMemory = lightsBufferDataVec[0].bufferMemory;
+	grid.lightsBuffer = lightsBufferDataVec[1].buffer;
+
+	std::vector<BufferData> clustersBufferDataVec = VkEngine::getEngine().getPool()->createStorageBuffer(grid.clustersBufferSize, false);
+	grid.clustersBuffer = clustersBufferDataVec[0].buffer;
+
+	VkDeviceSize cameraBufferSize = sizeof(CPCameraUniformBufferObject);
+
+	std::vector<BufferData> cameraBufferDataVec = VkEngine::getEngine().getPool()->createUniformBuffer(cameraBufferSize, true);
+	cameraUniformStagingBuffer = cameraBufferDataVec[0].buffer;
+	cameraUniformStagingBufferMemory = cameraBufferDataVec[0].bufferMemory;
+	cameraUniformBuffer = cameraBufferDataVec[1].buffer;
+	cameraUniformBufferMemory = cameraBufferDataVec[1].bufferMemory;
+}
+
+void ClusterPass::loadLights()
+{
+	std::vector<Light*> lights = VkEngine::getEngine().getScene()->getLights();
+	std::vector<CPShaderLight> shaderLights(MAX(lights.size(), (size_t) 1));
+
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		shaderLights[i].pos = glm::vec4(lights[i]->position, lights[i]->getRadius());
+		shaderLights[i].ke = glm::vec4(lights[i]->intensity, i < MAX_NUM_SHADOWED_LIGHTS ? (float) i : -1.f);
+	}
+
+	updateBuffer(
+		VkEngine::getEngine().getDevice(),
+		VkEngine::getEngine().getCommandPool(),
+		VkEngine::getEngine().getGraphicsQueue(),
+		shaderLights.data(),
+		grid.lightsBufferSize,
+		lightsStagingBufferMemory,
+		grid.lightsBuffer,
+		lightsStagingBuffer);
+}
+
+void ClusterPass::initBufferData()
+{
+	updateBufferData();
+}
+
+void ClusterPass::updateBufferData()
+{
+	Camera* camera = VkEngine::getEngine().getScene()->getCamera();
+
+	CPCameraUniformBufferObject ubo = {};
+	ubo.view = camera->getViewMatrix();
+	ubo.invProj = glm::inverse(camera->getProjMatrix());
+	ubo.numLights = VkEngine::getEngine().getScene()->getLights().size();
+
+	updateBuffer(
+		VkEngine::getEngine().getDevice(),
+		VkEngine::getEngine().getCommandPool(),
+		VkEngine::getEngine().getGraphicsQueue(),
+		&ubo,
+		sizeof(ubo),
+		cameraUniformStagingBufferMemory,
+		cameraUniformBuffer,
+		cameraUniformStagingBuffer);
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vector>
+
+#include "Light.h"
+#include "Pass.h"
+#include "Scene.h"
+#include "VkPool.h"
+
+
+#define CLUSTER_GRID_X			16
+#define CLUSTER_GRID_Y			9
+#define CLUSTER_GRID_Z			24
+#define NUM_CLUSTERS			(CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z)
+#define MAX_LIGHTS_PER_CLUSTER	128
+#define CLUSTER_WORKGROUP_SIZE	64
+
+
+struct CPShaderLight {
+	// w: range derived from intensity
+	glm::vec4 pos;
+	// w: index into the shadow atlas, -1 if unshadowed
+	glm::vec4 ke;
+};
+
+struct CPClusterData {
+	uint32_t numLights;
+	uint32_t lightIndices[MAX_LIGHTS_PER_CLUSTER];
+};
+
+struct CPCameraUniformBufferObject {
+	glm::mat4 view;
+	glm::mat4 invProj;
+	int numLights;
+};
+
+// Buffers shared with the passes that shade through the cluster grid
+struct ClusterGrid {
+	VkBuffer lightsBuffer;
+	VkDeviceSize lightsBufferSize;
+	VkBuffer clustersBuffer;
+	VkDeviceSize clustersBufferSize;
+};
+
+
+class ClusterPass : public Pass {
+public:
+	// The shader is specialized with how many lights each cluster keeps, up to MAX_LIGHTS_PER_CLUSTER
+	ClusterPass(std::string csPath, uint32_t lightsPerCluster = MAX_LIGHTS_PER_CLUSTER) : 
+		csPath(csPath), lightsPerCluster(glm::min(lightsPerCluster, uint32_t(MAX_LIGHTS_PER_CLUSTER))) { }
+	~ClusterPass() { }
+
+	virtual void initLayouts() override;
+	virtual void initPipelines() override;
+	virtual void initResources() override;
+	virtual void initBufferData() override;
+	virtual void updateBufferData() override;
+
+	VkCommandBuffer getCurrentCmdBuffer() const { return commandBuffer; }
+	ClusterGrid* getGrid() { return &grid; }
+	void setLightsPerCluster(uint32_t lightsPerCluster);
+
+private:
+	std::string csPath;
+
+	VkCommandBuffer commandBuffer;
+	ClusterGrid grid;
+	uint32_t lightsPerCluster;
+	PipelinePermutations pipelinePermutations;
+
+	VkBuffer lightsStagingBuffer;
+	VkDeviceMemory lightsStagingBufferMemory;
+	VkBuffer cameraUniformStagingBuffer;
+	VkDeviceMemory cameraUniformStagingBufferMemory;
+	VkBuffer cameraUniformBuffer;
+	VkDeviceMemory cameraUniformBufferMemory;
+
+	virtual void initAttachments() override { /*NOP*/ }
+	virtual void initCommandBuffers() override;
+	virtual void initDescriptorSets() override;
+	virtual void initDescriptorSetLayout() override;
+	virtual void initGraphicsPipeline() override { /*NOP*/ }
+	virtual void initUniformBuffer() override;
+
+	void initComputePipeline();
+	void loadLights();
+};
\ No newline at end of file
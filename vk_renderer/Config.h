@@ -1,5 +1,10 @@
 #pragma once
 
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include "glm\glm.hpp"
@@ -7,6 +12,46 @@
 #define DEFAULT_WINDOW_WIDTH	1920
 #define DEFAULT_WINDOW_HEIGHT	1080
 #define DEFAULT_SCENE_PATH		"data/head_2/scene.json"
+#define DEFAULT_SHADOW_ATLAS_SIZE	4096
+#define DEFAULT_SHADOW_PCF_RADIUS	1
+#define DEFAULT_AO_DOWNSAMPLE		1
+
+
+// Main-pass implementations of SSAOPass, in the order of AO_ALGORITHM_NAMES
+enum AOAlgorithm {
+	AO_CRYSIS,
+	AO_HBAO,
+	AO_GTAO,
+	AO_NUM_ALGORITHMS
+};
+
+static const char* const AO_ALGORITHM_NAMES[AO_NUM_ALGORITHMS] = { "crysis", "hbao", "gtao" };
+
+// Sample counts and loop bounds the shaders are specialized with, in the order of QUALITY_PRESET_NAMES
+enum QualityPreset {
+	QUALITY_LOW,
+	QUALITY_MEDIUM,
+	QUALITY_HIGH,
+	NUM_QUALITY_PRESETS
+};
+
+static const char* const QUALITY_PRESET_NAMES[NUM_QUALITY_PRESETS] = { "low", "medium", "high" };
+
+struct QualitySettings {
+	// Samples of the Crysis SSAO kernel, up to SSAO_MAX_KERNEL_SIZE
+	uint32_t aoKernelSize;
+	// Taps of each SSS blur direction, odd and up to SS_MAX_SAMPLES
+	uint32_t sssSamples;
+	// Lights the cluster pass keeps per cluster, up to MAX_LIGHTS_PER_CLUSTER
+	uint32_t lightsPerCluster;
+};
+
+static const QualitySettings QUALITY_SETTINGS[NUM_QUALITY_PRESETS] = {
+	{ 8, 11, 32 },
+	{ 16, 17, 128 },
+	{ 32, 25, 128 }
+};
+
 
 struct Config {
 public:
@@ -16,6 +61,24 @@ public:
 	glm::ivec2 resolution;
 	bool fullscreen;
 	std::string scenePath;
+	bool depthPrePass;
+	uint32_t shadowAtlasSize;
+	int shadowPCFRadius;
+	// Accumulate point lights with screen-fitted volumes instead of the clustered full-screen pass
+	bool lightVolumes;
+	// Run the SSS blurs at half resolution and upsample them bilaterally when merging
+	bool halfResSSS;
+	// Compute and blur SSAO this many times smaller on each axis (1, 2 or 4), the lighting pass upsamples it
+	uint32_t aoDownsample;
+	// Spread the SSAO kernel over several frames, blending each one into the reprojected result of the previous ones
+	bool temporalAO;
+	AOAlgorithm aoAlgorithm;
+	// Render a camera orbit with every AO algorithm in turn, report their GPU times and quit
+	bool aoBenchmark;
+	QualityPreset quality;
+	// Sample material textures from one descriptor indexing array and read the materials from a storage buffer,
+	// so that the geometry pass binds a single descriptor set. Ignored on devices without descriptor indexing
+	bool bindlessTextures;
 
 	void parseCmdLineArgs(int argc, char** argv)
 	{
@@ -26,12 +89,40 @@ public:
 			resolution = parseResolution(args);
 			fullscreen = parseFlag(args, "-f");
 			scenePath = parseOption(args, "-s");
+			depthPrePass = !parseFlag(args, "-nz");
+
+			std::string sAtlasSize = parseOption(args, "-a");
+			shadowAtlasSize = sAtlasSize.empty() ? DEFAULT_SHADOW_ATLAS_SIZE : std::atoi(sAtlasSize.c_str());
+
+			std::string sPCFRadius = parseOption(args, "-pcf");
+			shadowPCFRadius = sPCFRadius.empty() ? DEFAULT_SHADOW_PCF_RADIUS : std::atoi(sPCFRadius.c_str());
+
+			lightVolumes = parseFlag(args, "-lv");
+			halfResSSS = parseFlag(args, "-hs");
+
+			aoDownsample = parseAODownsample(parseOption(args, "-ao"));
+			temporalAO = parseFlag(args, "-tao");
+			aoAlgorithm = parseAOAlgorithm(parseOption(args, "-aoalg"));
+			aoBenchmark = parseFlag(args, "-aob");
+			quality = parseQualityPreset(parseOption(args, "-q"));
+			bindlessTextures = parseFlag(args, "-bl");
 		}
 		else
 		{
 			resolution = { DEFAULT_WINDOW_WIDTH, DEFAULT_WINDOW_HEIGHT };
 			fullscreen = false;
 			scenePath = DEFAULT_SCENE_PATH;
+			depthPrePass = true;
+			shadowAtlasSize = DEFAULT_SHADOW_ATLAS_SIZE;
+			shadowPCFRadius = DEFAULT_SHADOW_PCF_RADIUS;
+			lightVolumes = false;
+			halfResSSS = false;
+			aoDownsample = DEFAULT_AO_DOWNSAMPLE;
+			temporalAO = false;
+			aoAlgorithm = AO_CRYSIS;
+			aoBenchmark = false;
+			quality = QUALITY_MEDIUM;
+			bindlessTextures = false;
 		}
 	}
 
@@ -68,6 +159,46 @@ private:
 		return *(++it);
 	}
 
+	// The SSAO downsample pass only reduces by these factors
+	static uint32_t parseAODownsample(std::string sFactor)
+	{
+		if (sFactor.empty())
+			return DEFAULT_AO_DOWNSAMPLE;
+
+		int factor = std::atoi(sFactor.c_str());
+
+		if (factor != 1 && factor != 2 && factor != 4)
+		{
+			std::cerr << "Unsupported AO downsample factor " << sFactor << ", expected 1, 2 or 4. Using "
+				<< DEFAULT_AO_DOWNSAMPLE << "." << std::endl;
+			return DEFAULT_AO_DOWNSAMPLE;
+		}
+
+		return factor;
+	}
+
+	static AOAlgorithm parseAOAlgorithm(std::string name)
+	{
+		for (int i = 0; i < AO_NUM_ALGORITHMS; i++)
+		{
+			if (name == AO_ALGORITHM_NAMES[i])
+				return (AOAlgorithm) i;
+		}
+
+		return AO_CRYSIS;
+	}
+
+	static QualityPreset parseQualityPreset(std::string name)
+	{
+		for (int i = 0; i < NUM_QUALITY_PRESETS; i++)
+		{
+			if (name == QUALITY_PRESET_NAMES[i])
+				return (QualityPreset) i;
+		}
+
+		return QUALITY_MEDIUM;
+	}
+
 	static bool parseFlag(std::vector<std::string>& args, std::string flag)
 	{
 		return std::find(args.begin(), args.end(), flag) != args.end();
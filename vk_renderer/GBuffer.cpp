@@ -3,7 +3,7 @@
 #include "VkPool.h"
 
 
-void GBuffer::init()
+void GBuffer::init(bool depthPrePass)
 {
 	VkCommandBufferAllocateInfo allocInfo = {};
 	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -35,9 +35,22 @@ void GBuffer::init()
 		switch (attachments[i].type)
 		{
 		case DEPTH:
-			attachmentDescs[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-			attachmentDescs[i].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-			attachmentDescs[i].format = findDepthFormat(VkEngine::getEngine().getPhysicalDevice());
+			// Depth and stencil have already been laid down by the pre-pass
+			if (depthPrePass)
+			{
+				attachmentDescs[i].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+				attachmentDescs[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+				attachmentDescs[i].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			}
+			else
+			{
+				attachmentDescs[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+				attachmentDescs[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			}
+			attachmentDescs[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
+			// Later passes sample depth and stencil, and may depth/stencil test against them
+			attachmentDescs[i].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+			attachmentDescs[i].format = findDepthStencilFormat(VkEngine::getEngine().getPhysicalDevice());
 			break;
 		case NORMAL:
 		case TANGENT:
@@ -84,11 +97,21 @@ void GBuffer::init()
 	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 	dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
+	if (depthPrePass)
+	{
+		// Depth tests must see the pre-pass writes
+		dependencies[0].srcStageMask |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[0].dstStageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependencies[0].srcAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[0].dstAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+	}
+
 	dependencies[1].srcSubpass = 0;
 	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
 	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-	dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | 
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 	dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
 	dependencies[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
@@ -110,7 +133,7 @@ void GBuffer::init()
 		attachments[GBUFFER_TANGENT_ATTACH_ID].imageView,
 		attachments[GBUFFER_SPECULAR_ATTACH_ID].imageView,
 		attachments[GBUFFER_MATERIAL_ATTACH_ID].imageView,
-		attachments[GBUFFER_DEPTH_ATTACH_ID].imageView
+		attachments[GBUFFER_DEPTH_ATTACH_ID].depthStencilView
 	};
 
 	VkExtent2D extent = VkEngine::getEngine().getSwapchainExtent();
@@ -126,4 +149,50 @@ void GBuffer::init()
 	framebufferCreateInfo.layers = 1;
 	
 	framebuffer = VkEngine::getEngine().getPool()->createFramebuffer(framebufferCreateInfo);
+
+	if (!depthPrePass)
+		return;
+
+	VkAttachmentDescription depthAttachmentDesc = attachmentDescs[GBUFFER_DEPTH_ATTACH_ID];
+	depthAttachmentDesc.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depthAttachmentDesc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depthAttachmentDesc.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	depthAttachmentDesc.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	// The depth attachment is the only one in this render pass
+	VkAttachmentReference depthPrePassReference = depthReference;
+	depthPrePassReference.attachment = 0;
+
+	VkSubpassDescription depthSubpass = {};
+	depthSubpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	depthSubpass.pColorAttachments = nullptr;
+	depthSubpass.colorAttachmentCount = 0;
+	depthSubpass.pDepthStencilAttachment = &depthPrePassReference;
+
+	VkSubpassDependency depthDependency = {};
+	depthDependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+	depthDependency.dstSubpass = 0;
+	depthDependency.srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+	depthDependency.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+	depthDependency.srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+	depthDependency.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	depthDependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+	VkRenderPassCreateInfo depthRenderPassInfo = {};
+	depthRenderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	depthRenderPassInfo.pAttachments = &depthAttachmentDesc;
+	depthRenderPassInfo.attachmentCount = 1;
+	depthRenderPassInfo.subpassCount = 1;
+	depthRenderPassInfo.pSubpasses = &depthSubpass;
+	depthRenderPassInfo.dependencyCount = 1;
+	depthRenderPassInfo.pDependencies = &depthDependency;
+
+	depthRenderPass = VkEngine::getEngine().getPool()->createRenderPass(depthRenderPassInfo);
+
+	VkFramebufferCreateInfo depthFramebufferCreateInfo = framebufferCreateInfo;
+	depthFramebufferCreateInfo.renderPass = depthRenderPass;
+	depthFramebufferCreateInfo.pAttachments = &attachments[GBUFFER_DEPTH_ATTACH_ID].depthStencilView;
+	depthFramebufferCreateInfo.attachmentCount = 1;
+
+	depthFramebuffer = VkEngine::getEngine().getPool()->createFramebuffer(depthFramebufferCreateInfo);
 }
\ No newline at end of file
@@ -14,6 +14,11 @@
 #define GBUFFER_DEPTH_ATTACH_ID		6
 #define GBUFFER_NUM_ATTACHMENTS		7
 
+// Stencil bits written by the geometry pass
+#define GBUFFER_STENCIL_GEOMETRY_BIT	0x1
+// Surfaces whose material scatters light below the surface, the only ones the SSS blur touches
+#define GBUFFER_STENCIL_SUBSURF_BIT		0x2
+
 
 enum GBufferAttachmentType {
 	COLOR,
@@ -33,15 +38,30 @@ struct GBufferAttachment {
 	VkImageView imageView;
 	VkDeviceMemory imageMemory;
 	VkSampler imageSampler;
+	// Depth attachment only: view over both depth and stencil, for use in framebuffers
+	VkImageView depthStencilView;
+	// Depth attachment only: view over the stencil aspect, for sampling the masks
+	VkImageView stencilView;
+};
+
+// Single-channel linear depth with a mip chain. The attachment's view covers every level for sampling,
+// storage writes go through one view per level
+struct DepthPyramid {
+	GBufferAttachment attachment;
+	std::vector<VkImageView> levelViews;
 };
 
 
 struct GBuffer {
-	void init();
+	void init(bool depthPrePass = false);
 
 	VkCommandBuffer commandBuffer;
 	VkFramebuffer framebuffer;
 	VkRenderPass renderPass;
 
+	// Only valid when a depth pre-pass is in use
+	VkFramebuffer depthFramebuffer = VK_NULL_HANDLE;
+	VkRenderPass depthRenderPass = VK_NULL_HANDLE;
+
 	std::array<GBufferAttachment, GBUFFER_NUM_ATTACHMENTS> attachments;
 };
\ No newline at end of file
@@ -1,13 +1,43 @@
 #include "GeometryPass.h"
 
+#include <cassert>
+
 #include "Camera.h"
 #include "Scene.h"
 #include "VkPool.h"
 
 
+static uint8_t WHITE_PIXEL[4] = { 255, 255, 255, 255 };
+// Tangent space +Z
+static uint8_t FLAT_NORMAL_PIXEL[4] = { 128, 128, 255, 255 };
+
+// The uniform block and the elements of the bindless material array share these fields
+template<typename T>
+static void copyMaterial(const Material* material, T& object)
+{
+	object.kd = glm::vec4(material->kd, 1);
+	object.ks = glm::vec4(material->ks, 1);
+	object.ns = material->ns;
+	object.opacity = material->opacity;
+	object.subsurfProfile = material->subsurfProfile;
+
+	if (VkEngine::getEngine().isDebugHUDEnabled())
+	{
+		object.translucency = VkEngine::getEngine().getTranslucencyOverride();
+		object.subsurfWidth = VkEngine::getEngine().getSubsurfWidthOverride();
+		// The default profile is the one the strength and falloff overrides are baked into
+		object.subsurfProfile = 0;
+	}
+	else
+	{
+		object.translucency = material->translucency;
+		object.subsurfWidth = material->subsurfWidth;
+	}
+}
+
 void GeometryPass::initAttachments()
 {
-	gBuffer.init();
+	gBuffer.init(depthPrePass);
 }
 
 void GeometryPass::initCommandBuffers()
@@ -47,6 +77,75 @@ void GeometryPass::initCommandBuffers()
 	renderArea.extent = extent;
 	renderArea.offset = { 0, 0 };
 
+	VkViewport viewport = {};
+	viewport.width = (float)extent.width;
+	viewport.height = (float)extent.height;
+	viewport.minDepth = 0;
+	viewport.maxDepth = 1;
+
+	if (depthPrePass)
+	{
+		VkRenderPassBeginInfo depthRenderPassInfo = {};
+		depthRenderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		depthRenderPassInfo.renderPass = gBuffer.depthRenderPass;
+		depthRenderPassInfo.framebuffer = gBuffer.depthFramebuffer;
+		depthRenderPassInfo.renderArea = renderArea;
+
+		VkClearValue depthClearValue = {};
+		depthClearValue.depthStencil = DEPTH_STENCIL_CLEAR;
+
+		depthRenderPassInfo.clearValueCount = 1;
+		depthRenderPassInfo.pClearValues = &depthClearValue;
+
+		vkCmdBeginRenderPass(commandBuffer, &depthRenderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &renderArea);
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPipeline);
+
+		if (bindless)
+		{
+			vkCmdBindDescriptorSets(
+				commandBuffer,
+				VK_PIPELINE_BIND_POINT_GRAPHICS,
+				depthPipelineLayout,
+				0,
+				1,
+				&descriptorSets[0],
+				0,
+				nullptr);
+		}
+
+		for (const auto& mesh : VkEngine::getEngine().getScene()->getMeshes())
+		{
+			loadMeshUniforms(mesh);
+
+			vkCmdSetStencilReference(commandBuffer, VK_STENCIL_FACE_FRONT_AND_BACK, getStencilReference(mesh->material));
+
+			VkBuffer vertexBuffers[] = { mesh->getPositionBuffer() };
+			VkDeviceSize offsets[] = { 0 };
+			vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+			vkCmdBindIndexBuffer(commandBuffer, mesh->getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+
+			if (!bindless)
+			{
+				vkCmdBindDescriptorSets(
+					commandBuffer,
+					VK_PIPELINE_BIND_POINT_GRAPHICS,
+					depthPipelineLayout,
+					0,
+					1,
+					&descriptorSets[mesh->material->id],
+					0,
+					nullptr);
+			}
+
+			vkCmdDrawIndexed(commandBuffer, mesh->indices.size(), 1, 0, 0, 0);
+		}
+
+		vkCmdEndRenderPass(commandBuffer);
+	}
+
 	VkRenderPassBeginInfo renderPassInfo = {};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 	renderPassInfo.renderPass = gBuffer.renderPass;
@@ -67,19 +166,26 @@ void GeometryPass::initCommandBuffers()
 
 	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-	VkViewport viewport = {};
-	viewport.width = (float)extent.width;
-	viewport.height = (float)extent.height;
-	viewport.minDepth = 0;
-	viewport.maxDepth = 1;
-
 	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 	vkCmdSetScissor(commandBuffer, 0, 1, &renderArea);
 	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
 
+	if (bindless)
+	{
+		vkCmdBindDescriptorSets(
+			commandBuffer,
+			VK_PIPELINE_BIND_POINT_GRAPHICS,
+			pipelineLayout,
+			0,
+			1,
+			&descriptorSets[0],
+			0,
+			nullptr);
+	}
+
 	for (const auto& mesh : VkEngine::getEngine().getScene()->getMeshes())
 	{
-		if (loadedMaterial != mesh->material->id)
+		if (!bindless && loadedMaterial != mesh->material->id)
 		{ 
 			loadMaterial(mesh->material);
 			loadedMaterial = mesh->material->id;
@@ -87,21 +193,28 @@ void GeometryPass::initCommandBuffers()
 
 		loadMeshUniforms(mesh);
 
+		vkCmdSetStencilReference(commandBuffer, VK_STENCIL_FACE_FRONT_AND_BACK, getStencilReference(mesh->material));
+
 		VkBuffer vertexBuffers[] = { mesh->getVertexBuffer() };
 		VkDeviceSize offsets[] = { 0 };
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
 		vkCmdBindIndexBuffer(commandBuffer, mesh->getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
-		vkCmdBindDescriptorSets(
-			commandBuffer,
-			VK_PIPELINE_BIND_POINT_GRAPHICS,
-			pipelineLayout,
-			0,
-			1,
-			&descriptorSets[mesh->material->id],
-			0,
-			nullptr);
+
+		if (!bindless)
+		{
+			vkCmdBindDescriptorSets(
+				commandBuffer,
+				VK_PIPELINE_BIND_POINT_GRAPHICS,
+				pipelineLayout,
+				0,
+				1,
+				&descriptorSets[mesh->material->id],
+				0,
+				nullptr);
+		}
 		
-		vkCmdDrawIndexed(commandBuffer, mesh->indices.size(), 1, 0, 0, 0);
+		// The bindless shaders read the material index back from the instance index
+		vkCmdDrawIndexed(commandBuffer, mesh->indices.size(), 1, 0, 0, bindless ? mesh->material->id : 0);
 	}
 
 	vkCmdEndRenderPass(commandBuffer);
@@ -109,24 +222,18 @@ void GeometryPass::initCommandBuffers()
 	VK_CHECK(vkEndCommandBuffer(commandBuffer));
 }
 
+uint32_t GeometryPass::getStencilReference(const Material* material)
+{
+	// The HUD can give any material a subsurface width, so all of them have to be blurred
+	bool subsurf = VkEngine::getEngine().isDebugHUDEnabled() || material->subsurfWidth > 0;
+
+	return GBUFFER_STENCIL_GEOMETRY_BIT | (subsurf ? GBUFFER_STENCIL_SUBSURF_BIT : 0);
+}
+
 void GeometryPass::loadMaterial(const Material* material)
 {
 	GPMaterialUniformBufferObject ubo = {};
-	ubo.kd = glm::vec4(material->kd, 1);
-	ubo.ks = glm::vec4(material->ks, 1);
-	ubo.ns = material->ns;
-	ubo.opacity = material->opacity;
-
-	if (VkEngine::getEngine().isDebugHUDEnabled())
-	{
-		ubo.translucency = VkEngine::getEngine().getTranslucencyOverride();
-		ubo.subsurfWidth = VkEngine::getEngine().getSubsurfWidthOverride();
-	}
-	else
-	{
-		ubo.translucency = material->translucency;
-		ubo.subsurfWidth = material->subsurfWidth;
-	}
+	copyMaterial(material, ubo);
 
 	updateBuffer(
 		VkEngine::getEngine().getDevice(),
@@ -139,6 +246,46 @@ void GeometryPass::loadMaterial(const Material* material)
 		materialUniformStagingBuffer);
 }
 
+void GeometryPass::loadMaterials()
+{
+	std::vector<Material*>& materials = VkEngine::getEngine().getScene()->getMaterials();
+	std::vector<GPMaterialBufferObject> objects(materials.size());
+
+	for (size_t i = 0; i < materials.size(); i++)
+	{
+		copyMaterial(materials[i], objects[i]);
+		objects[i].kdMap = getTextureIndex(materials[i]->kdMap, BINDLESS_WHITE_TEXTURE);
+		objects[i].normalMap = getTextureIndex(materials[i]->normalMap, BINDLESS_FLAT_NORMAL_TEXTURE);
+	}
+
+	updateBuffer(
+		VkEngine::getEngine().getDevice(),
+		VkEngine::getEngine().getCommandPool(),
+		VkEngine::getEngine().getGraphicsQueue(),
+		objects.data(),
+		sizeof(GPMaterialBufferObject) * objects.size(),
+		materialStorageStagingBufferMemory,
+		materialStorageBuffer,
+		materialStorageStagingBuffer);
+
+	materialsLoaded = true;
+	loadedHUDEnabled = VkEngine::getEngine().isDebugHUDEnabled();
+	loadedTranslucency = VkEngine::getEngine().getTranslucencyOverride();
+	loadedSubsurfWidth = VkEngine::getEngine().getSubsurfWidthOverride();
+}
+
+uint32_t GeometryPass::getTextureIndex(const Texture* texture, uint32_t defaultIndex) const
+{
+	if (texture == nullptr)
+		return defaultIndex;
+
+	// Every map of the scene's materials was given an element when the descriptor set was written
+	std::map<const Texture*, uint32_t>::const_iterator it = textureIndices.find(texture);
+	assert(it != textureIndices.end());
+
+	return it != textureIndices.end() ? it->second : defaultIndex;
+}
+
 void GeometryPass::loadMeshUniforms(const Mesh* mesh)
 {
 	MeshUniformBufferObject ubo = {};
@@ -157,6 +304,12 @@ void GeometryPass::loadMeshUniforms(const Mesh* mesh)
 
 void GeometryPass::initDescriptorSets()
 {
+	if (bindless)
+	{
+		initBindlessDescriptorSet();
+		return;
+	}
+
 	std::vector<Material*> materials = VkEngine::getEngine().getScene()->getMaterials();
 	descriptorSets.resize(materials.size());
 
@@ -264,7 +417,21 @@ void GeometryPass::initBufferData()
 
 void GeometryPass::updateBufferData()
 {
-	loadMaterial(VkEngine::getEngine().getScene()->getMaterials()[0]);
+	// The HUD overrides apply to every material, the array is only uploaded again when they change
+	if (bindless)
+	{
+		if (!materialsLoaded ||
+			loadedHUDEnabled != VkEngine::getEngine().isDebugHUDEnabled() ||
+			loadedTranslucency != VkEngine::getEngine().getTranslucencyOverride() ||
+			loadedSubsurfWidth != VkEngine::getEngine().getSubsurfWidthOverride())
+		{
+			loadMaterials();
+		}
+	}
+	else
+	{
+		loadMaterial(VkEngine::getEngine().getScene()->getMaterials()[0]);
+	}
 
 	CameraUniformBufferObject ubo = {};
 	ubo.view = VkEngine::getEngine().getScene()->getCamera()->getViewMatrix();
@@ -292,16 +459,68 @@ void GeometryPass::initGraphicsPipeline()
 		gs = readFile(gsPath);
 	}
 
+	// Every surface tags its pixels so that later passes can skip the background,
+	// the reference is set per mesh since only some materials are subsurface scattering
+	VkStencilOpState stencil = {};
+	stencil.failOp = VK_STENCIL_OP_KEEP;
+	stencil.passOp = VK_STENCIL_OP_REPLACE;
+	stencil.depthFailOp = VK_STENCIL_OP_KEEP;
+	stencil.compareOp = VK_COMPARE_OP_ALWAYS;
+	stencil.compareMask = 0xff;
+	stencil.writeMask = GBUFFER_STENCIL_GEOMETRY_BIT | GBUFFER_STENCIL_SUBSURF_BIT;
+	stencil.reference = GBUFFER_STENCIL_GEOMETRY_BIT;
+
+	std::vector<VkDynamicState> dynamicStates = { 
+		VK_DYNAMIC_STATE_VIEWPORT, 
+		VK_DYNAMIC_STATE_SCISSOR, 
+		VK_DYNAMIC_STATE_STENCIL_REFERENCE 
+	};
+
+	// Visible surfaces are resolved by the pre-pass, so only fragments matching its depth get shaded
+	PipelineOptions options;
+	options.stencilTest = true;
+	options.stencil = stencil;
+	options.dynamicStates = dynamicStates;
+	if (depthPrePass)
+	{
+		options.depthWrite = false;
+		options.depthCompareOp = VK_COMPARE_OP_EQUAL;
+	}
+
 	PipelineData pipelineData = VkEngine::getEngine().getPool()->createPipeline(
 		gBuffer.renderPass,
 		descriptorSetLayout,
 		VkEngine::getEngine().getSwapchainExtent(),
 		vs,
 		fs,
-		gs);
+		gs,
+		GBufferAttachmentType::NUM_TYPES - 1,
+		options);
 
 	pipeline = pipelineData.pipeline;
 	pipelineLayout = pipelineData.pipelineLayout;
+
+	if (!depthPrePass)
+		return;
+
+	PipelineOptions depthOptions;
+	depthOptions.positionOnly = true;
+	depthOptions.stencilTest = true;
+	depthOptions.stencil = stencil;
+	depthOptions.dynamicStates = dynamicStates;
+
+	PipelineData depthPipelineData = VkEngine::getEngine().getPool()->createPipeline(
+		gBuffer.depthRenderPass,
+		descriptorSetLayout,
+		VkEngine::getEngine().getSwapchainExtent(),
+		readFile(depthVsPath),
+		std::vector<char>(),
+		std::vector<char>(),
+		0,
+		depthOptions);
+
+	depthPipeline = depthPipelineData.pipeline;
+	depthPipelineLayout = depthPipelineData.pipelineLayout;
 }
 
 void GeometryPass::initUniformBuffer()
@@ -322,6 +541,19 @@ void GeometryPass::initUniformBuffer()
 	meshUniformBuffer = meshBufferDataVec[1].buffer;
 	meshUniformBufferMemory = meshBufferDataVec[1].bufferMemory;
 
+	if (bindless)
+	{
+		VkDeviceSize materialsBufferSize = sizeof(GPMaterialBufferObject) * VkEngine::getEngine().getScene()->getMaterials().size();
+
+		std::vector<BufferData> materialsBufferDataVec = VkEngine::getEngine().getPool()->createStorageBuffer(materialsBufferSize, true);
+		materialStorageStagingBuffer = materialsBufferDataVec[0].buffer;
+		materialStorageStagingBufferMemory = materialsBufferDataVec[0].bufferMemory;
+		materialStorageBuffer = materialsBufferDataVec[1].buffer;
+		materialStorageBufferMemory = materialsBufferDataVec[1].bufferMemory;
+
+		return;
+	}
+
 	VkDeviceSize materialBufferSize = sizeof(GPMaterialUniformBufferObject);
 
 	std::vector<BufferData> materialBufferDataVec = VkEngine::getEngine().getPool()->createUniformBuffer(materialBufferSize, true);
@@ -333,6 +565,12 @@ void GeometryPass::initUniformBuffer()
 
 void GeometryPass::initDescriptorSetLayout()
 {
+	if (bindless)
+	{
+		initBindlessDescriptorSetLayout();
+		return;
+	}
+
 	std::vector<VkDescriptorSetLayoutBinding> bindings(5);
 
 	VkDescriptorSetLayoutBinding cameraUBOLayoutBinding = {};
@@ -381,4 +619,181 @@ void GeometryPass::initDescriptorSetLayout()
 	bindings[4] = materialUBOLayoutBinding;
 
 	descriptorSetLayout = VkEngine::getEngine().getPool()->createDescriptorSetLayout(bindings);
-}
\ No newline at end of file
+}
+void GeometryPass::initBindlessDescriptorSetLayout()
+{
+	std::vector<VkDescriptorSetLayoutBinding> bindings(4);
+
+	VkDescriptorSetLayoutBinding cameraUBOLayoutBinding = {};
+	cameraUBOLayoutBinding.binding = 0;
+	cameraUBOLayoutBinding.descriptorCount = 1;
+	cameraUBOLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	cameraUBOLayoutBinding.pImmutableSamplers = nullptr;
+	cameraUBOLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+	bindings[0] = cameraUBOLayoutBinding;
+
+	VkDescriptorSetLayoutBinding meshUBOLayoutBinding = {};
+	meshUBOLayoutBinding.binding = 1;
+	meshUBOLayoutBinding.descriptorCount = 1;
+	meshUBOLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	meshUBOLayoutBinding.pImmutableSamplers = nullptr;
+	meshUBOLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	bindings[1] = meshUBOLayoutBinding;
+
+	VkDescriptorSetLayoutBinding texturesLayoutBinding = {};
+	texturesLayoutBinding.binding = TEXTURES_BINDING;
+	texturesLayoutBinding.descriptorCount = BINDLESS_MAX_TEXTURES;
+	texturesLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	texturesLayoutBinding.pImmutableSamplers = nullptr;
+	texturesLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	bindings[2] = texturesLayoutBinding;
+
+	VkDescriptorSetLayoutBinding materialsLayoutBinding = {};
+	materialsLayoutBinding.binding = MATERIALS_BINDING;
+	materialsLayoutBinding.descriptorCount = 1;
+	materialsLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	materialsLayoutBinding.pImmutableSamplers = nullptr;
+	materialsLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	bindings[3] = materialsLayoutBinding;
+
+	// Unused elements of the array may stay unwritten, and new textures can be written while command buffers use the set
+	std::vector<VkDescriptorBindingFlagsEXT> bindingFlags = {
+		0,
+		0,
+		VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT,
+		0
+	};
+
+	descriptorSetLayout = VkEngine::getEngine().getPool()->createDescriptorSetLayout(bindings, bindingFlags);
+}
+
+void GeometryPass::initBindlessDescriptorSet()
+{
+	std::vector<Material*> materials = VkEngine::getEngine().getScene()->getMaterials();
+
+	// Only the maps materials refer to, each one once however many materials share it,
+	// after the defaults that stand in for missing ones
+	std::vector<VkDescriptorImageInfo> imageInfos;
+	textureIndices.clear();
+
+	delete whiteTexture;
+	delete flatNormalTexture;
+	whiteTexture = new Texture(WHITE_PIXEL, 1, 1, VK_FORMAT_R8G8B8A8_UNORM);
+	flatNormalTexture = new Texture(FLAT_NORMAL_PIXEL, 1, 1, VK_FORMAT_R8G8B8A8_UNORM);
+
+	for (Texture* texture : { whiteTexture, flatNormalTexture })
+	{
+		VkDescriptorImageInfo imageInfo = {};
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfo.imageView = texture->getImageView();
+		imageInfo.sampler = texture->getSampler();
+
+		imageInfos.push_back(imageInfo);
+	}
+
+	for (const auto& material : materials)
+	{
+		for (Texture* texture : { material->kdMap, material->normalMap })
+		{
+			if (texture == nullptr || textureIndices.find(texture) != textureIndices.end())
+				continue;
+
+			textureIndices[texture] = imageInfos.size();
+
+			VkDescriptorImageInfo imageInfo = {};
+			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			imageInfo.imageView = texture->getImageView();
+			imageInfo.sampler = texture->getSampler();
+
+			imageInfos.push_back(imageInfo);
+		}
+	}
+
+	if (imageInfos.size() > BINDLESS_MAX_TEXTURES)
+	{
+		throw std::runtime_error("The scene has more textures than the bindless array can hold.");
+	}
+
+	bindlessDescriptorPool = VkEngine::getEngine().getPool()->createBindlessDescriptorPool(2, 1, BINDLESS_MAX_TEXTURES);
+
+	descriptorSets.resize(1);
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = bindlessDescriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &descriptorSetLayout;
+
+	VK_CHECK(vkAllocateDescriptorSets(VkEngine::getEngine().getDevice(), &allocInfo, &descriptorSets[0]));
+
+	std::vector<VkWriteDescriptorSet> descriptorWrites;
+
+	VkDescriptorBufferInfo cameraBufferInfo = {};
+	cameraBufferInfo.buffer = cameraUniformBuffer;
+	cameraBufferInfo.offset = 0;
+	cameraBufferInfo.range = sizeof(CameraUniformBufferObject);
+
+	VkWriteDescriptorSet cameraDescriptorSet = {};
+	cameraDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	cameraDescriptorSet.dstSet = descriptorSets[0];
+	cameraDescriptorSet.dstBinding = 0;
+	cameraDescriptorSet.dstArrayElement = 0;
+	cameraDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	cameraDescriptorSet.descriptorCount = 1;
+	cameraDescriptorSet.pBufferInfo = &cameraBufferInfo;
+
+	descriptorWrites.push_back(cameraDescriptorSet);
+
+	VkDescriptorBufferInfo meshBufferInfo = {};
+	meshBufferInfo.buffer = meshUniformBuffer;
+	meshBufferInfo.offset = 0;
+	meshBufferInfo.range = sizeof(MeshUniformBufferObject);
+
+	VkWriteDescriptorSet meshDescriptorSet = {};
+	meshDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	meshDescriptorSet.dstSet = descriptorSets[0];
+	meshDescriptorSet.dstBinding = 1;
+	meshDescriptorSet.dstArrayElement = 0;
+	meshDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	meshDescriptorSet.descriptorCount = 1;
+	meshDescriptorSet.pBufferInfo = &meshBufferInfo;
+
+	descriptorWrites.push_back(meshDescriptorSet);
+
+	// The used elements are contiguous from the start of the array, a single write covers them
+	VkWriteDescriptorSet texturesDescriptorSet = {};
+	texturesDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	texturesDescriptorSet.dstSet = descriptorSets[0];
+	texturesDescriptorSet.dstBinding = TEXTURES_BINDING;
+	texturesDescriptorSet.dstArrayElement = 0;
+	texturesDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	texturesDescriptorSet.descriptorCount = imageInfos.size();
+	texturesDescriptorSet.pImageInfo = imageInfos.data();
+
+	if (!imageInfos.empty())
+	{
+		descriptorWrites.push_back(texturesDescriptorSet);
+	}
+
+	VkDescriptorBufferInfo materialsBufferInfo = {};
+	materialsBufferInfo.buffer = materialStorageBuffer;
+	materialsBufferInfo.offset = 0;
+	materialsBufferInfo.range = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet materialsDescriptorSet = {};
+	materialsDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	materialsDescriptorSet.dstSet = descriptorSets[0];
+	materialsDescriptorSet.dstBinding = MATERIALS_BINDING;
+	materialsDescriptorSet.dstArrayElement = 0;
+	materialsDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	materialsDescriptorSet.descriptorCount = 1;
+	materialsDescriptorSet.pBufferInfo = &materialsBufferInfo;
+
+	descriptorWrites.push_back(materialsDescriptorSet);
+
+	vkUpdateDescriptorSets(VkEngine::getEngine().getDevice(), descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
+}
@@ -1,11 +1,21 @@
 #pragma once
 
+#include <map>
+
 #include "Pass.h"
 #include "GBuffer.h"
+#include "Texture.h"
 
 
 #define ALBEDO_BINDING		2
 #define NORMAL_BINDING		3
+// Bindless mode: one array holds the maps of every material, followed by the materials themselves
+#define TEXTURES_BINDING	2
+#define MATERIALS_BINDING	3
+#define BINDLESS_MAX_TEXTURES	1024
+// Reserved elements of the texture array, for materials without a color or normal map
+#define BINDLESS_WHITE_TEXTURE			0
+#define BINDLESS_FLAT_NORMAL_TEXTURE	1
 
 
 class Mesh;
@@ -19,6 +29,22 @@ struct GPMaterialUniformBufferObject {
 	float		opacity;
 	float		translucency;
 	float		subsurfWidth;
+	int			subsurfProfile;
+};
+
+// An element of the material array in bindless mode (std430)
+struct GPMaterialBufferObject {
+	glm::vec4	kd;
+	glm::vec4	ks;
+	float		ns;
+	float		opacity;
+	float		translucency;
+	float		subsurfWidth;
+	int			subsurfProfile;
+	// Elements of the texture array
+	uint32_t	kdMap;
+	uint32_t	normalMap;
+	uint32_t	padding;
 };
 
 
@@ -26,6 +52,10 @@ class GeometryPass : public Pass {
 	using Pass::Pass;
 
 public:
+	GeometryPass(std::string vsPath, std::string fsPath, std::string depthVsPath, bool depthPrePass, bool bindless = false)
+		: Pass(vsPath, fsPath), depthVsPath(depthVsPath), depthPrePass(depthPrePass), bindless(bindless) { }
+	~GeometryPass() { delete whiteTexture; delete flatNormalTexture; }
+
 	virtual void initBufferData() override;
 	virtual void updateBufferData() override;
 
@@ -35,6 +65,21 @@ public:
 private:
 	GBuffer gBuffer;
 	VkCommandBuffer commandBuffer;
+	std::string depthVsPath;
+	bool depthPrePass = false;
+	// One descriptor set for all draws, materials are picked by the first instance of each
+	bool bindless = false;
+	VkDescriptorPool bindlessDescriptorPool;
+	std::map<const Texture*, uint32_t> textureIndices;
+	Texture* whiteTexture = nullptr;
+	Texture* flatNormalTexture = nullptr;
+	// What the material array was last uploaded with, the HUD overrides apply to every material
+	bool materialsLoaded = false;
+	bool loadedHUDEnabled;
+	float loadedTranslucency;
+	float loadedSubsurfWidth;
+	VkPipeline depthPipeline;
+	VkPipelineLayout depthPipelineLayout;
 	VkBuffer cameraUniformStagingBuffer;
 	VkDeviceMemory cameraUniformStagingBufferMemory;
 	VkBuffer cameraUniformBuffer;
@@ -47,6 +92,10 @@ private:
 	VkDeviceMemory materialUniformStagingBufferMemory;
 	VkBuffer materialUniformBuffer;
 	VkDeviceMemory materialUniformBufferMemory;
+	VkBuffer materialStorageStagingBuffer;
+	VkDeviceMemory materialStorageStagingBufferMemory;
+	VkBuffer materialStorageBuffer;
+	VkDeviceMemory materialStorageBufferMemory;
 
 	virtual void initAttachments() override;
 	virtual void initCommandBuffers() override;
@@ -55,8 +104,15 @@ private:
 	virtual void initGraphicsPipeline() override;
 	virtual void initUniformBuffer() override;
 
+	void initBindlessDescriptorSet();
+	void initBindlessDescriptorSetLayout();
+
 	void loadMaterial(const Material* material);
+	void loadMaterials();
+	uint32_t getTextureIndex(const Texture* texture, uint32_t defaultIndex) const;
 	void loadMeshUniforms(const Mesh* mesh);
 
+	static uint32_t getStencilReference(const Material* material);
+
 	int16_t loadedMaterial = -1;
 };
\ No newline at end of file
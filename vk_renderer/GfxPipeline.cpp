@@ -1,6 +1,11 @@
 #include "GfxPipeline.h"
 
+#include <future>
+
+#include "BlueNoise.h"
 #include "Camera.h"
+#include "ClusterPass.h"
+#include "ClassifyPass.h"
 #include "ShadowPass.h"
 #include "LightingPass.h"
 #include "GeometryPass.h"
@@ -14,27 +19,89 @@
 
 void GfxPipeline::init()
 {
-	shadowPass = new ShadowPass(SHADOW_PASS_VS, SHADOW_PASS_FS);
-	geometryPass = new GeometryPass(GEOMETRY_PASS_VS, GEOMETRY_PASS_FS);
-	ssaoPass = new SSAOPass(SSAO_MAIN_PASS_VS, SSAO_MAIN_PASS_FS, SSAO_BLUR_PASS_VS, SSAO_BLUR_PASS_FS, geometryPass->getGBuffer());
-	lightingPass = new LightingPass(LIGHTING_PASS_VS, LIGHTING_PASS_FS, geometryPass->getGBuffer(), shadowPass->getNumLights(), 
-		shadowPass->getMaps(), ssaoPass->getAOMap(), true);
-	sssBlurPassOne = new SubsurfPass(SUBSURF_PASS_VS, SUBSURF_PASS_FS,
-		glm::vec2(1, 0), geometryPass->getGBuffer(), lightingPass->getDiffuseAttachment());
-	sssBlurPassTwo = new SubsurfPass(SUBSURF_PASS_VS, SUBSURF_PASS_FS,
-		glm::vec2(0, 1), geometryPass->getGBuffer(), sssBlurPassOne->getColorAttachment());
-	mergePass = new MergePass(MERGE_PASS_VS, MERGE_PASS_FS, sssBlurPassTwo->getColorAttachment(), lightingPass->getSpecularAttachment());
-
-	shadowPass->init();
-	geometryPass->init();
-	ssaoPass->init();
-	lightingPass->init();
-	sssBlurPassOne->init();
-	sssBlurPassTwo->init();
-	mergePass->init();
+	blueNoise = new BlueNoise();
+	const QualitySettings& quality = QUALITY_SETTINGS[VkEngine::getEngine().getConfig()->quality];
+	clusterPass = new ClusterPass(CLUSTER_PASS_CS, quality.lightsPerCluster);
+	shadowPass = new ShadowPass(SHADOW_PASS_VS, SHADOW_PASS_GS);
+	bool bindless = VkEngine::getEngine().getConfig()->bindlessTextures;
+	if (bindless && !VkEngine::getEngine().getPool()->isDescriptorIndexingEnabled())
+	{
+		std::cerr << "Descriptor indexing is not supported, falling back to a descriptor set per material." << std::endl;
+		bindless = false;
+	}
+	else if (bindless && VkEngine::getEngine().getPool()->getMaxUpdateAfterBindSampledImages() < BINDLESS_MAX_TEXTURES)
+	{
+		std::cerr << "The bindless texture array exceeds the device limits, falling back to a descriptor set per material." << std::endl;
+		bindless = false;
+	}
+	geometryPass = new GeometryPass(bindless ? GEOMETRY_BINDLESS_PASS_VS : GEOMETRY_PASS_VS, bindless ? GEOMETRY_BINDLESS_PASS_FS : GEOMETRY_PASS_FS,
+		DEPTH_PRE_PASS_VS, VkEngine::getEngine().getConfig()->depthPrePass, bindless);
+	uint32_t sssDownsample = VkEngine::getEngine().getConfig()->halfResSSS ? SS_HALF_RES_FACTOR : 1;
+	classifyPass = new ClassifyPass(CLASSIFY_PASS_CS, geometryPass->getGBuffer(), sssDownsample);
+	ssaoPass = new SSAOPass(SSAO_DOWNSAMPLE_PASS_CS, SSAO_DEPTH_MIPS_PASS_CS, { SSAO_MAIN_PASS_CS, SSAO_HBAO_PASS_CS, SSAO_GTAO_PASS_CS },
+		SSAO_TEMPORAL_PASS_CS, SSAO_BLUR_PASS_CS, geometryPass->getGBuffer(), blueNoise->getTexture(), VkEngine::getEngine().getConfig()->aoDownsample,
+		VkEngine::getEngine().getConfig()->temporalAO, VkEngine::getEngine().getConfig()->aoAlgorithm, quality.aoKernelSize);
+	lightingPass = new LightingPass(LIGHTING_PASS_VS, LIGHTING_PASS_FS, geometryPass->getGBuffer(), 
+		shadowPass->getAtlas(), clusterPass->getGrid(), classifyPass->getTiles(), ssaoPass->getAOMap(), 
+		VkEngine::getEngine().getConfig()->lightVolumes, true);
+	sssBlurPassOne = new SubsurfPass(SUBSURF_PASS_CS,
+		glm::vec2(1, 0), geometryPass->getGBuffer(), classifyPass->getTiles(), blueNoise->getTexture(), lightingPass->getDiffuseAttachment(), 
+		nullptr, sssDownsample, nullptr, quality.sssSamples);
+	sssBlurPassTwo = new SubsurfPass(SUBSURF_PASS_CS,
+		glm::vec2(0, 1), geometryPass->getGBuffer(), classifyPass->getTiles(), blueNoise->getTexture(), sssBlurPassOne->getColorAttachment(), 
+		lightingPass->getDiffuseAttachment(), sssDownsample, sssBlurPassOne->getKernelTable(), quality.sssSamples);
+	mergePass = new MergePass(MERGE_PASS_VS, MERGE_PASS_FS, sssBlurPassTwo->getColorAttachment(), lightingPass->getSpecularAttachment(),
+		lightingPass->getDiffuseAttachment(), geometryPass->getGBuffer());
+
+	std::vector<Pass*> passes = {
+		clusterPass,
+		shadowPass,
+		geometryPass,
+		classifyPass,
+		ssaoPass,
+		lightingPass,
+		sssBlurPassOne,
+		sssBlurPassTwo,
+		mergePass
+	};
+
+	VkEngine::getEngine().timeStartupStage("Pass layouts", [&passes]()
+	{
+		for (Pass* pass : passes)
+		{
+			pass->initLayouts();
+		}
+	});
+
+	// One worker per pass, all of them feeding the shared pipeline cache. Failures are rethrown here
+	VkEngine::getEngine().timeStartupStage("Pass pipelines", [&passes]()
+	{
+		std::vector<std::future<void>> compiled;
+
+		for (Pass* pass : passes)
+		{
+			compiled.push_back(std::async(std::launch::async, [pass]() { pass->initPipelines(); }));
+		}
 
+		for (std::future<void>& pipelines : compiled)
+		{
+			pipelines.get();
+		}
+	});
+
+	// Uploads and command buffer recording go through the graphics queue, which only one thread may use
+	VkEngine::getEngine().timeStartupStage("Pass resources", [&passes]()
+	{
+		for (Pass* pass : passes)
+		{
+			pass->initResources();
+		}
+	});
+
+	clusterPassCompleteSemaphore = VkEngine::getEngine().getPool()->createSemaphore();
 	shadowPassCompleteSemaphore = VkEngine::getEngine().getPool()->createSemaphore();
 	geomPassCompleteSemaphore = VkEngine::getEngine().getPool()->createSemaphore();
+	classifyPassCompleteSemaphore = VkEngine::getEngine().getPool()->createSemaphore();
 	mainSSAOPassCompleteSemaphore = VkEngine::getEngine().getPool()->createSemaphore();
 	blurSSAOPassCompleteSemaphore = VkEngine::getEngine().getPool()->createSemaphore();
 	mergePassCompleteSemaphore = VkEngine::getEngine().getPool()->createSemaphore();
@@ -50,7 +117,10 @@ void GfxPipeline::run()
 	VkSemaphore imageAvailableSemaphore = VkEngine::getEngine().getImageAvailableSemaphore();
 	VkSemaphore renderingCompleteSemaphore = VkEngine::getEngine().getRenderCompleteSemaphore();
 	
+	VkCommandBuffer clusterPassCmdBuffer = clusterPass->getCurrentCmdBuffer();
+	VkCommandBuffer shadowPassCmdBuffer = shadowPass->getCurrentCmdBuffer();
 	VkCommandBuffer geomPassCmdBuffer = geometryPass->getCurrentCmdBuffer();
+	VkCommandBuffer classifyPassCmdBuffer = classifyPass->getCurrentCmdBuffer();
 	VkCommandBuffer mainSSAOPassCmdBuffer = ssaoPass->getMainPassCmdBuffer();
 	VkCommandBuffer blurSSAOPassCmdBuffer = ssaoPass->getBlurPassCmdBuffer();
 	VkCommandBuffer lightingPassCmdBuffer = lightingPass->getCurrentCmdBuffer();
@@ -59,6 +129,7 @@ void GfxPipeline::run()
 	VkCommandBuffer mergePassCmdBuffer = mergePass->getCurrentCmdBuffer();
 
 	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+	VkPipelineStageFlags computeWaitStages[] = { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT };
 
 	VkSubmitInfo submitInfo = {};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -67,31 +138,44 @@ void GfxPipeline::run()
 	submitInfo.commandBufferCount = 1;
 	submitInfo.signalSemaphoreCount = 1;
 
-	for (size_t i = 0; i < shadowPass->getNumLights(); i++)
-	{
-		VkCommandBuffer cmdBuffer = shadowPass->getCmdBufferAt(i);
-		VkSemaphore waitSemaphore, signalSemaphore;
+	// Light binning only depends on the camera, it runs ahead of every graphics pass
+	submitInfo.pWaitSemaphores = &imageAvailableSemaphore;
+	submitInfo.pWaitDstStageMask = computeWaitStages;
+	submitInfo.pCommandBuffers = &clusterPassCmdBuffer;
+	submitInfo.pSignalSemaphores = &clusterPassCompleteSemaphore;
 
-		if (i == 0) waitSemaphore = imageAvailableSemaphore;
-		else waitSemaphore = shadowPass->getSemaphoreAt(i - 1);
+	VK_CHECK(vkQueueSubmit(VkEngine::getEngine().getGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE));
 
-		if (i == shadowPass->getNumLights() - 1) signalSemaphore = shadowPassCompleteSemaphore;
-		else signalSemaphore = shadowPass->getSemaphoreAt(i);
+	submitInfo.pWaitSemaphores = &clusterPassCompleteSemaphore;
+	submitInfo.pWaitDstStageMask = waitStages;
 
-		submitInfo.pWaitSemaphores = &waitSemaphore;
-		submitInfo.pSignalSemaphores = &signalSemaphore;
-		submitInfo.pCommandBuffers = &cmdBuffer;
+	// Cached shadow tiles are reused as they are unless a light or a mesh in its frustum has moved
+	if (shadowPass->hasPendingUpdate())
+	{
+		submitInfo.pCommandBuffers = &shadowPassCmdBuffer;
+		submitInfo.pSignalSemaphores = &shadowPassCompleteSemaphore;
 
 		VK_CHECK(vkQueueSubmit(VkEngine::getEngine().getGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE));
+
+		shadowPass->onSubmitted();
+		submitInfo.pWaitSemaphores = &shadowPassCompleteSemaphore;
 	}
 
-	submitInfo.pWaitSemaphores = &shadowPassCompleteSemaphore;
 	submitInfo.pCommandBuffers = &geomPassCmdBuffer;
 	submitInfo.pSignalSemaphores = &geomPassCompleteSemaphore;
 
 	VK_CHECK(vkQueueSubmit(VkEngine::getEngine().getGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE));
 
+	// Tiles are classified as soon as the G-buffer is complete, lighting and the blurs read the result
 	submitInfo.pWaitSemaphores = &geomPassCompleteSemaphore;
+	submitInfo.pWaitDstStageMask = computeWaitStages;
+	submitInfo.pCommandBuffers = &classifyPassCmdBuffer;
+	submitInfo.pSignalSemaphores = &classifyPassCompleteSemaphore;
+
+	VK_CHECK(vkQueueSubmit(VkEngine::getEngine().getGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE));
+
+	// Both SSAO steps are compute dispatches too
+	submitInfo.pWaitSemaphores = &classifyPassCompleteSemaphore;
 	submitInfo.pCommandBuffers = &mainSSAOPassCmdBuffer;
 	submitInfo.pSignalSemaphores = &mainSSAOPassCompleteSemaphore;
 
@@ -104,12 +188,15 @@ void GfxPipeline::run()
 	VK_CHECK(vkQueueSubmit(VkEngine::getEngine().getGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE));
 
 	submitInfo.pWaitSemaphores = &blurSSAOPassCompleteSemaphore;
+	submitInfo.pWaitDstStageMask = waitStages;
 	submitInfo.pSignalSemaphores = &lightingPassCompleteSemaphore;
 	submitInfo.pCommandBuffers = &lightingPassCmdBuffer;
 
 	VK_CHECK(vkQueueSubmit(VkEngine::getEngine().getGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE));
 
+	// Both blurs are compute dispatches
 	submitInfo.pWaitSemaphores = &lightingPassCompleteSemaphore;
+	submitInfo.pWaitDstStageMask = computeWaitStages;
 	submitInfo.pSignalSemaphores = &sssBlurPassOneCompleteSemaphore;
 	submitInfo.pCommandBuffers = &sssBlurPassOneCmdBuffer;
 
@@ -122,6 +209,7 @@ void GfxPipeline::run()
 	VK_CHECK(vkQueueSubmit(VkEngine::getEngine().getGraphicsQueue(), 1, &submitInfo, VK_NULL_HANDLE));
 
 	submitInfo.pWaitSemaphores = &sssBlurPassTwoCompleteSemaphore;
+	submitInfo.pWaitDstStageMask = waitStages;
 	submitInfo.pSignalSemaphores = &renderingCompleteSemaphore;
 	submitInfo.pCommandBuffers = &mergePassCmdBuffer;
 
@@ -138,10 +226,34 @@ VkRenderPass GfxPipeline::getPresentationRenderPass() const
 	return mergePass->getRenderPass();
 }
 
+void GfxPipeline::setAOAlgorithm(AOAlgorithm algorithm)
+{
+	ssaoPass->setAlgorithm(algorithm);
+}
+
+// Every pass keeps the pipelines it has been specialized with, so going back to a preset compiles nothing
+void GfxPipeline::setQuality(QualityPreset preset)
+{
+	const QualitySettings& quality = QUALITY_SETTINGS[preset];
+
+	clusterPass->setLightsPerCluster(quality.lightsPerCluster);
+	ssaoPass->setKernelSize(quality.aoKernelSize);
+	// The first blur owns the kernel table the second one reads
+	sssBlurPassOne->setNumSamples(quality.sssSamples);
+	sssBlurPassTwo->setNumSamples(quality.sssSamples);
+}
+
+float GfxPipeline::getAOTime() const
+{
+	return ssaoPass->getGPUTime();
+}
+
 void GfxPipeline::initBufferData()
 {
+	clusterPass->initBufferData();
 	shadowPass->initBufferData();
 	geometryPass->initBufferData();
+	classifyPass->initBufferData();
 	ssaoPass->initBufferData();
 	lightingPass->initBufferData();
 	sssBlurPassOne->initBufferData();
@@ -151,8 +263,10 @@ void GfxPipeline::initBufferData()
 
 void GfxPipeline::updateBufferData()
 {
+	clusterPass->updateBufferData();
 	shadowPass->updateBufferData();
 	geometryPass->updateBufferData();
+	classifyPass->updateBufferData();
 	ssaoPass->updateBufferData();
 	lightingPass->updateBufferData();
 	sssBlurPassOne->updateBufferData();
@@ -164,9 +278,12 @@ void GfxPipeline::cleanup()
 {
 	delete lightingPass;
 	delete geometryPass;
+	delete classifyPass;
 	delete shadowPass;
+	delete clusterPass;
 	delete ssaoPass;
 	delete sssBlurPassTwo;
 	delete sssBlurPassOne;
 	delete mergePass;
+	delete blueNoise;
 }
\ No newline at end of file
@@ -1,24 +1,35 @@
 #pragma once
 
 #include "vulkan\vulkan.h"
+#include "Config.h"
 
 
+#define CLUSTER_PASS_CS		"shaders/cluster/comp.spv"
+#define CLASSIFY_PASS_CS	"shaders/classify/comp.spv"
 #define SHADOW_PASS_VS		"shaders/shadow/vert.spv"
-#define SHADOW_PASS_FS		"shaders/shadow/frag.spv"
+#define SHADOW_PASS_GS		"shaders/shadow/geom.spv"
+#define DEPTH_PRE_PASS_VS	"shaders/depth/vert.spv"
 #define GEOMETRY_PASS_VS	"shaders/geometry/vert.spv"
 #define GEOMETRY_PASS_FS	"shaders/geometry/frag.spv"
-#define SSAO_MAIN_PASS_VS	"shaders/ssao-main/vert.spv"
-#define SSAO_MAIN_PASS_FS	"shaders/ssao-main/frag.spv"
-#define SSAO_BLUR_PASS_VS	"shaders/ssao-blur/vert.spv"
-#define SSAO_BLUR_PASS_FS	"shaders/ssao-blur/frag.spv"
+#define GEOMETRY_BINDLESS_PASS_VS	"shaders/geometry-bindless/vert.spv"
+#define GEOMETRY_BINDLESS_PASS_FS	"shaders/geometry-bindless/frag.spv"
+#define SSAO_DOWNSAMPLE_PASS_CS	"shaders/ssao-downsample/comp.spv"
+#define SSAO_DEPTH_MIPS_PASS_CS	"shaders/ssao-depth-mips/comp.spv"
+#define SSAO_MAIN_PASS_CS	"shaders/ssao-main/comp.spv"
+#define SSAO_HBAO_PASS_CS	"shaders/ssao-hbao/comp.spv"
+#define SSAO_GTAO_PASS_CS	"shaders/ssao-gtao/comp.spv"
+#define SSAO_TEMPORAL_PASS_CS	"shaders/ssao-temporal/comp.spv"
+#define SSAO_BLUR_PASS_CS	"shaders/ssao-blur/comp.spv"
 #define LIGHTING_PASS_VS	"shaders/lighting/vert.spv"
 #define LIGHTING_PASS_FS	"shaders/lighting/frag.spv"
-#define SUBSURF_PASS_VS		"shaders/subsurf/vert.spv"
-#define SUBSURF_PASS_FS		"shaders/subsurf/frag.spv"
+#define SUBSURF_PASS_CS		"shaders/subsurf/comp.spv"
 #define MERGE_PASS_VS		"shaders/merge/vert.spv"
 #define MERGE_PASS_FS		"shaders/merge/frag.spv"
 
 
+class BlueNoise;
+class ClusterPass;
+class ClassifyPass;
 class ShadowPass;
 class GeometryPass;
 class LightingPass;
@@ -39,18 +50,27 @@ public:
 
 	VkRenderPass getPresentationRenderPass() const;
 	VkCommandBuffer getPresentationCmdBuffer() const;
+	void setAOAlgorithm(AOAlgorithm algorithm);
+	void setQuality(QualityPreset preset);
+	float getAOTime() const;
 
 private:
+	ClusterPass* clusterPass;
 	ShadowPass* shadowPass;
 	GeometryPass* geometryPass;
+	ClassifyPass* classifyPass;
 	SSAOPass* ssaoPass;
+	// Shared by the AO and SSS passes
+	BlueNoise* blueNoise;
 	LightingPass* lightingPass;
 	SubsurfPass* sssBlurPassOne;
 	SubsurfPass* sssBlurPassTwo;
 	MergePass* mergePass;
 
+	VkSemaphore clusterPassCompleteSemaphore;
 	VkSemaphore shadowPassCompleteSemaphore;
 	VkSemaphore geomPassCompleteSemaphore;
+	VkSemaphore classifyPassCompleteSemaphore;
 	VkSemaphore mainSSAOPassCompleteSemaphore;
 	VkSemaphore blurSSAOPassCompleteSemaphore;
 	VkSemaphore lightingPassCompleteSemaphore;
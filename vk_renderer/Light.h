@@ -6,6 +6,9 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm\glm.hpp>
 
+// Irradiance below which a light is considered out of range
+#define LIGHT_CUTOFF	.001f
+
 
 enum LightType {
 	POINT,
@@ -17,5 +20,13 @@ struct Light {
 	glm::vec3 position;
 	glm::vec3 intensity;
 
+	float getRadius() const { return std::sqrt(MAX(intensity.r, MAX(intensity.g, intensity.b)) / LIGHT_CUTOFF); }
 	glm::mat4 getViewMatrix(Camera* camera) const { return glm::lookAt(position, camera->target, camera->up); }
+	glm::mat4 getViewMatrix(const glm::vec3& target, const glm::vec3& up) const { return glm::lookAt(position, target, up); }
+	glm::mat4 getProjMatrix(float fovy, float zNear = CAMERA_NEAR, float zFar = CAMERA_FAR) const
+	{
+		glm::mat4 proj = glm::perspective(fovy, 1.f, zNear, zFar);
+		proj[1][1] *= -1;
+		return proj;
+	}
 };
\ No newline at end of file
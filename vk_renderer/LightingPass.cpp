@@ -6,6 +6,32 @@
 #include "VkPool.h"
 
 
+void LightingPass::computeTransmittanceTexels()
+{
+	std::vector<SubsurfProfile>& profiles = VkEngine::getEngine().getScene()->getSubsurfProfiles();
+	glm::vec3 defaultFalloff = SS_FALLOFF;
+
+	transmittanceTexels.resize(TRANSMIT_LUT_SIZE * profiles.size());
+
+	for (size_t row = 0; row < profiles.size(); row++)
+	{
+		// Skin itself is reproduced exactly, wider falloffs spread the profile further
+		glm::vec3 falloffScale = profiles[row].falloff / defaultFalloff;
+
+		for (int i = 0; i < TRANSMIT_LUT_SIZE; i++)
+		{
+			float u = (i + .5f) / TRANSMIT_LUT_SIZE;
+			float scaledDist = TRANSMIT_LUT_MAX_DIST * u * u;
+			transmittanceTexels[row * TRANSMIT_LUT_SIZE + i] = glm::vec4(transmittanceProfile(scaledDist, falloffScale), 1);
+		}
+	}
+}
+
+void LightingPass::loadTransmittanceTexture()
+{
+	transmittanceTexture = new Texture((void*)transmittanceTexels.data(), TRANSMIT_LUT_SIZE, transmittanceTexels.size() / TRANSMIT_LUT_SIZE);
+}
+
 void LightingPass::initAttachments()
 {
 	std::vector<VkAttachmentReference> attachmentReferences;
@@ -42,10 +68,26 @@ void LightingPass::initAttachments()
 
 	attachmentReferences.push_back(specularAttachmentRef);
 
+	// The G-buffer depth-stencil is only read, for the depth and stencil tests of the light volumes
+	VkAttachmentDescription depthAttachment = {};
+	depthAttachment.format = findDepthStencilFormat(VkEngine::getEngine().getPhysicalDevice());
+	depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
+	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+	VkAttachmentReference depthAttachmentRef = {};
+	depthAttachmentRef.attachment = 2;
+	depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
 	VkSubpassDescription subPass = {};
 	subPass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
 	subPass.colorAttachmentCount = 2;
 	subPass.pColorAttachments = attachmentReferences.data();
+	subPass.pDepthStencilAttachment = lightVolumes ? &depthAttachmentRef : nullptr;
 
 	VkSubpassDependency dependency = {};
 	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
@@ -55,14 +97,25 @@ void LightingPass::initAttachments()
 	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
-	std::array<VkAttachmentDescription, 2> attachDescriptions = {
+	std::vector<VkAttachmentDescription> attachDescriptions = {
 		colorAttachment,
 		speculAttachment
 	};
 
+	if (lightVolumes)
+	{
+		// Depth and stencil tests must see the geometry pass writes
+		dependency.srcStageMask |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependency.srcAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependency.dstStageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+		dependency.dstAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+
+		attachDescriptions.push_back(depthAttachment);
+	}
+
 	VkRenderPassCreateInfo renderPassInfo = {};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	renderPassInfo.attachmentCount = 2;
+	renderPassInfo.attachmentCount = attachDescriptions.size();
 	renderPassInfo.pAttachments = attachDescriptions.data();
 	renderPassInfo.subpassCount = 1;
 	renderPassInfo.pSubpasses = &subPass;
@@ -80,11 +133,15 @@ void LightingPass::initAttachments()
 	diffuseAttachment = VkEngine::getEngine().getPool()->createGBufferAttachment(GBufferAttachmentType::COLOR);
 	specularAttachment = VkEngine::getEngine().getPool()->createGBufferAttachment(GBufferAttachmentType::COLOR);
 	
-	std::array<VkImageView, 2> attachments = {
+	std::vector<VkImageView> attachments = {
 		diffuseAttachment.imageView,
 		specularAttachment.imageView
 	};
 
+	if (lightVolumes)
+	{
+		attachments.push_back(prevPassGBuffer->attachments[GBUFFER_DEPTH_ATTACH_ID].depthStencilView);
+	}
 
 	VkExtent2D extent = VkEngine::getEngine().getSwapchainExtent();
 
@@ -93,7 +150,7 @@ void LightingPass::initAttachments()
 	framebufferCreateInfo.pNext = NULL;
 	framebufferCreateInfo.renderPass = renderPass;
 	framebufferCreateInfo.pAttachments = attachments.data();
-	framebufferCreateInfo.attachmentCount = 2;
+	framebufferCreateInfo.attachmentCount = attachments.size();
 	framebufferCreateInfo.width = extent.width;
 	framebufferCreateInfo.height = extent.height;
 	framebufferCreateInfo.layers = 1;
@@ -132,6 +189,8 @@ void LightingPass::initCommandBuffers()
 
 	std::vector<VkFramebuffer> framebuffers = VkEngine::getEngine().getSwapchainFramebuffers();
 
+	uint32_t numLights = VkEngine::getEngine().getScene()->getLights().size();
+
 	for (size_t i = 0; i < commandBuffers.size(); i++)
 	{
 		vkBeginCommandBuffer(commandBuffers[i], &beginInfo);
@@ -155,7 +214,16 @@ void LightingPass::initCommandBuffers()
 			0,
 			nullptr);
 
-		vkCmdDrawIndexed(commandBuffers[i], quad->indices.size(), 1, 0, 0, 1);
+		// Instance 0 shades ambient (and, without light volumes, every clustered light)
+		vkCmdDrawIndexed(commandBuffers[i], quad->indices.size(), 1, 0, 0, 0);
+
+		// Instance l + 1 shades light l alone. The vertex shader fits each quad to its light's volume
+		// from the current camera, so nothing here has to be re-recorded when the camera moves
+		if (lightVolumes && numLights > 0)
+		{
+			vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, volumePipeline);
+			vkCmdDrawIndexed(commandBuffers[i], quad->indices.size(), numLights, 0, 0, 1);
+		}
 
 		vkCmdEndRenderPass(commandBuffers[i]);
 
@@ -276,7 +344,7 @@ void LightingPass::initDescriptorSets()
 	descriptorWrites.push_back(materialDescriptorSet);
 
 	VkDescriptorImageInfo depthImageInfo = {};
-	depthImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	depthImageInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
 	depthImageInfo.imageView = prevPassGBuffer->attachments[GBUFFER_DEPTH_ATTACH_ID].imageView;
 	depthImageInfo.sampler = prevPassGBuffer->attachments[GBUFFER_DEPTH_ATTACH_ID].imageSampler;
 
@@ -323,16 +391,10 @@ void LightingPass::initDescriptorSets()
 
 	descriptorWrites.push_back(sceneDescriptorSet);
 
-	std::vector<VkDescriptorImageInfo> shadowImageInfos;
-	for (size_t l = 0; l < numShadowMaps; l++)
-	{
-		VkDescriptorImageInfo shadowImageInfo = {};
-		shadowImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		shadowImageInfo.imageView = shadowMaps[l].imageView;
-		shadowImageInfo.sampler = shadowMaps[l].imageSampler;
-
-		shadowImageInfos.push_back(shadowImageInfo);
-	}
+	VkDescriptorImageInfo shadowImageInfo = {};
+	shadowImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	shadowImageInfo.imageView = shadowAtlas->attachment.imageView;
+	shadowImageInfo.sampler = shadowAtlas->attachment.imageSampler;
 
 	VkWriteDescriptorSet shadowDescriptorSet = {};
 	shadowDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -340,8 +402,8 @@ void LightingPass::initDescriptorSets()
 	shadowDescriptorSet.dstBinding = bindingIndex++;
 	shadowDescriptorSet.dstArrayElement = 0;
 	shadowDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	shadowDescriptorSet.descriptorCount = shadowImageInfos.size();
-	shadowDescriptorSet.pImageInfo = shadowImageInfos.data();
+	shadowDescriptorSet.descriptorCount = 1;
+	shadowDescriptorSet.pImageInfo = &shadowImageInfo;
 
 	descriptorWrites.push_back(shadowDescriptorSet);
 
@@ -361,6 +423,86 @@ void LightingPass::initDescriptorSets()
 
 	descriptorWrites.push_back(aoDescriptorSet);
 
+	VkDescriptorImageInfo shadowCompareImageInfo = {};
+	shadowCompareImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	shadowCompareImageInfo.imageView = shadowAtlas->attachment.imageView;
+	shadowCompareImageInfo.sampler = shadowAtlas->compareSampler;
+
+	VkWriteDescriptorSet shadowCompareDescriptorSet = {};
+	shadowCompareDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	shadowCompareDescriptorSet.dstSet = descriptorSets[0];
+	shadowCompareDescriptorSet.dstBinding = bindingIndex++;
+	shadowCompareDescriptorSet.dstArrayElement = 0;
+	shadowCompareDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	shadowCompareDescriptorSet.descriptorCount = 1;
+	shadowCompareDescriptorSet.pImageInfo = &shadowCompareImageInfo;
+
+	descriptorWrites.push_back(shadowCompareDescriptorSet);
+
+	VkDescriptorBufferInfo lightsBufferInfo = {};
+	lightsBufferInfo.buffer = clusterGrid->lightsBuffer;
+	lightsBufferInfo.offset = 0;
+	lightsBufferInfo.range = clusterGrid->lightsBufferSize;
+
+	VkWriteDescriptorSet lightsDescriptorSet = {};
+	lightsDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	lightsDescriptorSet.dstSet = descriptorSets[0];
+	lightsDescriptorSet.dstBinding = bindingIndex++;
+	lightsDescriptorSet.dstArrayElement = 0;
+	lightsDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	lightsDescriptorSet.descriptorCount = 1;
+	lightsDescriptorSet.pBufferInfo = &lightsBufferInfo;
+
+	descriptorWrites.push_back(lightsDescriptorSet);
+
+	VkDescriptorBufferInfo clustersBufferInfo = {};
+	clustersBufferInfo.buffer = clusterGrid->clustersBuffer;
+	clustersBufferInfo.offset = 0;
+	clustersBufferInfo.range = clusterGrid->clustersBufferSize;
+
+	VkWriteDescriptorSet clustersDescriptorSet = {};
+	clustersDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	clustersDescriptorSet.dstSet = descriptorSets[0];
+	clustersDescriptorSet.dstBinding = bindingIndex++;
+	clustersDescriptorSet.dstArrayElement = 0;
+	clustersDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	clustersDescriptorSet.descriptorCount = 1;
+	clustersDescriptorSet.pBufferInfo = &clustersBufferInfo;
+
+	descriptorWrites.push_back(clustersDescriptorSet);
+
+	VkDescriptorImageInfo transmittanceImageInfo = {};
+	transmittanceImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	transmittanceImageInfo.imageView = transmittanceTexture->getImageView();
+	transmittanceImageInfo.sampler = transmittanceTexture->getSampler();
+
+	VkWriteDescriptorSet transmittanceDescriptorSet = {};
+	transmittanceDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	transmittanceDescriptorSet.dstSet = descriptorSets[0];
+	transmittanceDescriptorSet.dstBinding = bindingIndex++;
+	transmittanceDescriptorSet.dstArrayElement = 0;
+	transmittanceDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	transmittanceDescriptorSet.descriptorCount = 1;
+	transmittanceDescriptorSet.pImageInfo = &transmittanceImageInfo;
+
+	descriptorWrites.push_back(transmittanceDescriptorSet);
+
+	VkDescriptorBufferInfo tileClassesBufferInfo = {};
+	tileClassesBufferInfo.buffer = tiles->tileClassesBuffer;
+	tileClassesBufferInfo.offset = 0;
+	tileClassesBufferInfo.range = tiles->tileClassesBufferSize;
+
+	VkWriteDescriptorSet tileClassesDescriptorSet = {};
+	tileClassesDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	tileClassesDescriptorSet.dstSet = descriptorSets[0];
+	tileClassesDescriptorSet.dstBinding = bindingIndex++;
+	tileClassesDescriptorSet.dstArrayElement = 0;
+	tileClassesDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	tileClassesDescriptorSet.descriptorCount = 1;
+	tileClassesDescriptorSet.pBufferInfo = &tileClassesBufferInfo;
+
+	descriptorWrites.push_back(tileClassesDescriptorSet);
+
 	vkUpdateDescriptorSets(VkEngine::getEngine().getDevice(), descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
 }
 
@@ -375,6 +517,11 @@ void LightingPass::initGraphicsPipeline()
 		gs = readFile(gsPath);
 	}
 
+	// The depth-stencil attachment, when present, is read-only
+	PipelineOptions options;
+	options.depthTest = false;
+	options.depthWrite = false;
+
 	PipelineData pipelineData = VkEngine::getEngine().getPool()->createPipeline(
 		renderPass,
 		descriptorSetLayout,
@@ -382,10 +529,44 @@ void LightingPass::initGraphicsPipeline()
 		vs,
 		fs,
 		gs,
-		2);
+		2,
+		options);
 
 	pipeline = pipelineData.pipeline;
 	pipelineLayout = pipelineData.pipelineLayout;
+
+	if (!lightVolumes)
+		return;
+
+	// Only pixels covered by geometry and not in front of the light's volume are shaded, those behind it
+	// are rejected by the attenuation radius in the fragment shader
+	VkStencilOpState stencil = {};
+	stencil.failOp = VK_STENCIL_OP_KEEP;
+	stencil.passOp = VK_STENCIL_OP_KEEP;
+	stencil.depthFailOp = VK_STENCIL_OP_KEEP;
+	stencil.compareOp = VK_COMPARE_OP_EQUAL;
+	stencil.compareMask = GBUFFER_STENCIL_GEOMETRY_BIT;
+	stencil.writeMask = 0;
+	stencil.reference = GBUFFER_STENCIL_GEOMETRY_BIT;
+
+	PipelineOptions volumeOptions = options;
+	volumeOptions.depthTest = true;
+	volumeOptions.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+	volumeOptions.stencilTest = true;
+	volumeOptions.stencil = stencil;
+	volumeOptions.additiveBlend = true;
+
+	PipelineData volumePipelineData = VkEngine::getEngine().getPool()->createPipeline(
+		renderPass,
+		descriptorSetLayout,
+		VkEngine::getEngine().getSwapchainExtent(),
+		vs,
+		fs,
+		gs,
+		2,
+		volumeOptions);
+
+	volumePipeline = volumePipelineData.pipeline;
 }
 
 void LightingPass::initUniformBuffer()
@@ -481,7 +662,7 @@ void LightingPass::initDescriptorSetLayout()
 	cameraLayoutBinding.descriptorCount = 1;
 	cameraLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 	cameraLayoutBinding.pImmutableSamplers = nullptr;
-	cameraLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	cameraLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
 
 	bindings.push_back(cameraLayoutBinding);
 
@@ -496,7 +677,7 @@ void LightingPass::initDescriptorSetLayout()
 
 	VkDescriptorSetLayoutBinding shadowLayoutBinding = {};
 	shadowLayoutBinding.binding = bindingIndex++;
-	shadowLayoutBinding.descriptorCount = VkEngine::getEngine().getScene()->getLights().size();
+	shadowLayoutBinding.descriptorCount = 1;
 	shadowLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	shadowLayoutBinding.pImmutableSamplers = nullptr;
 	shadowLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
@@ -512,23 +693,76 @@ void LightingPass::initDescriptorSetLayout()
 
 	bindings.push_back(aoLayoutBinding);
 
+	VkDescriptorSetLayoutBinding shadowCompareLayoutBinding = {};
+	shadowCompareLayoutBinding.binding = bindingIndex++;
+	shadowCompareLayoutBinding.descriptorCount = 1;
+	shadowCompareLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	shadowCompareLayoutBinding.pImmutableSamplers = nullptr;
+	shadowCompareLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	bindings.push_back(shadowCompareLayoutBinding);
+
+	VkDescriptorSetLayoutBinding lightsLayoutBinding = {};
+	lightsLayoutBinding.binding = bindingIndex++;
+	lightsLayoutBinding.descriptorCount = 1;
+	lightsLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	lightsLayoutBinding.pImmutableSamplers = nullptr;
+	lightsLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	bindings.push_back(lightsLayoutBinding);
+
+	VkDescriptorSetLayoutBinding clustersLayoutBinding = {};
+	clustersLayoutBinding.binding = bindingIndex++;
+	clustersLayoutBinding.descriptorCount = 1;
+	clustersLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	clustersLayoutBinding.pImmutableSamplers = nullptr;
+	clustersLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	bindings.push_back(clustersLayoutBinding);
+
+	VkDescriptorSetLayoutBinding transmittanceLayoutBinding = {};
+	transmittanceLayoutBinding.binding = bindingIndex++;
+	transmittanceLayoutBinding.descriptorCount = 1;
+	transmittanceLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	transmittanceLayoutBinding.pImmutableSamplers = nullptr;
+	transmittanceLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	bindings.push_back(transmittanceLayoutBinding);
+
+	VkDescriptorSetLayoutBinding tileClassesLayoutBinding = {};
+	tileClassesLayoutBinding.binding = bindingIndex++;
+	tileClassesLayoutBinding.descriptorCount = 1;
+	tileClassesLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	tileClassesLayoutBinding.pImmutableSamplers = nullptr;
+	tileClassesLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	bindings.push_back(tileClassesLayoutBinding);
+
 	descriptorSetLayout = VkEngine::getEngine().getPool()->createDescriptorSetLayout(bindings);
 }
 
 void LightingPass::initBufferData()
 {
-	Camera* camera = VkEngine::getEngine().getScene()->getCamera();
-	std::vector<Light*> lights = VkEngine::getEngine().getScene()->getLights();
-	sceneUBO.numLights = lights.size();
-	
-	for (int i = 0; i < sceneUBO.numLights; i++)
+	// Light positions and intensities live in the cluster pass' storage buffer
+	sceneUBO.numLights = VkEngine::getEngine().getScene()->getLights().size();
+	sceneUBO.pcfRadius = MAX(0, VkEngine::getEngine().getConfig()->shadowPCFRadius);
+	sceneUBO.lightVolumes = lightVolumes ? 1 : 0;
+	sceneUBO.ka = glm::vec4(VkEngine::getEngine().getScene()->getAmbient(), 1);
+
+	loadSceneUniforms();
+}
+
+void LightingPass::loadSceneUniforms()
+{
+	for (size_t i = 0; i < shadowAtlas->lightMatrices.size(); i++)
 	{
-		sceneUBO.lights[i].pos = glm::vec4(lights[i]->position, 1);
-		sceneUBO.lights[i].ke = glm::vec4(lights[i]->intensity, 1);
-		sceneUBO.lights[i].mat = camera->getProjMatrix() * lights[i]->getViewMatrix(camera) * glm::mat4();
+		sceneUBO.shadows[i].mat = shadowAtlas->lightMatrices[i];
+		sceneUBO.shadows[i].atlasRect = shadowAtlas->tileRects[i];
+		// Transmittance is tuned against the range lights project with when nothing is fitted
+		sceneUBO.shadows[i].depthRange = glm::vec4(shadowAtlas->depthRanges[i], CAMERA_NEAR, CAMERA_FAR);
 	}
-	
-	sceneUBO.ka = glm::vec4(VkEngine::getEngine().getScene()->getAmbient(), 1);
+
+	loadedAtlasVersion = shadowAtlas->version;
 
 	updateBuffer(
 		VkEngine::getEngine().getDevice(),
@@ -544,6 +778,8 @@ void LightingPass::initBufferData()
 void LightingPass::updateBufferData()
 {
 	cameraUBO.position = glm::vec4(VkEngine::getEngine().getScene()->getCamera()->frame.origin, 1);
+	cameraUBO.view = VkEngine::getEngine().getScene()->getCamera()->getViewMatrix();
+	cameraUBO.proj = VkEngine::getEngine().getScene()->getCamera()->getProjMatrix();
 
 	updateBuffer(
 		VkEngine::getEngine().getDevice(),
@@ -554,4 +790,10 @@ void LightingPass::updateBufferData()
 		cameraUniformStagingBufferMemory,
 		cameraUniformBuffer,
 		cameraUniformStagingBuffer);
+
+	// Only reload when the shadow pass has re-packed its atlas or moved a light
+	if (loadedAtlasVersion != shadowAtlas->version)
+	{
+		loadSceneUniforms();
+	}
 }
\ No newline at end of file
@@ -3,33 +3,52 @@
 #include "Pass.h"
 #include "Quad.h"
 #include "Scene.h"
+#include "ShadowPass.h"
+#include "ClusterPass.h"
+#include "ClassifyPass.h"
+#include "Texture.h"
 
 
-struct LPShaderLight{
-	glm::vec4 pos;
-	glm::vec4 ke;
+// Columns of the transmittance LUT, spaced by the square root of the distance to resolve the narrow terms
+#define TRANSMIT_LUT_SIZE		256
+// Scaled distance past which every channel of the profile has vanished
+#define TRANSMIT_LUT_MAX_DIST	8.f
+
+
+struct LPShadowedLight {
 	glm::mat4 mat;
+	glm::vec4 atlasRect;
+	glm::vec4 depthRange;
 };
 
 struct LPCameraUniformBufferObject {
 	glm::vec4 position;
+	glm::mat4 view;
+	glm::mat4 proj;
 };
 
 struct LPSceneUniformBufferObject {
 	glm::vec4 ka;
-	LPShaderLight lights[MAX_NUM_LIGHTS];
+	LPShadowedLight shadows[MAX_NUM_SHADOWED_LIGHTS];
 	int numLights;
+	int pcfRadius;
+	int lightVolumes;
 };
 
 
 class LightingPass : public Pass {
 public:
 	LightingPass(std::string vsPath, std::string fsPath, GBuffer* prevPassGBuffer, 
-		size_t numShadowMaps, GBufferAttachment* shadowMaps, GBufferAttachment* aoMap, bool isFinalPass) :
-		Pass(vsPath, fsPath), prevPassGBuffer(prevPassGBuffer), numShadowMaps(numShadowMaps), 
-		shadowMaps(shadowMaps), aoMap(aoMap)
-		{ quad = new Quad(); }
-	~LightingPass() { delete quad; }
+		ShadowAtlas* shadowAtlas, ClusterGrid* clusterGrid, TileClassification* tiles, GBufferAttachment* aoMap, bool lightVolumes, 
+		bool isFinalPass) :
+		Pass(vsPath, fsPath), prevPassGBuffer(prevPassGBuffer), shadowAtlas(shadowAtlas), clusterGrid(clusterGrid), tiles(tiles), aoMap(aoMap),
+		lightVolumes(lightVolumes)
+	{ 
+		quad = new Quad(); 
+		computeTransmittanceTexels();
+		loadTransmittanceTexture();
+	}
+	~LightingPass() { delete transmittanceTexture; delete quad; }
 
 	VkCommandBuffer getCurrentCmdBuffer() const { return commandBuffers[0]; }
 	GBufferAttachment* getDiffuseAttachment() { return &diffuseAttachment; }
@@ -40,18 +59,27 @@ public:
 
 private:
 	bool isFinalPass;
+	// Ambient is drawn full-screen, then each point light adds itself inside the screen rectangle of its volume
+	bool lightVolumes;
 
 	VkRenderPass renderPass;
+	VkPipeline volumePipeline;
 	std::vector<VkCommandBuffer> commandBuffers;
 	VkFramebuffer framebuffer;
 
 	Quad* quad;
 	GBuffer* prevPassGBuffer;
-	size_t numShadowMaps;
-	GBufferAttachment* shadowMaps;
+	ShadowAtlas* shadowAtlas;
+	uint32_t loadedAtlasVersion;
+	ClusterGrid* clusterGrid;
+	// Background tiles skip the lights, only translucent ones evaluate transmittance
+	TileClassification* tiles;
 	GBufferAttachment* aoMap;
 	GBufferAttachment diffuseAttachment;
 	GBufferAttachment specularAttachment;
+	// One row per subsurface profile of the scene, in the same order as their ids
+	std::vector<glm::vec4> transmittanceTexels;
+	Texture* transmittanceTexture;
 	LPCameraUniformBufferObject cameraUBO;
 	LPSceneUniformBufferObject sceneUBO;
 	VkBuffer cameraUniformStagingBuffer;
@@ -69,4 +97,22 @@ private:
 	virtual void initDescriptorSetLayout() override;
 	virtual void initGraphicsPipeline() override;
 	virtual void initUniformBuffer() override;
+
+	void loadSceneUniforms();
+	void computeTransmittanceTexels();
+	void loadTransmittanceTexture();
+
+	// Skin diffusion profile (d'Eon et al.), falloffScale stretches it per channel for the other profiles
+	static glm::vec3 transmittanceProfile(float scaledDist, glm::vec3 falloffScale)
+	{
+		glm::vec3 d = scaledDist / falloffScale;
+		glm::vec3 dd = -d * d;
+
+		return	glm::vec3(0.233f, 0.455f, 0.649f) * glm::exp(dd / 0.0064f) +
+				glm::vec3(0.1f,   0.336f, 0.344f) * glm::exp(dd / 0.0484f) +
+				glm::vec3(0.118f, 0.198f, 0.0f)   * glm::exp(dd / 0.187f)  +
+				glm::vec3(0.113f, 0.007f, 0.007f) * glm::exp(dd / 0.567f)  +
+				glm::vec3(0.358f, 0.004f, 0.0f)   * glm::exp(dd / 1.99f)   +
+				glm::vec3(0.078f, 0.0f,   0.0f)   * glm::exp(dd / 7.41f);
+	}
 };
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <string>
+
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm\glm.hpp>
@@ -8,6 +10,18 @@
 #include "Vertex.h"
 
 
+// Skin, the profile of materials that do not name one
+#define SS_STRENGTH		{	.48f,	.41f,	.28f	}
+#define SS_FALLOFF		{	1.f,	.37f,	.3f		}
+
+
+// Shape of the subsurface diffusion, per color channel
+struct SubsurfProfile {
+	std::string	name;
+	glm::vec3	strength = SS_STRENGTH;
+	glm::vec3	falloff = SS_FALLOFF;
+};
+
 struct Material {
 	int			id;
 
@@ -29,4 +43,6 @@ struct Material {
 	float       opacity = 1;
 	float		translucency = 0;
 	float		subsurfWidth = 0;
+	// Index into the scene's subsurface profiles
+	int			subsurfProfile = 0;
 };
\ No newline at end of file
@@ -230,4 +230,34 @@ inline glm::vec3 gaussian(glm::vec3 falloff, float variance, float r)
 	}
 
 	return g;
+}
+
+// Conservative test of a local-space box against the clip volume of the given matrix
+inline bool isBoxInFrustum(const glm::mat4& mvp, const glm::vec3& boxMin, const glm::vec3& boxMax)
+{
+	int outside[6] = { 0 };
+
+	for (int c = 0; c < 8; c++)
+	{
+		glm::vec4 p = mvp * glm::vec4(
+			c & 1 ? boxMax.x : boxMin.x,
+			c & 2 ? boxMax.y : boxMin.y,
+			c & 4 ? boxMax.z : boxMin.z,
+			1);
+
+		outside[0] += p.x < -p.w;
+		outside[1] += p.x > p.w;
+		outside[2] += p.y < -p.w;
+		outside[3] += p.y > p.w;
+		outside[4] += p.z < 0;
+		outside[5] += p.z > p.w;
+	}
+
+	for (int i = 0; i < 6; i++)
+	{
+		if (outside[i] == 8)
+			return false;
+	}
+
+	return true;
 }
\ No newline at end of file
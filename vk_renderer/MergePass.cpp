@@ -162,6 +162,89 @@ void MergePass::initDescriptorSets()
 
 	descriptorWrites.push_back(specularDescriptorSet);
 
+	VkDescriptorImageInfo unblurredImageInfo = {};
+	unblurredImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	unblurredImageInfo.imageView = unblurredAttachment->imageView;
+	unblurredImageInfo.sampler = unblurredAttachment->imageSampler;
+
+	VkWriteDescriptorSet unblurredDescriptorSet = {};
+	unblurredDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	unblurredDescriptorSet.dstSet = descriptorSets[0];
+	unblurredDescriptorSet.dstBinding = bindingIndex++;
+	unblurredDescriptorSet.dstArrayElement = 0;
+	unblurredDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	unblurredDescriptorSet.descriptorCount = 1;
+	unblurredDescriptorSet.pImageInfo = &unblurredImageInfo;
+
+	descriptorWrites.push_back(unblurredDescriptorSet);
+
+	GBufferAttachment* depthAttachment = &prevPassGBuffer->attachments[GBufferAttachmentType::DEPTH];
+
+	VkDescriptorImageInfo stencilImageInfo = {};
+	stencilImageInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	stencilImageInfo.imageView = depthAttachment->stencilView;
+	stencilImageInfo.sampler = depthAttachment->imageSampler;
+
+	VkWriteDescriptorSet stencilDescriptorSet = {};
+	stencilDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	stencilDescriptorSet.dstSet = descriptorSets[0];
+	stencilDescriptorSet.dstBinding = bindingIndex++;
+	stencilDescriptorSet.dstArrayElement = 0;
+	stencilDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	stencilDescriptorSet.descriptorCount = 1;
+	stencilDescriptorSet.pImageInfo = &stencilImageInfo;
+
+	descriptorWrites.push_back(stencilDescriptorSet);
+
+	// Guides of the bilateral upsample of reduced-resolution SSS
+	VkDescriptorImageInfo positionImageInfo = {};
+	positionImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	positionImageInfo.imageView = prevPassGBuffer->attachments[GBufferAttachmentType::POSITION].imageView;
+	positionImageInfo.sampler = prevPassGBuffer->attachments[GBufferAttachmentType::POSITION].imageSampler;
+
+	VkWriteDescriptorSet positionDescriptorSet = {};
+	positionDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	positionDescriptorSet.dstSet = descriptorSets[0];
+	positionDescriptorSet.dstBinding = bindingIndex++;
+	positionDescriptorSet.dstArrayElement = 0;
+	positionDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	positionDescriptorSet.descriptorCount = 1;
+	positionDescriptorSet.pImageInfo = &positionImageInfo;
+
+	descriptorWrites.push_back(positionDescriptorSet);
+
+	VkDescriptorImageInfo normalImageInfo = {};
+	normalImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	normalImageInfo.imageView = prevPassGBuffer->attachments[GBufferAttachmentType::NORMAL].imageView;
+	normalImageInfo.sampler = prevPassGBuffer->attachments[GBufferAttachmentType::NORMAL].imageSampler;
+
+	VkWriteDescriptorSet normalDescriptorSet = {};
+	normalDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	normalDescriptorSet.dstSet = descriptorSets[0];
+	normalDescriptorSet.dstBinding = bindingIndex++;
+	normalDescriptorSet.dstArrayElement = 0;
+	normalDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	normalDescriptorSet.descriptorCount = 1;
+	normalDescriptorSet.pImageInfo = &normalImageInfo;
+
+	descriptorWrites.push_back(normalDescriptorSet);
+
+	VkDescriptorImageInfo materialImageInfo = {};
+	materialImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	materialImageInfo.imageView = prevPassGBuffer->attachments[GBufferAttachmentType::MATERIAL].imageView;
+	materialImageInfo.sampler = prevPassGBuffer->attachments[GBufferAttachmentType::MATERIAL].imageSampler;
+
+	VkWriteDescriptorSet materialDescriptorSet = {};
+	materialDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	materialDescriptorSet.dstSet = descriptorSets[0];
+	materialDescriptorSet.dstBinding = bindingIndex++;
+	materialDescriptorSet.dstArrayElement = 0;
+	materialDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	materialDescriptorSet.descriptorCount = 1;
+	materialDescriptorSet.pImageInfo = &materialImageInfo;
+
+	descriptorWrites.push_back(materialDescriptorSet);
+
 	vkUpdateDescriptorSets(VkEngine::getEngine().getDevice(), descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
 }
 
@@ -189,6 +272,51 @@ void MergePass::initDescriptorSetLayout()
 
 	bindings.push_back(specularSamplerLayoutBinding);
 
+	VkDescriptorSetLayoutBinding unblurredSamplerLayoutBinding = {};
+	unblurredSamplerLayoutBinding.binding = bindingIndex++;
+	unblurredSamplerLayoutBinding.descriptorCount = 1;
+	unblurredSamplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	unblurredSamplerLayoutBinding.pImmutableSamplers = nullptr;
+	unblurredSamplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	bindings.push_back(unblurredSamplerLayoutBinding);
+
+	VkDescriptorSetLayoutBinding stencilSamplerLayoutBinding = {};
+	stencilSamplerLayoutBinding.binding = bindingIndex++;
+	stencilSamplerLayoutBinding.descriptorCount = 1;
+	stencilSamplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	stencilSamplerLayoutBinding.pImmutableSamplers = nullptr;
+	stencilSamplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	bindings.push_back(stencilSamplerLayoutBinding);
+
+	VkDescriptorSetLayoutBinding positionSamplerLayoutBinding = {};
+	positionSamplerLayoutBinding.binding = bindingIndex++;
+	positionSamplerLayoutBinding.descriptorCount = 1;
+	positionSamplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	positionSamplerLayoutBinding.pImmutableSamplers = nullptr;
+	positionSamplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	bindings.push_back(positionSamplerLayoutBinding);
+
+	VkDescriptorSetLayoutBinding normalSamplerLayoutBinding = {};
+	normalSamplerLayoutBinding.binding = bindingIndex++;
+	normalSamplerLayoutBinding.descriptorCount = 1;
+	normalSamplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	normalSamplerLayoutBinding.pImmutableSamplers = nullptr;
+	normalSamplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	bindings.push_back(normalSamplerLayoutBinding);
+
+	VkDescriptorSetLayoutBinding materialSamplerLayoutBinding = {};
+	materialSamplerLayoutBinding.binding = bindingIndex++;
+	materialSamplerLayoutBinding.descriptorCount = 1;
+	materialSamplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	materialSamplerLayoutBinding.pImmutableSamplers = nullptr;
+	materialSamplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	bindings.push_back(materialSamplerLayoutBinding);
+
 	descriptorSetLayout = VkEngine::getEngine().getPool()->createDescriptorSetLayout(bindings);
 }
 
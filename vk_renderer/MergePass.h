@@ -7,10 +7,12 @@
 
 class MergePass : public Pass {
 public:
+	// Pixels outside the subsurface stencil mask are taken from unblurredAttachment.
+	// A diffuseAttachment smaller than the swapchain is upsampled using the G-buffer as guide
 	MergePass(std::string vsPath, std::string fsPath, GBufferAttachment* diffuseAttachment, 
-		GBufferAttachment* specularAttachment) :
-		vsPath(vsPath), fsPath(fsPath), diffuseAttachment(diffuseAttachment), 
-		specularAttachment(specularAttachment) { quad = new Quad(); }
+		GBufferAttachment* specularAttachment, GBufferAttachment* unblurredAttachment, GBuffer* gBuffer) :
+		vsPath(vsPath), fsPath(fsPath), prevPassGBuffer(gBuffer), diffuseAttachment(diffuseAttachment), 
+		specularAttachment(specularAttachment), unblurredAttachment(unblurredAttachment) { quad = new Quad(); }
 	~MergePass() { delete quad; }
 
 	VkRenderPass getRenderPass() const { return renderPass; }
@@ -27,6 +29,7 @@ private:
 	size_t numShadowMaps;
 	GBufferAttachment* diffuseAttachment;
 	GBufferAttachment* specularAttachment;
+	GBufferAttachment* unblurredAttachment;
 	VkAttachmentDescription colorAttachment;
 
 	virtual void initAttachments() override;
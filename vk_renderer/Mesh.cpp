@@ -1,5 +1,7 @@
 #include "Mesh.h"
 
+#include <cfloat>
+
 #include "VkUtils.h"
 #include "VkPool.h"
 
@@ -11,9 +13,53 @@ void Mesh::initVertexBuffer()
 	vertexBufferMemory = bufferData.bufferMemory;
 }
 
+void Mesh::initPositionBuffer()
+{
+	std::vector<glm::vec3> positions(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		positions[i] = vertices[i].position;
+	}
+
+	BufferData bufferData = VkEngine::getEngine().getPool()->createVertexBuffer(positions);
+	positionBuffer = bufferData.buffer;
+	positionBufferMemory = bufferData.bufferMemory;
+}
+
 void Mesh::initIndexBuffer()
 {
 	BufferData bufferData = VkEngine::getEngine().getPool()->createIndexBuffer(indices);
 	indexBuffer = bufferData.buffer;
 	indexBufferMemory = bufferData.bufferMemory;
+}
+
+void Mesh::computeBounds()
+{
+	boundsMin = glm::vec3(FLT_MAX);
+	boundsMax = glm::vec3(-FLT_MAX);
+
+	for (const Vertex& vertex : vertices)
+	{
+		boundsMin = glm::min(boundsMin, vertex.position);
+		boundsMax = glm::max(boundsMax, vertex.position);
+	}
+}
+
+void Mesh::getWorldBounds(glm::vec3& worldMin, glm::vec3& worldMax) const
+{
+	glm::mat4 model = getModelMatrix();
+	worldMin = glm::vec3(FLT_MAX);
+	worldMax = glm::vec3(-FLT_MAX);
+
+	for (int c = 0; c < 8; c++)
+	{
+		glm::vec3 corner = glm::vec3(model * glm::vec4(
+			c & 1 ? boundsMax.x : boundsMin.x,
+			c & 2 ? boundsMax.y : boundsMin.y,
+			c & 4 ? boundsMax.z : boundsMin.z,
+			1));
+
+		worldMin = glm::min(worldMin, corner);
+		worldMax = glm::max(worldMax, corner);
+	}
 }
\ No newline at end of file
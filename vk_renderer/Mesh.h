@@ -19,11 +19,16 @@ class Mesh {
 public:
 	std::string getName() const { return name; }
 	VkBuffer getVertexBuffer() const { return vertexBuffer; }
+	VkBuffer getPositionBuffer() const { return positionBuffer; }
 	VkBuffer getIndexBuffer() const { return indexBuffer; }
 	Material* getMaterial() const { return material; }
 	glm::mat4 getModelMatrix() const { return frame.toMatrix(); }
+	glm::vec3 getBoundsMin() const { return boundsMin; }
+	glm::vec3 getBoundsMax() const { return boundsMax; }
 
-	void initBuffers() { initVertexBuffer(); initIndexBuffer(); }
+	void initBuffers() { initVertexBuffer(); initPositionBuffer(); initIndexBuffer(); }
+	void computeBounds();
+	void getWorldBounds(glm::vec3& worldMin, glm::vec3& worldMax) const;
 
 private:
 	std::string name;
@@ -31,12 +36,17 @@ private:
 	std::vector<uint32_t> indices;
 	Material* material;
 	Frame frame = { IDENTITY_FRAME };
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
 
 	VkBuffer vertexBuffer;
 	VkDeviceMemory vertexBufferMemory;
+	VkBuffer positionBuffer;
+	VkDeviceMemory positionBufferMemory;
 	VkBuffer indexBuffer;
 	VkDeviceMemory indexBufferMemory;
 
 	void initVertexBuffer();
+	void initPositionBuffer();
 	void initIndexBuffer();
 };
\ No newline at end of file
@@ -10,11 +10,19 @@
 #include "VkPool.h"
 
 
-void Pass::init()
+void Pass::initLayouts()
 {
 	initDescriptorSetLayout();
 	initAttachments();
+}
+
+void Pass::initPipelines()
+{
 	initGraphicsPipeline();
+}
+
+void Pass::initResources()
+{
 	initDepthResources();
 	initFramebuffers();
 	initTextures();
@@ -21,7 +21,12 @@ public:
 	Pass(std::string vsPath, std::string gsPath, std::string fsPath) : vsPath(vsPath), gsPath(gsPath), fsPath(fsPath) { }
 	~Pass() { }
 
-	virtual void init();
+	void init() { initLayouts(); initPipelines(); initResources(); }
+	// Stages of init, split so that pipelines can be compiled concurrently across passes: they only
+	// depend on the layouts and render passes, and touch nothing but the pool
+	virtual void initLayouts();
+	virtual void initPipelines();
+	virtual void initResources();
 	virtual void initBufferData() { /*NOP*/ }
 	virtual void updateBufferData() { /*NOP*/ }
 	
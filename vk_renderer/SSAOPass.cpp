@@ -4,201 +4,659 @@
 #include "VkPool.h"
 
 
+// Compute-only: every step writes straight into a storage image, no render pass or framebuffer
+void SSAOPass::initLayouts()
+{
+	initAttachments();
+	initDescriptorSetLayout();
+}
+
+void SSAOPass::initPipelines()
+{
+	initComputePipeline();
+}
+
+void SSAOPass::initResources()
+{
+	initUniformBuffer();
+	// Uploaded next to where they are created, a swapchain recreation does not run initBufferData
+	loadKernelUniforms();
+	loadBlurUniforms();
+	initDescriptorSets();
+
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(VkEngine::getEngine().getPhysicalDevice(), &deviceProperties);
+	timestampPeriod = deviceProperties.limits.timestampPeriod;
+	timestampQueryPool = VkEngine::getEngine().getPool()->createQueryPool(VK_QUERY_TYPE_TIMESTAMP, 2);
+
+	initCommandBuffers();
+}
+
+void SSAOPass::setAlgorithm(AOAlgorithm algorithm)
+{
+	if (algorithm == this->algorithm)
+		return;
+
+	// The previous recording may still be in flight
+	vkQueueWaitIdle(VkEngine::getEngine().getGraphicsQueue());
+
+	this->algorithm = algorithm;
+	switchMainPipeline();
+}
+
+void SSAOPass::setKernelSize(uint32_t kernelSize)
+{
+	kernelSize = glm::min(kernelSize, uint32_t(SSAO_MAX_KERNEL_SIZE));
+
+	if (kernelSize == this->kernelSize)
+		return;
+
+	// The previous recording may still be in flight, and reads the kernel about to be replaced
+	vkQueueWaitIdle(VkEngine::getEngine().getGraphicsQueue());
+
+	this->kernelSize = kernelSize;
+	computeKernel();
+	loadKernelUniforms();
+	switchMainPipeline();
+}
+
+SpecializationConstants SSAOPass::getMainPassConstants() const
+{
+	if (algorithm == AO_CRYSIS)
+	{
+		return { kernelSize };
+	}
+
+	return SpecializationConstants();
+}
+
+// Waiting for the queue is up to the caller
+void SSAOPass::switchMainPipeline()
+{
+	for (size_t i = 0; i < (temporal ? 2 : 1); i++)
+	{
+		vkFreeCommandBuffers(
+			VkEngine::getEngine().getDevice(),
+			VkEngine::getEngine().getCommandPool(),
+			commandBuffers[i].size(),
+			commandBuffers[i].data());
+	}
+
+	PipelineData pipelineData = mainPipelinePermutations[algorithm].get(getMainPassConstants());
+	pipelines[1] = pipelineData.pipeline;
+	pipelineLayouts[1] = pipelineData.pipelineLayout;
+	// Results of another algorithm or kernel must not be blended in
+	historyValid = false;
+
+	initCommandBuffers();
+}
+
+float SSAOPass::getGPUTime()
+{
+	std::array<uint64_t, 2> timestamps;
+
+	VK_CHECK(vkGetQueryPoolResults(
+		VkEngine::getEngine().getDevice(),
+		timestampQueryPool,
+		0,
+		timestamps.size(),
+		sizeof(timestamps),
+		timestamps.data(),
+		sizeof(uint64_t),
+		VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+	return float(timestamps[1] - timestamps[0]) * timestampPeriod * 1e-6f;
+}
+
 void SSAOPass::computeNoiseScale()
 {
 	VkExtent2D extent = VkEngine::getEngine().getSwapchainExtent();
-	noiseScale = glm::vec2(extent.width, extent.height) / float(NOISE_SIZE);
+	glm::vec2 size = glm::vec2((extent.width + downsample - 1) / downsample, (extent.height + downsample - 1) / downsample);
+	noiseScale = size / float(BLUE_NOISE_SIZE);
 }
 
 void SSAOPass::computeKernel()
 {
-	for (int i = 0; i < KERNEL_SIZE; i++)
+	for (uint32_t i = 0; i < kernelSize; i++)
 	{
 		sampleKernel[i] = glm::vec4(normalize(glm::vec3(randInRange(-1, 1), randInRange(-1, 1), randF())), 0);
 
-		float scale = float(i) / float(KERNEL_SIZE);
+		float scale = float(i) / float(kernelSize);
 		scale = lerp(.1f, 1, scale * scale);
 		sampleKernel[i] *= scale;
 	}
 }
 
-void SSAOPass::computeNoiseTexels()
+void SSAOPass::initAttachments()
 {
-	noiseTexels.resize(NOISE_SIZE * NOISE_SIZE);
+	geometryAttachment = VkEngine::getEngine().getPool()->createGBufferAttachment(GBufferAttachmentType::NORMAL, true, true, downsample);
+	aoAttachment = VkEngine::getEngine().getPool()->createGBufferAttachment(GBufferAttachmentType::COLOR, true, true, downsample);
+	halfBlurredAOAttachment = VkEngine::getEngine().getPool()->createGBufferAttachment(GBufferAttachmentType::COLOR, true, true, downsample);
+	blurredAOAttachment = VkEngine::getEngine().getPool()->createGBufferAttachment(GBufferAttachmentType::COLOR, true, true, downsample);
+
+	// Down to 1x1 at most
+	VkExtent2D extent = VkEngine::getEngine().getSwapchainExtent();
+	uint32_t size = glm::max((extent.width + downsample - 1) / downsample, (extent.height + downsample - 1) / downsample);
+	numDepthLevels = 1;
 
-	for (int i = 0; i < NOISE_SIZE * NOISE_SIZE; i++)
+	while (numDepthLevels < SSAO_DEPTH_MIP_LEVELS && (size >> numDepthLevels) > 0)
 	{
-		noiseTexels[i] = glm::vec4(randInRange(-1, 1), randInRange(-1, 1), 0, 0);
-		noiseTexels[i] = glm::normalize(noiseTexels[i]);
+		numDepthLevels++;
 	}
-}
 
-void SSAOPass::loadNoiseTexture()
-{
-	noiseTexture = new Texture((void*)noiseTexels.data(), NOISE_SIZE, NOISE_SIZE);
+	depthPyramid = VkEngine::getEngine().getPool()->createDepthPyramid(numDepthLevels, downsample);
+
+	if (!temporal)
+		return;
+
+	for (size_t i = 0; i < 2; i++)
+	{
+		historyAttachments[i] = VkEngine::getEngine().getPool()->createGBufferAttachment(GBufferAttachmentType::NORMAL, true, true, downsample);
+
+		// The first frame reads the image the previous one would have written, so it has to be readable from the start
+		transitionImageLayout(
+			VkEngine::getEngine().getDevice(),
+			VkEngine::getEngine().getCommandPool(),
+			VkEngine::getEngine().getGraphicsQueue(),
+			historyAttachments[i].image,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	}
 }
 
-void SSAOPass::initAttachments()
+void SSAOPass::initComputePipeline()
 {
-	colorAttachment = {};
-	colorAttachment.format = VkEngine::getEngine().getSwapchainFormat();
-	colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	colorAttachment.format = VK_FORMAT_R8G8B8A8_UNORM;
-
-	VkAttachmentReference colorAttachmentRef = {};
-	colorAttachmentRef.attachment = 0;
-	colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-	VkSubpassDescription subPass = {};
-	subPass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subPass.colorAttachmentCount = 1;
-	subPass.pColorAttachments = &colorAttachmentRef;
-	subPass.pDepthStencilAttachment = nullptr;
-
-	VkAccessFlags accessFlags = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-	std::array<VkSubpassDependency, 2> dependencies = getSubpassDependency(accessFlags);
-
-	VkRenderPassCreateInfo renderPassInfo = {};
-	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	renderPassInfo.pAttachments = &colorAttachment;
-	renderPassInfo.attachmentCount = 1;
-	renderPassInfo.subpassCount = 1;
-	renderPassInfo.pSubpasses = &subPass;
-	renderPassInfo.dependencyCount = dependencies.size();
-	renderPassInfo.pDependencies = dependencies.data();
-
-	renderPass = VkEngine::getEngine().getPool()->createRenderPass(renderPassInfo);
+	std::vector<char> cs = readFile(downsampleCSPath);
 
-	VkCommandBufferAllocateInfo allocInfo = {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.commandPool = VkEngine::getEngine().getCommandPool();
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandBufferCount = 2;
+	PipelineData pipelineData = VkEngine::getEngine().getPool()->createComputePipeline(downsamplePassDescriptorSetLayout, cs);
 
-	VK_CHECK(vkAllocateCommandBuffers(VkEngine::getEngine().getDevice(), &allocInfo, commandBuffers.data()));
+	pipelines[0] = pipelineData.pipeline;
+	pipelineLayouts[0] = pipelineData.pipelineLayout;
 
-	aoAttachment = VkEngine::getEngine().getPool()->createGBufferAttachment(GBufferAttachmentType::COLOR);
-	blurredAOAttachment = VkEngine::getEngine().getPool()->createGBufferAttachment(GBufferAttachmentType::COLOR);
+	cs = readFile(depthMipsCSPath);
 
-	VkExtent2D extent = VkEngine::getEngine().getSwapchainExtent();
+	// All levels share the pipeline, their descriptor sets tell them apart
+	pipelineData = VkEngine::getEngine().getPool()->createComputePipeline(depthMipsPassDescriptorSetLayout, cs);
+
+	pipelines[4] = pipelineData.pipeline;
+	pipelineLayouts[4] = pipelineData.pipelineLayout;
+
+	// Layouts are all the same, as are the descriptor sets
+	for (size_t i = 0; i < AO_NUM_ALGORITHMS; i++)
+	{
+		std::string csPath = mainCSPaths[i];
+		VkDescriptorSetLayout descriptorSetLayout = mainPassDescriptorSetLayout;
+
+		mainPipelinePermutations[i] = PipelinePermutations([csPath, descriptorSetLayout](const SpecializationConstants& constants)
+		{
+			return VkEngine::getEngine().getPool()->createComputePipeline(descriptorSetLayout, readFile(csPath), constants);
+		});
+	}
+
+	pipelineData = mainPipelinePermutations[algorithm].get(getMainPassConstants());
+
+	pipelines[1] = pipelineData.pipeline;
+	pipelineLayouts[1] = pipelineData.pipelineLayout;
+
+	cs = readFile(blurCSPath);
+
+	// Both directions share the pipeline, their descriptor sets tell them apart
+	pipelineData = VkEngine::getEngine().getPool()->createComputePipeline(blurPassDescriptorSetLayout, cs);
 
-	VkFramebufferCreateInfo framebufferCreateInfo = {};
-	framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-	framebufferCreateInfo.pNext = NULL;
-	framebufferCreateInfo.renderPass =renderPass;
-	framebufferCreateInfo.pAttachments = &aoAttachment.imageView;
-	framebufferCreateInfo.attachmentCount = 1;
-	framebufferCreateInfo.width = extent.width;
-	framebufferCreateInfo.height = extent.height;
-	framebufferCreateInfo.layers = 1;
+	pipelines[2] = pipelineData.pipeline;
+	pipelineLayouts[2] = pipelineData.pipelineLayout;
 
-	framebuffers[0] = VkEngine::getEngine().getPool()->createFramebuffer(framebufferCreateInfo);
+	if (!temporal)
+		return;
 
-	framebufferCreateInfo.pAttachments = &blurredAOAttachment.imageView;
+	cs = readFile(temporalCSPath);
 
-	framebuffers[1] = VkEngine::getEngine().getPool()->createFramebuffer(framebufferCreateInfo);
+	pipelineData = VkEngine::getEngine().getPool()->createComputePipeline(temporalPassDescriptorSetLayout, cs);
+
+	pipelines[3] = pipelineData.pipeline;
+	pipelineLayouts[3] = pipelineData.pipelineLayout;
 }
 
-void SSAOPass::initSemaphores()
+static void recordLayoutTransition(
+	VkCommandBuffer commandBuffer,
+	VkImage image,
+	VkImageLayout oldLayout,
+	VkImageLayout newLayout,
+	VkAccessFlags srcAccessMask,
+	VkAccessFlags dstAccessMask,
+	VkPipelineStageFlags srcStageMask,
+	VkPipelineStageFlags dstStageMask,
+	uint32_t baseMipLevel = 0,
+	uint32_t levelCount = 1)
 {
-	mainPassSemaphore = VkEngine::getEngine().getPool()->createSemaphore();
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = srcAccessMask;
+	barrier.dstAccessMask = dstAccessMask;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = newLayout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, baseMipLevel, levelCount, 0, 1 };
+
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		srcStageMask,
+		dstStageMask,
+		0,
+		0,
+		nullptr,
+		0,
+		nullptr,
+		1,
+		&barrier);
 }
 
 void SSAOPass::initCommandBuffers()
 {
-	static bool firstTime = true;
-	if (!firstTime)
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = VkEngine::getEngine().getCommandPool();
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = commandBuffers[0].size();
+
+	// Without temporal accumulation there is a single history, the first one
+	for (size_t i = 0; i < (temporal ? 2 : 1); i++)
 	{
-		vkFreeCommandBuffers(
-			VkEngine::getEngine().getDevice(),
-			VkEngine::getEngine().getCommandPool(),
-			2,
-			commandBuffers.data());
+		VK_CHECK(vkAllocateCommandBuffers(VkEngine::getEngine().getDevice(), &allocInfo, commandBuffers[i].data()));
+
+		recordCommandBuffers(i);
 	}
-	else
+}
+
+void SSAOPass::recordCommandBuffers(size_t history)
+{
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+	beginInfo.pInheritanceInfo = nullptr;
+
+	VkExtent2D extent = VkEngine::getEngine().getSwapchainExtent();
+	extent.width = (extent.width + downsample - 1) / downsample;
+	extent.height = (extent.height + downsample - 1) / downsample;
+
+	vkBeginCommandBuffer(commandBuffers[history][0], &beginInfo);
+
+	vkCmdResetQueryPool(commandBuffers[history][0], timestampQueryPool, 0, 2);
+	vkCmdWriteTimestamp(commandBuffers[history][0], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, 0);
+
+	// Depth and normals are reduced once, then AO is computed from them
+	std::array<GBufferAttachment*, 2> outAttachments = { &geometryAttachment, &aoAttachment };
+	std::array<VkDescriptorSet, 2> stepDescriptorSets = { downsampleDescriptorSet, mainDescriptorSet };
+
+	// The downsample writes the first level of the pyramid, the others are built from it right after
+	recordLayoutTransition(
+		commandBuffers[history][0],
+		depthPyramid.attachment.image,
+		VK_IMAGE_LAYOUT_UNDEFINED,
+		VK_IMAGE_LAYOUT_GENERAL,
+		0,
+		VK_ACCESS_SHADER_WRITE_BIT,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0,
+		numDepthLevels);
+
+	for (size_t i = 0; i < 2; i++)
 	{
-		firstTime = false;
+		// Every texel gets overwritten, previous contents can be discarded
+		recordLayoutTransition(
+			commandBuffers[history][0],
+			outAttachments[i]->image,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_GENERAL,
+			0,
+			VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		vkCmdBindPipeline(commandBuffers[history][0], VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[i]);
+		vkCmdBindDescriptorSets(
+			commandBuffers[history][0],
+			VK_PIPELINE_BIND_POINT_COMPUTE,
+			pipelineLayouts[i],
+			0,
+			1,
+			&stepDescriptorSets[i],
+			0,
+			nullptr);
+
+		vkCmdDispatch(
+			commandBuffers[history][0],
+			(extent.width + SSAO_TILE_SIZE - 1) / SSAO_TILE_SIZE,
+			(extent.height + SSAO_TILE_SIZE - 1) / SSAO_TILE_SIZE,
+			1);
+
+		recordLayoutTransition(
+			commandBuffers[history][0],
+			outAttachments[i]->image,
+			VK_IMAGE_LAYOUT_GENERAL,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_ACCESS_SHADER_WRITE_BIT,
+			VK_ACCESS_SHADER_READ_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		if (i == 0) recordDepthPyramid(commandBuffers[history][0], extent);
 	}
 
-	for (size_t i = 0; i < 2; i++)
+	if (temporal)
 	{
-		VkCommandBufferAllocateInfo allocInfo = {};
-		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		allocInfo.commandPool = VkEngine::getEngine().getCommandPool();
-		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		allocInfo.commandBufferCount = 1;
+		// Blend this frame's samples into the reprojected history, the other history image is only read
+		recordLayoutTransition(
+			commandBuffers[history][0],
+			historyAttachments[history].image,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_GENERAL,
+			0,
+			VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		vkCmdBindPipeline(commandBuffers[history][0], VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[3]);
+		vkCmdBindDescriptorSets(
+			commandBuffers[history][0],
+			VK_PIPELINE_BIND_POINT_COMPUTE,
+			pipelineLayouts[3],
+			0,
+			1,
+			&temporalDescriptorSets[history],
+			0,
+			nullptr);
+
+		vkCmdDispatch(
+			commandBuffers[history][0],
+			(extent.width + SSAO_TILE_SIZE - 1) / SSAO_TILE_SIZE,
+			(extent.height + SSAO_TILE_SIZE - 1) / SSAO_TILE_SIZE,
+			1);
+
+		// Read by the horizontal blur now and by the resolve of the next frame
+		recordLayoutTransition(
+			commandBuffers[history][0],
+			historyAttachments[history].image,
+			VK_IMAGE_LAYOUT_GENERAL,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_ACCESS_SHADER_WRITE_BIT,
+			VK_ACCESS_SHADER_READ_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	}
 
-		VK_CHECK(vkAllocateCommandBuffers(VkEngine::getEngine().getDevice(), &allocInfo, &commandBuffers[i]));
+	VK_CHECK(vkEndCommandBuffer(commandBuffers[history][0]));
 
-		VkCommandBufferBeginInfo beginInfo = {};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-		beginInfo.pInheritanceInfo = nullptr;
+	vkBeginCommandBuffer(commandBuffers[history][1], &beginInfo);
 
-		vkBeginCommandBuffer(commandBuffers[i], &beginInfo);
+	vkCmdBindPipeline(commandBuffers[history][1], VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[2]);
 
-		VkExtent2D extent = VkEngine::getEngine().getSwapchainExtent();
+	// Horizontal blur into the intermediate image, vertical blur from it into the AO map
+	outAttachments = { &halfBlurredAOAttachment, &blurredAOAttachment };
+	stepDescriptorSets = { horizontalBlurDescriptorSets[history], verticalBlurDescriptorSet };
 
-		VkRect2D renderArea = {};
-		renderArea.extent = extent;
-		renderArea.offset = { 0, 0 };
+	for (size_t i = 0; i < 2; i++)
+	{
+		recordLayoutTransition(
+			commandBuffers[history][1],
+			outAttachments[i]->image,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_GENERAL,
+			0,
+			VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
 
-		VkRenderPassBeginInfo renderPassInfo = {};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass = renderPass;
-		renderPassInfo.framebuffer = framebuffers[i];
-		renderPassInfo.renderArea = renderArea;
+		vkCmdBindDescriptorSets(
+			commandBuffers[history][1],
+			VK_PIPELINE_BIND_POINT_COMPUTE,
+			pipelineLayouts[2],
+			0,
+			1,
+			&stepDescriptorSets[i],
+			0,
+			nullptr);
 
-		VkClearValue clearValue = {};
-		clearValue.depthStencil = DEPTH_STENCIL_CLEAR;
+		// Workgroups cover runs of pixels along the blur direction, one row (or column) each
+		uint32_t runLength = i == 0 ? extent.width : extent.height;
+		uint32_t numRuns = i == 0 ? extent.height : extent.width;
+
+		vkCmdDispatch(commandBuffers[history][1], (runLength + SSAO_BLUR_TILE_SIZE - 1) / SSAO_BLUR_TILE_SIZE, numRuns, 1);
+
+		// Hand the result over to the vertical blur or to the lighting pass
+		recordLayoutTransition(
+			commandBuffers[history][1],
+			outAttachments[i]->image,
+			VK_IMAGE_LAYOUT_GENERAL,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_ACCESS_SHADER_WRITE_BIT,
+			VK_ACCESS_SHADER_READ_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	}
 
-		renderPassInfo.clearValueCount = 1;
-		renderPassInfo.pClearValues = &clearValue;
+	vkCmdWriteTimestamp(commandBuffers[history][1], VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, 1);
 
-		vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	VK_CHECK(vkEndCommandBuffer(commandBuffers[history][1]));
+}
 
-		VkViewport viewport = {};
-		viewport.width = (float) extent.width;
-		viewport.height = (float) extent.height;
-		viewport.minDepth = 0;
-		viewport.maxDepth = 1;
+void SSAOPass::recordDepthPyramid(VkCommandBuffer commandBuffer, VkExtent2D extent)
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[4]);
 
-		vkCmdSetViewport(commandBuffers[i], 0, 1, &viewport);
-		vkCmdSetScissor(commandBuffers[i], 0, 1, &renderArea);
-		vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelines[i]);
+	for (uint32_t level = 1; level < numDepthLevels; level++)
+	{
+		// Each level stays in the general layout and is read as a storage image by the next reduction
+		recordLayoutTransition(
+			commandBuffer,
+			depthPyramid.attachment.image,
+			VK_IMAGE_LAYOUT_GENERAL,
+			VK_IMAGE_LAYOUT_GENERAL,
+			VK_ACCESS_SHADER_WRITE_BIT,
+			VK_ACCESS_SHADER_READ_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			level - 1);
 
-		VkBuffer vertexBuffers[] = { quad->getVertexBuffer() };
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuffers, offsets);
-		vkCmdBindIndexBuffer(commandBuffers[i], quad->getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
 		vkCmdBindDescriptorSets(
-			commandBuffers[i],
-			VK_PIPELINE_BIND_POINT_GRAPHICS,
-			pipelineLayouts[i],
+			commandBuffer,
+			VK_PIPELINE_BIND_POINT_COMPUTE,
+			pipelineLayouts[4],
 			0,
 			1,
-			&descriptorSets[i],
+			&depthMipsDescriptorSets[level - 1],
 			0,
 			nullptr);
 
-		vkCmdDrawIndexed(commandBuffers[i], quad->indices.size(), 1, 0, 0, 1);
-
-		vkCmdEndRenderPass(commandBuffers[i]);
+		uint32_t width = glm::max(extent.width >> level, 1u);
+		uint32_t height = glm::max(extent.height >> level, 1u);
 
-		VK_CHECK(vkEndCommandBuffer(commandBuffers[i]));
+		vkCmdDispatch(commandBuffer, (width + SSAO_TILE_SIZE - 1) / SSAO_TILE_SIZE, (height + SSAO_TILE_SIZE - 1) / SSAO_TILE_SIZE, 1);
 	}
+
+	recordLayoutTransition(
+		commandBuffer,
+		depthPyramid.attachment.image,
+		VK_IMAGE_LAYOUT_GENERAL,
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_ACCESS_SHADER_WRITE_BIT,
+		VK_ACCESS_SHADER_READ_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0,
+		numDepthLevels);
 }
 
 void SSAOPass::initDescriptorSets()
 {
+	initDescriptorSetDownsamplePass();
+
+	depthMipsDescriptorSets.resize(numDepthLevels - 1);
+	for (uint32_t level = 1; level < numDepthLevels; level++) initDescriptorSetDepthMipsPass(level);
+
 	initDescriptorSetMainPass();
-	initDescriptorSetBlurPass();
+
+	if (temporal)
+	{
+		for (size_t i = 0; i < 2; i++)
+		{
+			initDescriptorSetTemporalPass(i);
+			initDescriptorSetBlurPass(horizontalBlurDescriptorSets[i], 0, &historyAttachments[i]);
+		}
+	}
+	else
+	{
+		initDescriptorSetBlurPass(horizontalBlurDescriptorSets[0], 0, &aoAttachment);
+	}
+
+	initDescriptorSetBlurPass(verticalBlurDescriptorSet, 1, &halfBlurredAOAttachment);
+}
+
+void SSAOPass::initDescriptorSetDownsamplePass()
+{
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = VkEngine::getEngine().getDescriptorPool();
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &downsamplePassDescriptorSetLayout;
+
+	VK_CHECK(vkAllocateDescriptorSets(VkEngine::getEngine().getDevice(), &allocInfo, &downsampleDescriptorSet));
+
+	std::vector<VkWriteDescriptorSet> descriptorWrites;
+
+	VkDescriptorBufferInfo cameraBufferInfo = {};
+	cameraBufferInfo.buffer = viewUniformBuffer;
+	cameraBufferInfo.offset = 0;
+	cameraBufferInfo.range = sizeof(SSAOPViewUniformBufferObject);
+
+	VkWriteDescriptorSet cameraDescriptorSet = {};
+	cameraDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	cameraDescriptorSet.dstSet = downsampleDescriptorSet;
+	cameraDescriptorSet.dstBinding = 0;
+	cameraDescriptorSet.dstArrayElement = 0;
+	cameraDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	cameraDescriptorSet.descriptorCount = 1;
+	cameraDescriptorSet.pBufferInfo = &cameraBufferInfo;
+
+	descriptorWrites.push_back(cameraDescriptorSet);
+
+	VkDescriptorImageInfo normalImageInfo = {};
+	normalImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	normalImageInfo.imageView = gBuffer->attachments[GBUFFER_NORMAL_ATTACH_ID].imageView;
+	normalImageInfo.sampler = gBuffer->attachments[GBUFFER_NORMAL_ATTACH_ID].imageSampler;
+
+	VkWriteDescriptorSet normalDescriptorSet = {};
+	normalDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	normalDescriptorSet.dstSet = downsampleDescriptorSet;
+	normalDescriptorSet.dstBinding = 1;
+	normalDescriptorSet.dstArrayElement = 0;
+	normalDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	normalDescriptorSet.descriptorCount = 1;
+	normalDescriptorSet.pImageInfo = &normalImageInfo;
+
+	descriptorWrites.push_back(normalDescriptorSet);
+
+	VkDescriptorImageInfo depthImageInfo = {};
+	depthImageInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	depthImageInfo.imageView = gBuffer->attachments[GBUFFER_DEPTH_ATTACH_ID].imageView;
+	depthImageInfo.sampler = gBuffer->attachments[GBUFFER_DEPTH_ATTACH_ID].imageSampler;
+
+	VkWriteDescriptorSet depthDescriptorSet = {};
+	depthDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	depthDescriptorSet.dstSet = downsampleDescriptorSet;
+	depthDescriptorSet.dstBinding = 2;
+	depthDescriptorSet.dstArrayElement = 0;
+	depthDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	depthDescriptorSet.descriptorCount = 1;
+	depthDescriptorSet.pImageInfo = &depthImageInfo;
+
+	descriptorWrites.push_back(depthDescriptorSet);
+
+	VkDescriptorImageInfo outputImageInfo = {};
+	outputImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+	outputImageInfo.imageView = geometryAttachment.imageView;
+	outputImageInfo.sampler = VK_NULL_HANDLE;
+
+	VkWriteDescriptorSet outputDescriptorSet = {};
+	outputDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	outputDescriptorSet.dstSet = downsampleDescriptorSet;
+	outputDescriptorSet.dstBinding = 3;
+	outputDescriptorSet.dstArrayElement = 0;
+	outputDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	outputDescriptorSet.descriptorCount = 1;
+	outputDescriptorSet.pImageInfo = &outputImageInfo;
+
+	descriptorWrites.push_back(outputDescriptorSet);
+
+	VkDescriptorImageInfo depthOutputImageInfo = {};
+	depthOutputImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+	depthOutputImageInfo.imageView = depthPyramid.levelViews[0];
+	depthOutputImageInfo.sampler = VK_NULL_HANDLE;
+
+	VkWriteDescriptorSet depthOutputDescriptorSet = {};
+	depthOutputDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	depthOutputDescriptorSet.dstSet = downsampleDescriptorSet;
+	depthOutputDescriptorSet.dstBinding = 4;
+	depthOutputDescriptorSet.dstArrayElement = 0;
+	depthOutputDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	depthOutputDescriptorSet.descriptorCount = 1;
+	depthOutputDescriptorSet.pImageInfo = &depthOutputImageInfo;
+
+	descriptorWrites.push_back(depthOutputDescriptorSet);
+
+	vkUpdateDescriptorSets(VkEngine::getEngine().getDevice(), descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
+}
+
+void SSAOPass::initDescriptorSetDepthMipsPass(uint32_t level)
+{
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = VkEngine::getEngine().getDescriptorPool();
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &depthMipsPassDescriptorSetLayout;
+
+	VkDescriptorSet& descriptorSet = depthMipsDescriptorSets[level - 1];
+
+	VK_CHECK(vkAllocateDescriptorSets(VkEngine::getEngine().getDevice(), &allocInfo, &descriptorSet));
+
+	std::vector<VkWriteDescriptorSet> descriptorWrites;
+
+	VkDescriptorImageInfo inputImageInfo = {};
+	inputImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+	inputImageInfo.imageView = depthPyramid.levelViews[level - 1];
+	inputImageInfo.sampler = VK_NULL_HANDLE;
+
+	VkWriteDescriptorSet inputDescriptorSet = {};
+	inputDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	inputDescriptorSet.dstSet = descriptorSet;
+	inputDescriptorSet.dstBinding = 0;
+	inputDescriptorSet.dstArrayElement = 0;
+	inputDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	inputDescriptorSet.descriptorCount = 1;
+	inputDescriptorSet.pImageInfo = &inputImageInfo;
+
+	descriptorWrites.push_back(inputDescriptorSet);
+
+	VkDescriptorImageInfo outputImageInfo = {};
+	outputImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+	outputImageInfo.imageView = depthPyramid.levelViews[level];
+	outputImageInfo.sampler = VK_NULL_HANDLE;
+
+	VkWriteDescriptorSet outputDescriptorSet = {};
+	outputDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	outputDescriptorSet.dstSet = descriptorSet;
+	outputDescriptorSet.dstBinding = 1;
+	outputDescriptorSet.dstArrayElement = 0;
+	outputDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	outputDescriptorSet.descriptorCount = 1;
+	outputDescriptorSet.pImageInfo = &outputImageInfo;
+
+	descriptorWrites.push_back(outputDescriptorSet);
+
+	vkUpdateDescriptorSets(VkEngine::getEngine().getDevice(), descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
 }
 
 void SSAOPass::initDescriptorSetMainPass()
@@ -209,7 +667,7 @@ void SSAOPass::initDescriptorSetMainPass()
 	allocInfo.descriptorSetCount = 1;
 	allocInfo.pSetLayouts = &mainPassDescriptorSetLayout;
 
-	VK_CHECK(vkAllocateDescriptorSets(VkEngine::getEngine().getDevice(), &allocInfo, &descriptorSets[0]));
+	VK_CHECK(vkAllocateDescriptorSets(VkEngine::getEngine().getDevice(), &allocInfo, &mainDescriptorSet));
 
 	std::vector<VkWriteDescriptorSet> descriptorWrites;
 
@@ -220,7 +678,7 @@ void SSAOPass::initDescriptorSetMainPass()
 
 	VkWriteDescriptorSet cameraDescriptorSet = {};
 	cameraDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	cameraDescriptorSet.dstSet = descriptorSets[0];
+	cameraDescriptorSet.dstSet = mainDescriptorSet;
 	cameraDescriptorSet.dstBinding = 0;
 	cameraDescriptorSet.dstArrayElement = 0;
 	cameraDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
@@ -234,16 +692,16 @@ void SSAOPass::initDescriptorSetMainPass()
 	kernelBufferInfo.offset = 0;
 	kernelBufferInfo.range = sizeof(SSAOPKernelUniformBufferObject);
 
-	VkWriteDescriptorSet meshDescriptorSet = {};
-	meshDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	meshDescriptorSet.dstSet = descriptorSets[0];
-	meshDescriptorSet.dstBinding = 1;
-	meshDescriptorSet.dstArrayElement = 0;
-	meshDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	meshDescriptorSet.descriptorCount = 1;
-	meshDescriptorSet.pBufferInfo = &kernelBufferInfo;
+	VkWriteDescriptorSet kernelDescriptorSet = {};
+	kernelDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	kernelDescriptorSet.dstSet = mainDescriptorSet;
+	kernelDescriptorSet.dstBinding = 1;
+	kernelDescriptorSet.dstArrayElement = 0;
+	kernelDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	kernelDescriptorSet.descriptorCount = 1;
+	kernelDescriptorSet.pBufferInfo = &kernelBufferInfo;
 
-	descriptorWrites.push_back(meshDescriptorSet);
+	descriptorWrites.push_back(kernelDescriptorSet);
 
 	VkDescriptorImageInfo noiseImageInfo = {};
 	noiseImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
@@ -252,7 +710,7 @@ void SSAOPass::initDescriptorSetMainPass()
 
 	VkWriteDescriptorSet noiseDescriptorSet = {};
 	noiseDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	noiseDescriptorSet.dstSet = descriptorSets[0];
+	noiseDescriptorSet.dstSet = mainDescriptorSet;
 	noiseDescriptorSet.dstBinding = 2;
 	noiseDescriptorSet.dstArrayElement = 0;
 	noiseDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
@@ -261,42 +719,155 @@ void SSAOPass::initDescriptorSetMainPass()
 
 	descriptorWrites.push_back(noiseDescriptorSet);
 
-	VkDescriptorImageInfo normalImageInfo = {};
-	normalImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	normalImageInfo.imageView = gBuffer->attachments[GBUFFER_NORMAL_ATTACH_ID].imageView;
-	normalImageInfo.sampler = gBuffer->attachments[GBUFFER_NORMAL_ATTACH_ID].imageSampler;
+	VkDescriptorImageInfo geometryImageInfo = {};
+	geometryImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	geometryImageInfo.imageView = geometryAttachment.imageView;
+	geometryImageInfo.sampler = geometryAttachment.imageSampler;
+
+	VkWriteDescriptorSet geometryDescriptorSet = {};
+	geometryDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	geometryDescriptorSet.dstSet = mainDescriptorSet;
+	geometryDescriptorSet.dstBinding = 3;
+	geometryDescriptorSet.dstArrayElement = 0;
+	geometryDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	geometryDescriptorSet.descriptorCount = 1;
+	geometryDescriptorSet.pImageInfo = &geometryImageInfo;
+
+	descriptorWrites.push_back(geometryDescriptorSet);
+
+	VkDescriptorImageInfo outputImageInfo = {};
+	outputImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+	outputImageInfo.imageView = aoAttachment.imageView;
+	outputImageInfo.sampler = VK_NULL_HANDLE;
+
+	VkWriteDescriptorSet outputDescriptorSet = {};
+	outputDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	outputDescriptorSet.dstSet = mainDescriptorSet;
+	outputDescriptorSet.dstBinding = 4;
+	outputDescriptorSet.dstArrayElement = 0;
+	outputDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	outputDescriptorSet.descriptorCount = 1;
+	outputDescriptorSet.pImageInfo = &outputImageInfo;
+
+	descriptorWrites.push_back(outputDescriptorSet);
+
+	VkDescriptorImageInfo depthPyramidImageInfo = {};
+	depthPyramidImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	depthPyramidImageInfo.imageView = depthPyramid.attachment.imageView;
+	depthPyramidImageInfo.sampler = depthPyramid.attachment.imageSampler;
+
+	VkWriteDescriptorSet depthPyramidDescriptorSet = {};
+	depthPyramidDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	depthPyramidDescriptorSet.dstSet = mainDescriptorSet;
+	depthPyramidDescriptorSet.dstBinding = 5;
+	depthPyramidDescriptorSet.dstArrayElement = 0;
+	depthPyramidDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	depthPyramidDescriptorSet.descriptorCount = 1;
+	depthPyramidDescriptorSet.pImageInfo = &depthPyramidImageInfo;
+
+	descriptorWrites.push_back(depthPyramidDescriptorSet);
 
-	VkWriteDescriptorSet normalDescriptorSet = {};
-	normalDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	normalDescriptorSet.dstSet = descriptorSets[0];
-	normalDescriptorSet.dstBinding = 3;
-	normalDescriptorSet.dstArrayElement = 0;
-	normalDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	normalDescriptorSet.descriptorCount = 1;
-	normalDescriptorSet.pImageInfo = &normalImageInfo;
+	vkUpdateDescriptorSets(VkEngine::getEngine().getDevice(), descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
+}
 
-	descriptorWrites.push_back(normalDescriptorSet);
+void SSAOPass::initDescriptorSetTemporalPass(size_t history)
+{
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = VkEngine::getEngine().getDescriptorPool();
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &temporalPassDescriptorSetLayout;
 
-	VkDescriptorImageInfo depthImageInfo = {};
-	depthImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	depthImageInfo.imageView = gBuffer->attachments[GBUFFER_DEPTH_ATTACH_ID].imageView;
-	depthImageInfo.sampler = gBuffer->attachments[GBUFFER_DEPTH_ATTACH_ID].imageSampler;
+	VkDescriptorSet& descriptorSet = temporalDescriptorSets[history];
 
-	VkWriteDescriptorSet depthDescriptorSet = {};
-	depthDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	depthDescriptorSet.dstSet = descriptorSets[0];
-	depthDescriptorSet.dstBinding = 4;
-	depthDescriptorSet.dstArrayElement = 0;
-	depthDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	depthDescriptorSet.descriptorCount = 1;
-	depthDescriptorSet.pImageInfo = &depthImageInfo;
+	VK_CHECK(vkAllocateDescriptorSets(VkEngine::getEngine().getDevice(), &allocInfo, &descriptorSet));
 
-	descriptorWrites.push_back(depthDescriptorSet);
+	std::vector<VkWriteDescriptorSet> descriptorWrites;
+
+	VkDescriptorBufferInfo cameraBufferInfo = {};
+	cameraBufferInfo.buffer = viewUniformBuffer;
+	cameraBufferInfo.offset = 0;
+	cameraBufferInfo.range = sizeof(SSAOPViewUniformBufferObject);
+
+	VkWriteDescriptorSet cameraDescriptorSet = {};
+	cameraDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	cameraDescriptorSet.dstSet = descriptorSet;
+	cameraDescriptorSet.dstBinding = 0;
+	cameraDescriptorSet.dstArrayElement = 0;
+	cameraDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	cameraDescriptorSet.descriptorCount = 1;
+	cameraDescriptorSet.pBufferInfo = &cameraBufferInfo;
+
+	descriptorWrites.push_back(cameraDescriptorSet);
+
+	VkDescriptorImageInfo aoImageInfo = {};
+	aoImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	aoImageInfo.imageView = aoAttachment.imageView;
+	aoImageInfo.sampler = aoAttachment.imageSampler;
+
+	VkWriteDescriptorSet aoDescriptorSet = {};
+	aoDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	aoDescriptorSet.dstSet = descriptorSet;
+	aoDescriptorSet.dstBinding = 1;
+	aoDescriptorSet.dstArrayElement = 0;
+	aoDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	aoDescriptorSet.descriptorCount = 1;
+	aoDescriptorSet.pImageInfo = &aoImageInfo;
+
+	descriptorWrites.push_back(aoDescriptorSet);
+
+	VkDescriptorImageInfo geometryImageInfo = {};
+	geometryImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	geometryImageInfo.imageView = geometryAttachment.imageView;
+	geometryImageInfo.sampler = geometryAttachment.imageSampler;
+
+	VkWriteDescriptorSet geometryDescriptorSet = {};
+	geometryDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	geometryDescriptorSet.dstSet = descriptorSet;
+	geometryDescriptorSet.dstBinding = 2;
+	geometryDescriptorSet.dstArrayElement = 0;
+	geometryDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	geometryDescriptorSet.descriptorCount = 1;
+	geometryDescriptorSet.pImageInfo = &geometryImageInfo;
+
+	descriptorWrites.push_back(geometryDescriptorSet);
+
+	VkDescriptorImageInfo historyImageInfo = {};
+	historyImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	historyImageInfo.imageView = historyAttachments[1 - history].imageView;
+	historyImageInfo.sampler = historyAttachments[1 - history].imageSampler;
+
+	VkWriteDescriptorSet historyDescriptorSet = {};
+	historyDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	historyDescriptorSet.dstSet = descriptorSet;
+	historyDescriptorSet.dstBinding = 3;
+	historyDescriptorSet.dstArrayElement = 0;
+	historyDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	historyDescriptorSet.descriptorCount = 1;
+	historyDescriptorSet.pImageInfo = &historyImageInfo;
+
+	descriptorWrites.push_back(historyDescriptorSet);
+
+	VkDescriptorImageInfo outputImageInfo = {};
+	outputImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+	outputImageInfo.imageView = historyAttachments[history].imageView;
+	outputImageInfo.sampler = VK_NULL_HANDLE;
+
+	VkWriteDescriptorSet outputDescriptorSet = {};
+	outputDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	outputDescriptorSet.dstSet = descriptorSet;
+	outputDescriptorSet.dstBinding = 4;
+	outputDescriptorSet.dstArrayElement = 0;
+	outputDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	outputDescriptorSet.descriptorCount = 1;
+	outputDescriptorSet.pImageInfo = &outputImageInfo;
+
+	descriptorWrites.push_back(outputDescriptorSet);
 
 	vkUpdateDescriptorSets(VkEngine::getEngine().getDevice(), descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
 }
 
-void SSAOPass::initDescriptorSetBlurPass()
+void SSAOPass::initDescriptorSetBlurPass(VkDescriptorSet& descriptorSet, size_t direction, GBufferAttachment* inAttachment)
 {
 	VkDescriptorSetAllocateInfo allocInfo = {};
 	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
@@ -304,19 +875,37 @@ void SSAOPass::initDescriptorSetBlurPass()
 	allocInfo.descriptorSetCount = 1;
 	allocInfo.pSetLayouts = &blurPassDescriptorSetLayout;
 
-	VK_CHECK(vkAllocateDescriptorSets(VkEngine::getEngine().getDevice(), &allocInfo, &descriptorSets[1]));
+	VK_CHECK(vkAllocateDescriptorSets(VkEngine::getEngine().getDevice(), &allocInfo, &descriptorSet));
+
+	GBufferAttachment* outAttachment = direction == 0 ? &halfBlurredAOAttachment : &blurredAOAttachment;
 
 	std::vector<VkWriteDescriptorSet> descriptorWrites;
 
+	VkDescriptorBufferInfo blurBufferInfo = {};
+	blurBufferInfo.buffer = blurUniformBuffers[direction];
+	blurBufferInfo.offset = 0;
+	blurBufferInfo.range = sizeof(SSAOPBlurUniformBufferObject);
+
+	VkWriteDescriptorSet blurDescriptorSet = {};
+	blurDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	blurDescriptorSet.dstSet = descriptorSet;
+	blurDescriptorSet.dstBinding = 0;
+	blurDescriptorSet.dstArrayElement = 0;
+	blurDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	blurDescriptorSet.descriptorCount = 1;
+	blurDescriptorSet.pBufferInfo = &blurBufferInfo;
+
+	descriptorWrites.push_back(blurDescriptorSet);
+
 	VkDescriptorImageInfo aoImageInfo = {};
 	aoImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	aoImageInfo.imageView = aoAttachment.imageView;
-	aoImageInfo.sampler = aoAttachment.imageSampler;
-	
+	aoImageInfo.imageView = inAttachment->imageView;
+	aoImageInfo.sampler = inAttachment->imageSampler;
+
 	VkWriteDescriptorSet aoDescriptorSet = {};
 	aoDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	aoDescriptorSet.dstSet = descriptorSets[1];
-	aoDescriptorSet.dstBinding = 0;
+	aoDescriptorSet.dstSet = descriptorSet;
+	aoDescriptorSet.dstBinding = 1;
 	aoDescriptorSet.dstArrayElement = 0;
 	aoDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	aoDescriptorSet.descriptorCount = 1;
@@ -324,15 +913,127 @@ void SSAOPass::initDescriptorSetBlurPass()
 
 	descriptorWrites.push_back(aoDescriptorSet);
 
+	VkDescriptorImageInfo geometryImageInfo = {};
+	geometryImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	geometryImageInfo.imageView = geometryAttachment.imageView;
+	geometryImageInfo.sampler = geometryAttachment.imageSampler;
+
+	VkWriteDescriptorSet geometryDescriptorSet = {};
+	geometryDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	geometryDescriptorSet.dstSet = descriptorSet;
+	geometryDescriptorSet.dstBinding = 2;
+	geometryDescriptorSet.dstArrayElement = 0;
+	geometryDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	geometryDescriptorSet.descriptorCount = 1;
+	geometryDescriptorSet.pImageInfo = &geometryImageInfo;
+
+	descriptorWrites.push_back(geometryDescriptorSet);
+
+	VkDescriptorImageInfo outputImageInfo = {};
+	outputImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+	outputImageInfo.imageView = outAttachment->imageView;
+	outputImageInfo.sampler = VK_NULL_HANDLE;
+
+	VkWriteDescriptorSet outputDescriptorSet = {};
+	outputDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	outputDescriptorSet.dstSet = descriptorSet;
+	outputDescriptorSet.dstBinding = 3;
+	outputDescriptorSet.dstArrayElement = 0;
+	outputDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	outputDescriptorSet.descriptorCount = 1;
+	outputDescriptorSet.pImageInfo = &outputImageInfo;
+
+	descriptorWrites.push_back(outputDescriptorSet);
+
 	vkUpdateDescriptorSets(VkEngine::getEngine().getDevice(), descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
 }
 
 void SSAOPass::initDescriptorSetLayout()
 {
+	initDescriptorSetLayoutDownsamplePass();
+	initDescriptorSetLayoutDepthMipsPass();
 	initDescriptorSetLayoutMainPass();
+	initDescriptorSetLayoutTemporalPass();
 	initDescriptorSetLayoutBlurPass();
 }
 
+void SSAOPass::initDescriptorSetLayoutDownsamplePass()
+{
+	std::vector<VkDescriptorSetLayoutBinding> bindings;
+
+	VkDescriptorSetLayoutBinding cameraUBOLayoutBinding = {};
+	cameraUBOLayoutBinding.binding = 0;
+	cameraUBOLayoutBinding.descriptorCount = 1;
+	cameraUBOLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	cameraUBOLayoutBinding.pImmutableSamplers = nullptr;
+	cameraUBOLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings.push_back(cameraUBOLayoutBinding);
+
+	VkDescriptorSetLayoutBinding normalLayoutBinding = {};
+	normalLayoutBinding.binding = 1;
+	normalLayoutBinding.descriptorCount = 1;
+	normalLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	normalLayoutBinding.pImmutableSamplers = nullptr;
+	normalLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings.push_back(normalLayoutBinding);
+
+	VkDescriptorSetLayoutBinding depthLayoutBinding = {};
+	depthLayoutBinding.binding = 2;
+	depthLayoutBinding.descriptorCount = 1;
+	depthLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	depthLayoutBinding.pImmutableSamplers = nullptr;
+	depthLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings.push_back(depthLayoutBinding);
+
+	VkDescriptorSetLayoutBinding outputLayoutBinding = {};
+	outputLayoutBinding.binding = 3;
+	outputLayoutBinding.descriptorCount = 1;
+	outputLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	outputLayoutBinding.pImmutableSamplers = nullptr;
+	outputLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings.push_back(outputLayoutBinding);
+
+	VkDescriptorSetLayoutBinding depthOutputLayoutBinding = {};
+	depthOutputLayoutBinding.binding = 4;
+	depthOutputLayoutBinding.descriptorCount = 1;
+	depthOutputLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	depthOutputLayoutBinding.pImmutableSamplers = nullptr;
+	depthOutputLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings.push_back(depthOutputLayoutBinding);
+
+	downsamplePassDescriptorSetLayout = VkEngine::getEngine().getPool()->createDescriptorSetLayout(bindings);
+}
+
+void SSAOPass::initDescriptorSetLayoutDepthMipsPass()
+{
+	std::vector<VkDescriptorSetLayoutBinding> bindings;
+
+	VkDescriptorSetLayoutBinding inputLayoutBinding = {};
+	inputLayoutBinding.binding = 0;
+	inputLayoutBinding.descriptorCount = 1;
+	inputLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	inputLayoutBinding.pImmutableSamplers = nullptr;
+	inputLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings.push_back(inputLayoutBinding);
+
+	VkDescriptorSetLayoutBinding outputLayoutBinding = {};
+	outputLayoutBinding.binding = 1;
+	outputLayoutBinding.descriptorCount = 1;
+	outputLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	outputLayoutBinding.pImmutableSamplers = nullptr;
+	outputLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings.push_back(outputLayoutBinding);
+
+	depthMipsPassDescriptorSetLayout = VkEngine::getEngine().getPool()->createDescriptorSetLayout(bindings);
+}
+
 void SSAOPass::initDescriptorSetLayoutMainPass()
 {
 	std::vector<VkDescriptorSetLayoutBinding> bindings;
@@ -342,7 +1043,7 @@ void SSAOPass::initDescriptorSetLayoutMainPass()
 	cameraUBOLayoutBinding.descriptorCount = 1;
 	cameraUBOLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 	cameraUBOLayoutBinding.pImmutableSamplers = nullptr;
-	cameraUBOLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	cameraUBOLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
 	bindings.push_back(cameraUBOLayoutBinding);
 
@@ -351,88 +1052,142 @@ void SSAOPass::initDescriptorSetLayoutMainPass()
 	kernelUBOLayoutBinding.descriptorCount = 1;
 	kernelUBOLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 	kernelUBOLayoutBinding.pImmutableSamplers = nullptr;
-	kernelUBOLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	kernelUBOLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
 	bindings.push_back(kernelUBOLayoutBinding);
 
-	VkDescriptorSetLayoutBinding noiseUBOLayoutBinding = {};
-	noiseUBOLayoutBinding.binding = 2;
-	noiseUBOLayoutBinding.descriptorCount = 1;
-	noiseUBOLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	noiseUBOLayoutBinding.pImmutableSamplers = nullptr;
-	noiseUBOLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	VkDescriptorSetLayoutBinding noiseLayoutBinding = {};
+	noiseLayoutBinding.binding = 2;
+	noiseLayoutBinding.descriptorCount = 1;
+	noiseLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	noiseLayoutBinding.pImmutableSamplers = nullptr;
+	noiseLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
-	bindings.push_back(noiseUBOLayoutBinding);
+	bindings.push_back(noiseLayoutBinding);
 
-	VkDescriptorSetLayoutBinding normalUBOLayoutBinding = {};
-	normalUBOLayoutBinding.binding = 3;
-	normalUBOLayoutBinding.descriptorCount = 1;
-	normalUBOLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	normalUBOLayoutBinding.pImmutableSamplers = nullptr;
-	normalUBOLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	VkDescriptorSetLayoutBinding geometryLayoutBinding = {};
+	geometryLayoutBinding.binding = 3;
+	geometryLayoutBinding.descriptorCount = 1;
+	geometryLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	geometryLayoutBinding.pImmutableSamplers = nullptr;
+	geometryLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
-	bindings.push_back(normalUBOLayoutBinding);
+	bindings.push_back(geometryLayoutBinding);
 
-	VkDescriptorSetLayoutBinding depthUBOLayoutBinding = {};
-	depthUBOLayoutBinding.binding = 4;
-	depthUBOLayoutBinding.descriptorCount = 1;
-	depthUBOLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	depthUBOLayoutBinding.pImmutableSamplers = nullptr;
-	depthUBOLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	VkDescriptorSetLayoutBinding outputLayoutBinding = {};
+	outputLayoutBinding.binding = 4;
+	outputLayoutBinding.descriptorCount = 1;
+	outputLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	outputLayoutBinding.pImmutableSamplers = nullptr;
+	outputLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
-	bindings.push_back(depthUBOLayoutBinding);
+	bindings.push_back(outputLayoutBinding);
+
+	VkDescriptorSetLayoutBinding depthPyramidLayoutBinding = {};
+	depthPyramidLayoutBinding.binding = 5;
+	depthPyramidLayoutBinding.descriptorCount = 1;
+	depthPyramidLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	depthPyramidLayoutBinding.pImmutableSamplers = nullptr;
+	depthPyramidLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings.push_back(depthPyramidLayoutBinding);
 
 	mainPassDescriptorSetLayout = VkEngine::getEngine().getPool()->createDescriptorSetLayout(bindings);
 }
 
-void SSAOPass::initDescriptorSetLayoutBlurPass()
+void SSAOPass::initDescriptorSetLayoutTemporalPass()
 {
 	std::vector<VkDescriptorSetLayoutBinding> bindings;
 
+	VkDescriptorSetLayoutBinding cameraUBOLayoutBinding = {};
+	cameraUBOLayoutBinding.binding = 0;
+	cameraUBOLayoutBinding.descriptorCount = 1;
+	cameraUBOLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	cameraUBOLayoutBinding.pImmutableSamplers = nullptr;
+	cameraUBOLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings.push_back(cameraUBOLayoutBinding);
+
 	VkDescriptorSetLayoutBinding aoLayoutBinding = {};
-	aoLayoutBinding.binding = 0;
+	aoLayoutBinding.binding = 1;
 	aoLayoutBinding.descriptorCount = 1;
 	aoLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	aoLayoutBinding.pImmutableSamplers = nullptr;
-	aoLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	aoLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
 	bindings.push_back(aoLayoutBinding);
 
-	blurPassDescriptorSetLayout = VkEngine::getEngine().getPool()->createDescriptorSetLayout(bindings);
+	VkDescriptorSetLayoutBinding geometryLayoutBinding = {};
+	geometryLayoutBinding.binding = 2;
+	geometryLayoutBinding.descriptorCount = 1;
+	geometryLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	geometryLayoutBinding.pImmutableSamplers = nullptr;
+	geometryLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings.push_back(geometryLayoutBinding);
+
+	VkDescriptorSetLayoutBinding historyLayoutBinding = {};
+	historyLayoutBinding.binding = 3;
+	historyLayoutBinding.descriptorCount = 1;
+	historyLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	historyLayoutBinding.pImmutableSamplers = nullptr;
+	historyLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings.push_back(historyLayoutBinding);
+
+	VkDescriptorSetLayoutBinding outputLayoutBinding = {};
+	outputLayoutBinding.binding = 4;
+	outputLayoutBinding.descriptorCount = 1;
+	outputLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	outputLayoutBinding.pImmutableSamplers = nullptr;
+	outputLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings.push_back(outputLayoutBinding);
+
+	temporalPassDescriptorSetLayout = VkEngine::getEngine().getPool()->createDescriptorSetLayout(bindings);
 }
 
-void SSAOPass::initGraphicsPipeline()
+void SSAOPass::initDescriptorSetLayoutBlurPass()
 {
-	std::vector<char> vs = readFile(mainVSPath);
-	std::vector<char> fs = readFile(mainFSPath);
-	std::vector<char> gs;
+	std::vector<VkDescriptorSetLayoutBinding> bindings;
 
-	PipelineData pipelineData = VkEngine::getEngine().getPool()->createPipeline(
-		renderPass,
-		mainPassDescriptorSetLayout,
-		VkEngine::getEngine().getSwapchainExtent(),
-		vs,
-		fs,
-		gs,
-		1);
+	VkDescriptorSetLayoutBinding blurUBOLayoutBinding = {};
+	blurUBOLayoutBinding.binding = 0;
+	blurUBOLayoutBinding.descriptorCount = 1;
+	blurUBOLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	blurUBOLayoutBinding.pImmutableSamplers = nullptr;
+	blurUBOLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
-	pipelines[0] = pipelineData.pipeline;
-	pipelineLayouts[0] = pipelineData.pipelineLayout;
+	bindings.push_back(blurUBOLayoutBinding);
 
-	vs = readFile(blurVSPath);
-	fs = readFile(blurFSPath);
+	VkDescriptorSetLayoutBinding aoLayoutBinding = {};
+	aoLayoutBinding.binding = 1;
+	aoLayoutBinding.descriptorCount = 1;
+	aoLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	aoLayoutBinding.pImmutableSamplers = nullptr;
+	aoLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
-	pipelineData = VkEngine::getEngine().getPool()->createPipeline(
-		renderPass,
-		blurPassDescriptorSetLayout,
-		VkEngine::getEngine().getSwapchainExtent(),
-		vs,
-		fs,
-		gs,
-		1);
+	bindings.push_back(aoLayoutBinding);
 
-	pipelines[1] = pipelineData.pipeline;
-	pipelineLayouts[1] = pipelineData.pipelineLayout;
+	VkDescriptorSetLayoutBinding geometryLayoutBinding = {};
+	geometryLayoutBinding.binding = 2;
+	geometryLayoutBinding.descriptorCount = 1;
+	geometryLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	geometryLayoutBinding.pImmutableSamplers = nullptr;
+	geometryLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings.push_back(geometryLayoutBinding);
+
+	VkDescriptorSetLayoutBinding outputLayoutBinding = {};
+	outputLayoutBinding.binding = 3;
+	outputLayoutBinding.descriptorCount = 1;
+	outputLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	outputLayoutBinding.pImmutableSamplers = nullptr;
+	outputLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings.push_back(outputLayoutBinding);
+
+	blurPassDescriptorSetLayout = VkEngine::getEngine().getPool()->createDescriptorSetLayout(bindings);
 }
 
 void SSAOPass::initUniformBuffer()
@@ -452,12 +1207,23 @@ void SSAOPass::initUniformBuffer()
 	kernelUniformStagingBufferMemory = meshBufferDataVec[0].bufferMemory;
 	kernelUniformBuffer = meshBufferDataVec[1].buffer;
 	kernelUniformBufferMemory = meshBufferDataVec[1].bufferMemory;
+
+	VkDeviceSize blurBufferSize = sizeof(SSAOPBlurUniformBufferObject);
+
+	for (size_t i = 0; i < 2; i++)
+	{
+		std::vector<BufferData> blurBufferDataVec = VkEngine::getEngine().getPool()->createUniformBuffer(blurBufferSize, true);
+		blurUniformStagingBuffers[i] = blurBufferDataVec[0].buffer;
+		blurUniformStagingBufferMemories[i] = blurBufferDataVec[0].bufferMemory;
+		blurUniformBuffers[i] = blurBufferDataVec[1].buffer;
+		blurUniformBufferMemories[i] = blurBufferDataVec[1].bufferMemory;
+	}
 }
 
 void SSAOPass::loadKernelUniforms()
 {
 	SSAOPKernelUniformBufferObject ubo = {};
-	for (size_t i = 0; i < KERNEL_SIZE; i++) { ubo.sampleKernel[i] = sampleKernel[i]; }
+	for (size_t i = 0; i < kernelSize; i++) { ubo.sampleKernel[i] = sampleKernel[i]; }
 
 	updateBuffer(
 		VkEngine::getEngine().getDevice(),
@@ -470,6 +1236,27 @@ void SSAOPass::loadKernelUniforms()
 		kernelUniformStagingBuffer);
 }
 
+void SSAOPass::loadBlurUniforms()
+{
+	std::array<glm::vec2, 2> blurDirections = { glm::vec2(1, 0), glm::vec2(0, 1) };
+
+	for (size_t i = 0; i < 2; i++)
+	{
+		SSAOPBlurUniformBufferObject ubo = {};
+		ubo.blurDirection = blurDirections[i];
+
+		updateBuffer(
+			VkEngine::getEngine().getDevice(),
+			VkEngine::getEngine().getCommandPool(),
+			VkEngine::getEngine().getGraphicsQueue(),
+			&ubo,
+			sizeof(ubo),
+			blurUniformStagingBufferMemories[i],
+			blurUniformBuffers[i],
+			blurUniformStagingBuffers[i]);
+	}
+}
+
 void SSAOPass::loadViewUniforms()
 {
 	Camera* camera = VkEngine::getEngine().getScene()->getCamera();
@@ -488,6 +1275,23 @@ void SSAOPass::loadViewUniforms()
 	ubo.view = camera->getViewMatrix();
 	ubo.proj = camera->getProjMatrix();
 	ubo.invProj = glm::inverse(ubo.proj);
+	ubo.invView = glm::inverse(ubo.view);
+	ubo.prevViewProj = prevViewProj;
+
+	if (temporal && VkEngine::getEngine().isSSAOEnabled())
+	{
+		// Each frame takes the next slice of the kernel and the next layer of the noise
+		ubo.temporal = glm::vec4((frameIndex * SSAO_TEMPORAL_SAMPLES) % kernelSize, glm::min(uint32_t(SSAO_TEMPORAL_SAMPLES), kernelSize), 
+			frameIndex % BLUE_NOISE_LAYERS, historyValid);
+		historyValid = true;
+	}
+	else
+	{
+		ubo.temporal = glm::vec4(0, kernelSize, 0, 0);
+		historyValid = false;
+	}
+
+	prevViewProj = ubo.proj * ubo.view;
 
 	updateBuffer(
 		VkEngine::getEngine().getDevice(),
@@ -500,12 +1304,15 @@ void SSAOPass::loadViewUniforms()
 		viewUniformStagingBuffer);
 }
 
-void SSAOPass::initBufferData()
-{
-	loadKernelUniforms();
-}
-
+// The blur directions never change and the kernel only with the quality preset, only the view is refreshed every frame
 void SSAOPass::updateBufferData()
 {
+	if (temporal)
+	{
+		// Ping-pong: this frame writes the history image the previous one read from
+		currentHistory = 1 - currentHistory;
+		frameIndex++;
+	}
+
 	loadViewUniforms();
 }
\ No newline at end of file
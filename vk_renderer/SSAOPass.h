@@ -1,12 +1,24 @@
 #pragma once
 
+#include "BlueNoise.h"
+#include "Config.h"
 #include "Pass.h"
-#include "Quad.h"
 #include "Scene.h"
+#include "VkPool.h"
 
 
+// Default sample count of the Crysis kernel, the main pass is specialized with the one of the quality preset
 #define KERNEL_SIZE 16
-#define NOISE_SIZE	4
+// Room in the kernel uniform buffer
+#define SSAO_MAX_KERNEL_SIZE	32
+// The main pass works on square tiles, caching their depth plus an apron in shared memory
+#define SSAO_TILE_SIZE	16
+// The blurs work on runs of pixels along their direction, like the SSS ones
+#define SSAO_BLUR_TILE_SIZE	128
+// Levels of the linear depth pyramid samples beyond the cached tile read from, fewer if AO is smaller than that
+#define SSAO_DEPTH_MIP_LEVELS	5
+// Kernel samples taken per frame when accumulating temporally, the whole kernel is covered every kernel size / SSAO_TEMPORAL_SAMPLES frames
+#define SSAO_TEMPORAL_SAMPLES	8
 
 
 struct SSAOPViewUniformBufferObject {
@@ -14,62 +26,119 @@ struct SSAOPViewUniformBufferObject {
 	glm::mat4 view;
 	glm::mat4 proj;
 	glm::mat4 invProj;
+	glm::mat4 invView;
+	glm::mat4 prevViewProj;
+	// x: first kernel sample, y: samples taken this frame, z: blue noise layer, w: whether the history can be reprojected
+	glm::vec4 temporal;
 };
 
 struct SSAOPKernelUniformBufferObject {
-	glm::vec4 sampleKernel[KERNEL_SIZE];
+	glm::vec4 sampleKernel[SSAO_MAX_KERNEL_SIZE];
+};
+
+struct SSAOPBlurUniformBufferObject {
+	glm::vec2 blurDirection;
 };
 
 
 class SSAOPass : public Pass {
 public:
-	SSAOPass(std::string mainVSPath, std::string mainFSPath, 
-			 std::string blurVSPath, std::string blurFSPath, GBuffer* gBuffer) :
-			 mainVSPath(mainVSPath), mainFSPath(mainFSPath),
-			 blurVSPath(blurVSPath), blurFSPath(blurFSPath), gBuffer(gBuffer)
+	// AO is computed and blurred downsample times smaller than the swapchain on each axis,
+	// the lighting pass upsamples it bilaterally. When temporal, each frame takes part of the kernel and
+	// blends it into the reprojected history of the previous frames before blurring.
+	// There is one main pass per AO algorithm: they all read the same bindings (view, kernel, noise, reduced geometry,
+	// depth pyramid) and write visibility to the same image, so switching between them leaves the rest untouched.
+	// The blue noise texture is shared with other passes, its owner outlives this one
+	SSAOPass(std::string downsampleCSPath, std::string depthMipsCSPath, std::array<std::string, AO_NUM_ALGORITHMS> mainCSPaths,
+			 std::string temporalCSPath, std::string blurCSPath, GBuffer* gBuffer, Texture* noiseTexture, uint32_t downsample = 1, 
+			 bool temporal = false, AOAlgorithm algorithm = AO_CRYSIS, uint32_t kernelSize = KERNEL_SIZE) :
+			 downsampleCSPath(downsampleCSPath), depthMipsCSPath(depthMipsCSPath), mainCSPaths(mainCSPaths), temporalCSPath(temporalCSPath),
+			 blurCSPath(blurCSPath), gBuffer(gBuffer), noiseTexture(noiseTexture), downsample(downsample), temporal(temporal), algorithm(algorithm),
+			 kernelSize(glm::min(kernelSize, uint32_t(SSAO_MAX_KERNEL_SIZE)))
 	{
-		quad = new Quad();
-
 		computeNoiseScale();
 		computeKernel();
-		computeNoiseTexels();
-		loadNoiseTexture();
 	}
-	~SSAOPass() { delete noiseTexture; delete quad; }
+	~SSAOPass() { }
 
-	VkCommandBuffer getMainPassCmdBuffer() const { return commandBuffers[0]; }
-	VkCommandBuffer getBlurPassCmdBuffer() const { return commandBuffers[1]; }
+	virtual void initLayouts() override;
+	virtual void initPipelines() override;
+	virtual void initResources() override;
+
+	VkCommandBuffer getMainPassCmdBuffer() const { return commandBuffers[currentHistory][0]; }
+	VkCommandBuffer getBlurPassCmdBuffer() const { return commandBuffers[currentHistory][1]; }
 	GBufferAttachment* getAOMap() { return &blurredAOAttachment; }
+	AOAlgorithm getAlgorithm() const { return algorithm; }
+	void setAlgorithm(AOAlgorithm algorithm);
+	// Only the Crysis main pass takes a kernel, the others ignore it
+	void setKernelSize(uint32_t kernelSize);
+	// Milliseconds the GPU spent between the start of the main pass and the end of the blurs in the last frame submitted,
+	// waits for it to complete
+	float getGPUTime();
 
-	virtual void initBufferData() override;
 	virtual void updateBufferData() override;
 
 private:
-	std::string mainVSPath;
-	std::string mainFSPath;
-	std::string blurVSPath;
-	std::string blurFSPath;
-
-	VkRenderPass renderPass;
-	VkSemaphore mainPassSemaphore;
-	std::array<VkCommandBuffer, 2> commandBuffers;
-	std::array<VkFramebuffer, 2> framebuffers;
-	std::array<VkDescriptorSet, 2> descriptorSets;
-	std::array<VkPipeline, 2> pipelines;
-	std::array<VkPipelineLayout, 2> pipelineLayouts;
+	std::string downsampleCSPath;
+	std::string depthMipsCSPath;
+	std::array<std::string, AO_NUM_ALGORITHMS> mainCSPaths;
+	std::string temporalCSPath;
+	std::string blurCSPath;
+
+	// Per history image written: downsample, depth pyramid, main pass and temporal resolve, then both blur directions back to back.
+	// Without temporal accumulation only the first pair is recorded
+	std::array<std::array<VkCommandBuffer, 2>, 2> commandBuffers;
+	VkDescriptorSet downsampleDescriptorSet;
+	// One per pyramid level after the first, each reduces the level above it
+	std::vector<VkDescriptorSet> depthMipsDescriptorSets;
+	VkDescriptorSet mainDescriptorSet;
+	// Per history image written, reading the other one
+	std::array<VkDescriptorSet, 2> temporalDescriptorSets;
+	// Per history image written, which is what the horizontal blur starts from when accumulating
+	std::array<VkDescriptorSet, 2> horizontalBlurDescriptorSets;
+	VkDescriptorSet verticalBlurDescriptorSet;
+	// Downsample, main pass of the current algorithm, blur, temporal resolve, depth pyramid
+	std::array<VkPipeline, 5> pipelines;
+	std::array<VkPipelineLayout, 5> pipelineLayouts;
+	// Specialized with the kernel size, each permutation kept once created so that switching back only takes recording
+	// the command buffers again
+	std::array<PipelinePermutations, AO_NUM_ALGORITHMS> mainPipelinePermutations;
+	// Start of the main pass, end of the blurs
+	VkQueryPool timestampQueryPool;
+	float timestampPeriod;
+	VkDescriptorSetLayout downsamplePassDescriptorSetLayout;
+	VkDescriptorSetLayout depthMipsPassDescriptorSetLayout;
 	VkDescriptorSetLayout mainPassDescriptorSetLayout;
+	VkDescriptorSetLayout temporalPassDescriptorSetLayout;
 	VkDescriptorSetLayout blurPassDescriptorSetLayout;
 	GBuffer* gBuffer;
-
-	glm::vec4 sampleKernel[KERNEL_SIZE];
-	std::vector<glm::vec4> noiseTexels;
+	// Blue noise, a new layer every frame when accumulating temporally
 	Texture* noiseTexture;
+	uint32_t downsample;
+	bool temporal;
+	AOAlgorithm algorithm;
+	uint32_t kernelSize;
+
+	uint32_t frameIndex = 0;
+	uint32_t currentHistory = 0;
+	// Cleared whenever AO is toggled, so that stale results are not blended back in
+	bool historyValid = false;
+	glm::mat4 prevViewProj;
+
+	glm::vec4 sampleKernel[SSAO_MAX_KERNEL_SIZE];
 	glm::vec2 noiseScale;
 
-	Quad* quad;
+	// All written as storage images at reduced resolution, then sampled by the next dispatch or by the lighting pass.
+	// View-space normal and linear view depth, read by every later step instead of the full-resolution G-buffer
+	GBufferAttachment geometryAttachment;
+	// Linear depth again, the first level written with the geometry and the others reduced from it
+	DepthPyramid depthPyramid;
+	uint32_t numDepthLevels;
 	GBufferAttachment aoAttachment;
+	GBufferAttachment halfBlurredAOAttachment;
 	GBufferAttachment blurredAOAttachment;
-	VkAttachmentDescription colorAttachment;
+	// x: accumulated AO, y: number of frames accumulated, z: linear view depth it was computed at
+	std::array<GBufferAttachment, 2> historyAttachments;
 	SSAOPViewUniformBufferObject viewUBO;
 	SSAOPKernelUniformBufferObject kernelUBO;
 	VkBuffer viewUniformStagingBuffer;
@@ -80,24 +149,39 @@ private:
 	VkDeviceMemory kernelUniformStagingBufferMemory;
 	VkBuffer kernelUniformBuffer;
 	VkDeviceMemory kernelUniformBufferMemory;
+	// One per blur direction, written once
+	std::array<VkBuffer, 2> blurUniformStagingBuffers;
+	std::array<VkDeviceMemory, 2> blurUniformStagingBufferMemories;
+	std::array<VkBuffer, 2> blurUniformBuffers;
+	std::array<VkDeviceMemory, 2> blurUniformBufferMemories;
 
 	virtual void initAttachments() override;
 	virtual void initCommandBuffers() override;
 	virtual void initDescriptorSets() override;
 	virtual void initDescriptorSetLayout() override;
-	virtual void initGraphicsPipeline() override;
+	virtual void initGraphicsPipeline() override { /*NOP*/ }
 	virtual void initUniformBuffer() override;
-	virtual void initSemaphores() override;
+
+	void initComputePipeline();
+	void recordCommandBuffers(size_t history);
+	void switchMainPipeline();
+	SpecializationConstants getMainPassConstants() const;
+	void recordDepthPyramid(VkCommandBuffer commandBuffer, VkExtent2D extent);
 
 	void computeNoiseScale();
 	void computeKernel();
-	void computeNoiseTexels();
-	void loadNoiseTexture();
 	void loadKernelUniforms();
+	void loadBlurUniforms();
 	void loadViewUniforms();
 
+	void initDescriptorSetDownsamplePass();
+	void initDescriptorSetDepthMipsPass(uint32_t level);
 	void initDescriptorSetMainPass();
-	void initDescriptorSetBlurPass();
+	void initDescriptorSetTemporalPass(size_t history);
+	void initDescriptorSetBlurPass(VkDescriptorSet& descriptorSet, size_t direction, GBufferAttachment* inAttachment);
+	void initDescriptorSetLayoutDownsamplePass();
+	void initDescriptorSetLayoutDepthMipsPass();
 	void initDescriptorSetLayoutMainPass();
+	void initDescriptorSetLayoutTemporalPass();
 	void initDescriptorSetLayoutBlurPass();
 };
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "Scene.h"
 
 #include <algorithm>
+#include <future>
 #include <string>
 #include <unordered_map>
 
@@ -39,6 +40,10 @@ void Scene::load()
 		json11::Json cameraNode = scene["camera"];
 		initCamera(cameraNode);
 
+		// Materials refer to profiles by name, so they have to be known first
+		std::vector<json11::Json> profilesNode = scene["ss_profiles"].array_items();
+		loadSubsurfProfiles(profilesNode);
+
 		std::vector<json11::Json> jsonMeshes = scene["meshes"].array_items();
 		for (const auto& jsonMesh : jsonMeshes)
 		{
@@ -46,6 +51,8 @@ void Scene::load()
 			loadBinMesh(jsonMesh);
 		}
 
+		loadTextures();
+
 		std::vector<json11::Json> lightsNode = scene["lights"].array_items();
 		loadLights(lightsNode);
 
@@ -61,6 +68,23 @@ void Scene::load()
 	}
 }
 
+void Scene::loadTextures()
+{
+	// Decoding dominates loading and the files are independent, so each one gets its own thread
+	std::vector<std::future<void>> decoded;
+
+	for (auto& textureEntry : textureMap)
+	{
+		Texture* texture = textureEntry.second;
+		decoded.push_back(std::async(std::launch::async, [texture]() { texture->load(); }));
+	}
+
+	for (std::future<void>& texture : decoded)
+	{
+		texture.get();
+	}
+}
+
 void Scene::loadObjMesh(json11::Json jsonMesh)
 {
 	tinyobj::attrib_t attrib_;
@@ -186,6 +210,8 @@ void Scene::loadObjMesh(json11::Json jsonMesh)
 			elems.back()->indices.push_back(uniqueVertices[vertex]);
 		}
 
+		elems.back()->computeBounds();
+
 		i++;
 	}
 }
@@ -207,6 +233,7 @@ void Scene::loadBinMesh(json11::Json jsonMesh)
 
 	material->translucency = translucency;
 	material->subsurfWidth = ssWidth;
+	material->subsurfProfile = findSubsurfProfile(jsonMaterial["ss_profile"].string_value());
 	material->ks = ks;
 	material->ns = ns;
 
@@ -219,6 +246,8 @@ void Scene::loadBinMesh(json11::Json jsonMesh)
 	material->kdMap = textureMap[kdTxt];
 	material->normalMap = textureMap[normTxt];
 
+	// Indexes the descriptor sets, or the material array in bindless mode
+	material->id = materials.size();
 	materials.push_back(material);
 
 	std::string meshFilename = jsonMesh["filename"].string_value();
@@ -335,6 +364,7 @@ void Scene::loadBinMesh(json11::Json jsonMesh)
 	}
 
 	mesh->frame = Frame::orthonormalizeF(mesh->frame);
+	mesh->computeBounds();
 
 	elems.push_back(mesh);
 
@@ -418,6 +448,61 @@ void Scene::loadLights(std::vector<json11::Json> lightsNode)
 	}
 }
 
+void Scene::loadSubsurfProfiles(std::vector<json11::Json> profilesNode)
+{
+	subsurfProfiles.push_back(SubsurfProfile());
+	subsurfProfiles.back().name = "skin";
+
+	for (const json11::Json jsonProfile : profilesNode)
+	{
+		SubsurfProfile profile;
+		profile.name = jsonProfile["name"].string_value();
+
+		if (jsonProfile.has_member("strength"))
+		{
+			std::vector<json11::Json> jsonStrengthArray = jsonProfile["strength"].array_items();
+			profile.strength = {
+				jsonStrengthArray[0].number_value(),
+				jsonStrengthArray[1].number_value(),
+				jsonStrengthArray[2].number_value() };
+		}
+
+		if (jsonProfile.has_member("falloff"))
+		{
+			std::vector<json11::Json> jsonFalloffArray = jsonProfile["falloff"].array_items();
+			profile.falloff = {
+				jsonFalloffArray[0].number_value(),
+				jsonFalloffArray[1].number_value(),
+				jsonFalloffArray[2].number_value() };
+		}
+
+		// A profile named after an existing one replaces it, skin included
+		int index = findSubsurfProfile(profile.name);
+
+		if (index > 0 || profile.name == subsurfProfiles[0].name)
+		{
+			subsurfProfiles[index] = profile;
+		}
+		else
+		{
+			subsurfProfiles.push_back(profile);
+		}
+	}
+}
+
+int Scene::findSubsurfProfile(std::string name) const
+{
+	for (size_t i = 0; i < subsurfProfiles.size(); i++)
+	{
+		if (subsurfProfiles[i].name == name)
+		{
+			return i;
+		}
+	}
+
+	return 0;
+}
+
 void Scene::cleanup()
 {
 	std::vector<Mesh*>::iterator it3;
@@ -11,7 +11,6 @@
 
 #include "json11\json11.hpp"
 
-#define MAX_NUM_LIGHTS	4
 #define PATH_SEPARATOR	'/'
 #define SCENE_FILENAME	"scene.json"
 
@@ -31,6 +30,7 @@ public:
 	glm::vec3& getAmbient() { return ambient; }
 	Camera* getCamera() const { return camera; }
 	std::map<std::string, Texture*>& getTextureMap() { return textureMap; }
+	std::vector<SubsurfProfile>& getSubsurfProfiles() { return subsurfProfiles; }
 
 	void addTexture(std::string name, Texture* texture) { textureMap[name] = texture; }
 
@@ -41,6 +41,8 @@ private:
 	std::vector<Material*> materials;
 	std::map<std::string, Texture*> textureMap;
 	std::vector<Light*> lights;
+	// The first one is the default skin profile
+	std::vector<SubsurfProfile> subsurfProfiles;
 	glm::vec3 ambient;
 	Camera* camera;
 	
@@ -49,6 +51,9 @@ private:
 
 	void initCamera(json11::Json);
 	void loadLights(std::vector<json11::Json>);
+	void loadSubsurfProfiles(std::vector<json11::Json>);
+	int findSubsurfProfile(std::string name) const;
 	void loadObjMesh(json11::Json);
 	void loadBinMesh(json11::Json);
+	void loadTextures();
 };
\ No newline at end of file
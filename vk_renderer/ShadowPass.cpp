@@ -1,13 +1,42 @@
 #include "ShadowPass.h"
 
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
 #include "Camera.h"
 #include "VkPool.h"
 
 
-void ShadowPass::initAttachments()
+ShadowPass::ShadowPass(std::string vs, std::string gs) : Pass(vs, gs, "")
 {
-	commandBuffers.resize(lights.size());
+	std::vector<Light*>& sceneLights = VkEngine::getEngine().getScene()->getLights();
+	lights.assign(sceneLights.begin(), sceneLights.begin() + MIN(sceneLights.size(), (size_t) MAX_NUM_SHADOWED_LIGHTS));
+
+	// Tiles are carved out by halving, so the atlas side has to be a power of two
+	uint32_t requestedSize = VkEngine::getEngine().getConfig()->shadowAtlasSize;
+	atlas.size = 1;
+	while (atlas.size * 2 <= requestedSize)
+	{
+		atlas.size *= 2;
+	}
+
+	atlas.lightMatrices.resize(lights.size());
+	atlas.tileRects.resize(lights.size());
+	atlas.depthRanges.resize(lights.size());
+
+	// Set here rather than in initBufferData, which a swapchain recreation does not run again.
+	// Light orientation is anchored to the scene up vector rather than to the live camera
+	lightUp = VkEngine::getEngine().getScene()->getCamera()->up;
+
+	for (const auto& mesh : VkEngine::getEngine().getScene()->getMeshes())
+	{
+		cachedModelMatrices.push_back(mesh->getModelMatrix());
+	}
+}
 
+void ShadowPass::initAttachments()
+{
 	VkAttachmentDescription attachmentDesc = {};
 	attachmentDesc.samples = VK_SAMPLE_COUNT_1_BIT;
 	attachmentDesc.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
@@ -32,14 +61,14 @@ void ShadowPass::initAttachments()
 	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
 	dependencies[0].dstSubpass = 0;
 	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
 	dependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
 	dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 	dependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
 	dependencies[1].srcSubpass = 0;
 	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
 	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
 	dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 	dependencies[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
@@ -54,137 +83,159 @@ void ShadowPass::initAttachments()
 	renderPassInfo.dependencyCount = dependencies.size();
 	renderPassInfo.pDependencies = dependencies.data();
 
-	renderPass = VkEngine::getEngine().getPool()->createRenderPass(renderPassInfo);
-
-	for (size_t i = 0; i < lights.size(); i++)
-	{
-		VkCommandBufferAllocateInfo allocInfo = {};
-		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		allocInfo.commandPool = VkEngine::getEngine().getCommandPool();
-		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		allocInfo.commandBufferCount = 1;
+	clearRenderPass = VkEngine::getEngine().getPool()->createRenderPass(renderPassInfo);
 
-		VK_CHECK(vkAllocateCommandBuffers(VkEngine::getEngine().getDevice(), &allocInfo, &commandBuffers[i]));
+	// Same attachment, but the contents of clean tiles survive from the previous refresh
+	attachmentDesc.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	attachmentDesc.initialLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-		attachments[i] = VkEngine::getEngine().getPool()->createGBufferAttachment(GBufferAttachmentType::DEPTH);
+	loadRenderPass = VkEngine::getEngine().getPool()->createRenderPass(renderPassInfo);
 
-		VkExtent2D extent = VkEngine::getEngine().getSwapchainExtent();
+	atlas.attachment = VkEngine::getEngine().getPool()->createShadowAtlas(atlas.size);
+	atlas.compareSampler = VkEngine::getEngine().getPool()->createShadowSampler(true);
 
-		VkFramebufferCreateInfo framebufferCreateInfo = {};
-		framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		framebufferCreateInfo.pNext = NULL;
-		framebufferCreateInfo.renderPass = renderPass;
-		framebufferCreateInfo.pAttachments = &attachments[i].imageView;
-		framebufferCreateInfo.attachmentCount = 1;
-		framebufferCreateInfo.width = extent.width;
-		framebufferCreateInfo.height = extent.height;
-		framebufferCreateInfo.layers = 1;
+	VkFramebufferCreateInfo framebufferCreateInfo = {};
+	framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebufferCreateInfo.pNext = NULL;
+	framebufferCreateInfo.renderPass = clearRenderPass;
+	framebufferCreateInfo.pAttachments = &atlas.attachment.imageView;
+	framebufferCreateInfo.attachmentCount = 1;
+	framebufferCreateInfo.width = atlas.size;
+	framebufferCreateInfo.height = atlas.size;
+	framebufferCreateInfo.layers = 1;
 
-		framebuffers.push_back(VkEngine::getEngine().getPool()->createFramebuffer(framebufferCreateInfo));
-	}
+	framebuffer = VkEngine::getEngine().getPool()->createFramebuffer(framebufferCreateInfo);
 }
 
-void ShadowPass::initSemaphores()
+void ShadowPass::initCommandBuffers()
 {
-	for (size_t i = 0; i < lights.size() - 1; i++)
-	{
-		semaphores.push_back(VkEngine::getEngine().getPool()->createSemaphore());
-	}
+	// Recorded on demand by refresh(), once tiles and dirty lights are known
 }
 
-void ShadowPass::initCommandBuffers()
+void ShadowPass::recordCommandBuffer()
 {
-	static bool firstTime = true;
-	if (!firstTime)
+	if (commandBuffer != VK_NULL_HANDLE)
 	{
+		// The previous recording may still be in flight
+		vkQueueWaitIdle(VkEngine::getEngine().getGraphicsQueue());
 		vkFreeCommandBuffers(
 			VkEngine::getEngine().getDevice(),
 			VkEngine::getEngine().getCommandPool(),
-			lights.size(),
-			commandBuffers.data());
-	}
-	else
-	{
-		firstTime = false;
+			1,
+			&commandBuffer);
 	}
 
-	for (size_t i = 0; i < lights.size(); i++)
-	{
-		VkCommandBufferAllocateInfo allocInfo = {};
-		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		allocInfo.commandPool = VkEngine::getEngine().getCommandPool();
-		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		allocInfo.commandBufferCount = 1;
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = VkEngine::getEngine().getCommandPool();
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = 1;
 
-		VK_CHECK(vkAllocateCommandBuffers(VkEngine::getEngine().getDevice(), &allocInfo, &commandBuffers[i]));
+	VK_CHECK(vkAllocateCommandBuffers(VkEngine::getEngine().getDevice(), &allocInfo, &commandBuffer));
 
-		VkCommandBufferBeginInfo beginInfo = {};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-		beginInfo.pInheritanceInfo = nullptr;
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+	beginInfo.pInheritanceInfo = nullptr;
 
-		vkBeginCommandBuffer(commandBuffers[i], &beginInfo);
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
 
-		VkExtent2D extent = VkEngine::getEngine().getSwapchainExtent();
+	VkRect2D renderArea = {};
+	renderArea.extent = { atlas.size, atlas.size };
+	renderArea.offset = { 0, 0 };
 
-		VkRect2D renderArea = {};
-		renderArea.extent = extent;
-		renderArea.offset = { 0, 0 };
+	VkRenderPassBeginInfo renderPassInfo = {};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassInfo.renderPass = atlasValid ? loadRenderPass : clearRenderPass;
+	renderPassInfo.framebuffer = framebuffer;
+	renderPassInfo.renderArea = renderArea;
 
-		VkRenderPassBeginInfo renderPassInfo = {};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass = renderPass;
-		renderPassInfo.framebuffer = framebuffers[i];
-		renderPassInfo.renderArea = renderArea;
+	VkClearValue clearValue = {};
+	clearValue.depthStencil = DEPTH_STENCIL_CLEAR;
 
-		VkClearValue clearValue = {};
-		clearValue.depthStencil = DEPTH_STENCIL_CLEAR;
+	renderPassInfo.clearValueCount = 1;
+	renderPassInfo.pClearValues = &clearValue;
 
-		renderPassInfo.clearValueCount = 1;
-		renderPassInfo.pClearValues = &clearValue;
+	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-		vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	std::vector<VkViewport> viewports(lights.size());
+	std::vector<VkRect2D> scissors(lights.size());
+	std::vector<VkClearRect> clearRects;
 
-		VkViewport viewport = {};
-		viewport.width = (float) extent.width;
-		viewport.height = (float) extent.height;
-		viewport.minDepth = 0;
-		viewport.maxDepth = 1;
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		viewports[i].x = (float) tiles[i].x;
+		viewports[i].y = (float) tiles[i].y;
+		viewports[i].width = (float) tiles[i].size;
+		viewports[i].height = (float) tiles[i].size;
+		viewports[i].minDepth = 0;
+		viewports[i].maxDepth = 1;
 
-		vkCmdSetViewport(commandBuffers[i], 0, 1, &viewport);
-		vkCmdSetScissor(commandBuffers[i], 0, 1, &renderArea);
-		vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		scissors[i].offset = { (int32_t) tiles[i].x, (int32_t) tiles[i].y };
+		scissors[i].extent = { tiles[i].size, tiles[i].size };
 
-		for (const auto& mesh : VkEngine::getEngine().getScene()->getMeshes())
+		if (dirtyMask & (1 << i))
 		{
-			loadMeshUniforms(mesh);
-
-			VkBuffer vertexBuffers[] = { mesh->getVertexBuffer() };
-			VkDeviceSize offsets[] = { 0 };
-			vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuffers, offsets);
-			vkCmdBindIndexBuffer(commandBuffers[i], mesh->getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
-			vkCmdBindDescriptorSets(
-				commandBuffers[i],
-				VK_PIPELINE_BIND_POINT_GRAPHICS,
-				pipelineLayout,
-				0,
-				1,
-				&descriptorSets[i],
-				0,
-				nullptr);
-
-			vkCmdDrawIndexed(commandBuffers[i], mesh->indices.size(), 1, 0, 0, 0);
+			VkClearRect clearRect = {};
+			clearRect.rect = scissors[i];
+			clearRect.baseArrayLayer = 0;
+			clearRect.layerCount = 1;
+			clearRects.push_back(clearRect);
 		}
+	}
+
+	// A full refresh already cleared the whole atlas on load
+	if (atlasValid && !clearRects.empty())
+	{
+		VkClearAttachment clearAttachment = {};
+		clearAttachment.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		clearAttachment.clearValue = clearValue;
+
+		vkCmdClearAttachments(commandBuffer, 1, &clearAttachment, clearRects.size(), clearRects.data());
+	}
+
+	vkCmdSetViewport(commandBuffer, 0, viewports.size(), viewports.data());
+	vkCmdSetScissor(commandBuffer, 0, scissors.size(), scissors.data());
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	vkCmdBindDescriptorSets(
+		commandBuffer,
+		VK_PIPELINE_BIND_POINT_GRAPHICS,
+		pipelineLayout,
+		0,
+		1,
+		&descriptorSets[0],
+		0,
+		nullptr);
+
+	// Each mesh is drawn once, the geometry shader fans it out to the tiles of the dirty lights
+	// that can actually see it. Its transform and the mask of those lights are pushed before each draw.
+	for (const auto& mesh : VkEngine::getEngine().getScene()->getMeshes())
+	{
+		SPDrawPushConstants pushConstants = {};
+		pushConstants.lightMask = getLightMask(mesh);
+		if (pushConstants.lightMask == 0)
+			continue;
 
-		vkCmdEndRenderPass(commandBuffers[i]);
+		pushConstants.model = mesh->getModelMatrix();
 
-		VK_CHECK(vkEndCommandBuffer(commandBuffers[i]));
+		VkBuffer vertexBuffers[] = { mesh->getPositionBuffer() };
+		VkDeviceSize offsets[] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, mesh->getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT, 0,
+			sizeof(pushConstants), &pushConstants);
+		vkCmdDrawIndexed(commandBuffer, mesh->indices.size(), 1, 0, 0, 0);
 	}
+
+	vkCmdEndRenderPass(commandBuffer);
+
+	VK_CHECK(vkEndCommandBuffer(commandBuffer));
 }
 
 void ShadowPass::initDescriptorSets()
 {
-	descriptorSets.resize(lights.size());
+	descriptorSets.resize(1);
 
 	VkDescriptorSetAllocateInfo allocInfo = {};
 	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
@@ -192,69 +243,41 @@ void ShadowPass::initDescriptorSets()
 	allocInfo.descriptorSetCount = 1;
 	allocInfo.pSetLayouts = &descriptorSetLayout;
 
-	for (size_t i = 0; i < lights.size(); i++)
-	{
-		VK_CHECK(vkAllocateDescriptorSets(VkEngine::getEngine().getDevice(), &allocInfo, &descriptorSets[i]));
-
-		std::vector<VkWriteDescriptorSet> descriptorWrites;
-
-		VkDescriptorBufferInfo cameraBufferInfo = {};
-		cameraBufferInfo.buffer = cameraUniformBuffers[i];
-		cameraBufferInfo.offset = 0;
-		cameraBufferInfo.range = sizeof(CameraUniformBufferObject);
-
-		VkWriteDescriptorSet cameraDescriptorSet = {};
-		cameraDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		cameraDescriptorSet.dstSet = descriptorSets[i];
-		cameraDescriptorSet.dstBinding = 0;
-		cameraDescriptorSet.dstArrayElement = 0;
-		cameraDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		cameraDescriptorSet.descriptorCount = 1;
-		cameraDescriptorSet.pBufferInfo = &cameraBufferInfo;
-
-		descriptorWrites.push_back(cameraDescriptorSet);
-
-		VkDescriptorBufferInfo meshBufferInfo = {};
-		meshBufferInfo.buffer = meshUniformBuffer;
-		meshBufferInfo.offset = 0;
-		meshBufferInfo.range = sizeof(MeshUniformBufferObject);
-
-		VkWriteDescriptorSet meshDescriptorSet = {};
-		meshDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		meshDescriptorSet.dstSet = descriptorSets[i];
-		meshDescriptorSet.dstBinding = 1;
-		meshDescriptorSet.dstArrayElement = 0;
-		meshDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		meshDescriptorSet.descriptorCount = 1;
-		meshDescriptorSet.pBufferInfo = &meshBufferInfo;
-
-		descriptorWrites.push_back(meshDescriptorSet);
-		
-		vkUpdateDescriptorSets(VkEngine::getEngine().getDevice(), descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
-	}
+	VK_CHECK(vkAllocateDescriptorSets(VkEngine::getEngine().getDevice(), &allocInfo, &descriptorSets[0]));
+
+	std::vector<VkWriteDescriptorSet> descriptorWrites;
+
+	VkDescriptorBufferInfo lightsBufferInfo = {};
+	lightsBufferInfo.buffer = lightsUniformBuffer;
+	lightsBufferInfo.offset = 0;
+	lightsBufferInfo.range = sizeof(SPLightsUniformBufferObject);
+
+	VkWriteDescriptorSet lightsDescriptorSet = {};
+	lightsDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	lightsDescriptorSet.dstSet = descriptorSets[0];
+	lightsDescriptorSet.dstBinding = 0;
+	lightsDescriptorSet.dstArrayElement = 0;
+	lightsDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	lightsDescriptorSet.descriptorCount = 1;
+	lightsDescriptorSet.pBufferInfo = &lightsBufferInfo;
+
+	descriptorWrites.push_back(lightsDescriptorSet);
+
+	vkUpdateDescriptorSets(VkEngine::getEngine().getDevice(), descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
 }
 
 void ShadowPass::initDescriptorSetLayout()
 {
-	std::vector<VkDescriptorSetLayoutBinding> bindings(2);
-
-	VkDescriptorSetLayoutBinding cameraUBOLayoutBinding = {};
-	cameraUBOLayoutBinding.binding = 0;
-	cameraUBOLayoutBinding.descriptorCount = 1;
-	cameraUBOLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	cameraUBOLayoutBinding.pImmutableSamplers = nullptr;
-	cameraUBOLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	std::vector<VkDescriptorSetLayoutBinding> bindings(1);
 
-	bindings[0] = cameraUBOLayoutBinding;
+	VkDescriptorSetLayoutBinding lightsUBOLayoutBinding = {};
+	lightsUBOLayoutBinding.binding = 0;
+	lightsUBOLayoutBinding.descriptorCount = 1;
+	lightsUBOLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	lightsUBOLayoutBinding.pImmutableSamplers = nullptr;
+	lightsUBOLayoutBinding.stageFlags = VK_SHADER_STAGE_GEOMETRY_BIT;
 
-	VkDescriptorSetLayoutBinding meshUBOLayoutBinding = {};
-	meshUBOLayoutBinding.binding = 1;
-	meshUBOLayoutBinding.descriptorCount = 1;
-	meshUBOLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	meshUBOLayoutBinding.pImmutableSamplers = nullptr;
-	meshUBOLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-
-	bindings[1] = meshUBOLayoutBinding;
+	bindings[0] = lightsUBOLayoutBinding;
 
 	descriptorSetLayout = VkEngine::getEngine().getPool()->createDescriptorSetLayout(bindings);
 }
@@ -262,7 +285,6 @@ void ShadowPass::initDescriptorSetLayout()
 void ShadowPass::initGraphicsPipeline()
 {
 	std::vector<char> vs = readFile(vsPath);
-	std::vector<char> fs = readFile(fsPath);
 	std::vector<char> gs;
 
 	if (!gsPath.empty())
@@ -270,14 +292,25 @@ void ShadowPass::initGraphicsPipeline()
 		gs = readFile(gsPath);
 	}
 
+	// Depth-only: no fragment stage, positions read from the compact stream,
+	// one viewport per light so that the geometry shader can route triangles to its tile
+	PipelineOptions options;
+	options.positionOnly = true;
+	options.viewportCount = MAX(1u, (uint32_t) lights.size());
+	options.dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	options.pushConstants.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT;
+	options.pushConstants.offset = 0;
+	options.pushConstants.size = sizeof(SPDrawPushConstants);
+
 	PipelineData pipelineData = VkEngine::getEngine().getPool()->createPipeline(
-		renderPass,
+		clearRenderPass,
 		descriptorSetLayout,
-		VkEngine::getEngine().getSwapchainExtent(),
+		{ atlas.size, atlas.size },
 		vs,
-		fs,
+		std::vector<char>(),
 		gs,
-		0);
+		0,
+		options);
 
 	pipeline = pipelineData.pipeline;
 	pipelineLayout = pipelineData.pipelineLayout;
@@ -285,62 +318,280 @@ void ShadowPass::initGraphicsPipeline()
 
 void ShadowPass::initUniformBuffer()
 {
-	for (size_t i = 0; i < lights.size(); i++)
+	VkDeviceSize lightsBufferSize = sizeof(SPLightsUniformBufferObject);
+
+	std::vector<BufferData> lightsBufferDataVec = VkEngine::getEngine().getPool()->createUniformBuffer(lightsBufferSize, true);
+	lightsUniformStagingBuffer = lightsBufferDataVec[0].buffer;
+	lightsUniformStagingBufferMemory = lightsBufferDataVec[0].bufferMemory;
+	lightsUniformBuffer = lightsBufferDataVec[1].buffer;
+	lightsUniformBufferMemory = lightsBufferDataVec[1].bufferMemory;
+}
+
+void ShadowPass::initBufferData()
+{
+	refresh();
+}
+
+void ShadowPass::updateBufferData()
+{
+	refresh();
+}
+
+void ShadowPass::refresh()
+{
+	updateTiles();
+	updateLightMatrices();
+	updateMovedMeshes();
+
+	if (!atlasValid)
 	{
-		VkDeviceSize cameraBufferSize = sizeof(CameraUniformBufferObject);
+		dirtyMask = (1 << lights.size()) - 1;
+	}
 
-		std::vector<BufferData> cameraBufferDataVec = VkEngine::getEngine().getPool()->createUniformBuffer(cameraBufferSize, true);
-		cameraUniformStagingBuffers.push_back(cameraBufferDataVec[0].buffer);
-		cameraUniformStagingBufferMemoryList.push_back(cameraBufferDataVec[0].bufferMemory);
-		cameraUniformBuffers.push_back(cameraBufferDataVec[1].buffer);
-		cameraUniformBufferMemoryList.push_back(cameraBufferDataVec[1].bufferMemory);
+	// Dirty bits accumulate until the pass is actually submitted
+	if (dirtyMask != 0 && dirtyMask != recordedMask)
+	{
+		loadLightUniforms();
+		recordCommandBuffer();
+		recordedMask = dirtyMask;
 	}
+}
 
-	VkDeviceSize meshBufferSize = sizeof(MeshUniformBufferObject);
+float ShadowPass::computeImportance(const Light* light) const
+{
+	// Projected footprint of a light falls off with the squared distance from the viewer
+	Camera* camera = VkEngine::getEngine().getScene()->getCamera();
+	glm::vec3 toCamera = light->position - camera->frame.origin;
+	float luminance = glm::dot(light->intensity, glm::vec3(.2126f, .7152f, .0722f));
 
-	std::vector<BufferData> meshBufferDataVec = VkEngine::getEngine().getPool()->createUniformBuffer(meshBufferSize, true);
-	meshUniformStagingBuffer = meshBufferDataVec[0].buffer;
-	meshUniformStagingBufferMemory = meshBufferDataVec[0].bufferMemory;
-	meshUniformBuffer = meshBufferDataVec[1].buffer;
-	meshUniformBufferMemory = meshBufferDataVec[1].bufferMemory;
+	return luminance / MAX(glm::dot(toCamera, toCamera), CAMERA_NEAR * CAMERA_NEAR);
 }
 
-void ShadowPass::loadMeshUniforms(const Mesh* mesh)
+void ShadowPass::updateTiles()
 {
-	MeshUniformBufferObject ubo = {};
-	ubo.model = mesh->getModelMatrix();
+	size_t numLights = lights.size();
+	uint32_t maxTileSize = numLights > 1 ? atlas.size / 2 : atlas.size;
+	uint32_t minTileSize = MIN(SHADOW_MIN_TILE_SIZE, maxTileSize);
 
-	updateBuffer(
-		VkEngine::getEngine().getDevice(),
-		VkEngine::getEngine().getCommandPool(),
-		VkEngine::getEngine().getGraphicsQueue(),
-		&ubo,
-		sizeof(ubo),
-		meshUniformStagingBufferMemory,
-		meshUniformBuffer,
-		meshUniformStagingBuffer);
+	std::vector<float> importance(numLights);
+	float totalImportance = 0;
+
+	for (size_t i = 0; i < numLights; i++)
+	{
+		importance[i] = computeImportance(lights[i]);
+		totalImportance += importance[i];
+	}
+
+	// Sizes are quantized to powers of two: packing stays trivial and
+	// small shifts in importance keep lights on the tile they already have
+	std::vector<uint32_t> sizes(numLights);
+	for (size_t i = 0; i < numLights; i++)
+	{
+		float share = totalImportance > 0 ? importance[i] / totalImportance : 1.f / numLights;
+		float side = atlas.size * std::sqrt(share);
+
+		sizes[i] = maxTileSize;
+		while (sizes[i] > minTileSize && sizes[i] > side)
+		{
+			sizes[i] /= 2;
+		}
+	}
+
+	std::vector<size_t> order(numLights);
+	for (size_t i = 0; i < numLights; i++)
+	{
+		order[i] = i;
+	}
+
+	std::stable_sort(order.begin(), order.end(), [&sizes](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+
+	// Quadtree packing: take the smallest free block that fits and split it down to the requested size
+	std::vector<ShadowTile> freeTiles = { { 0, 0, atlas.size } };
+	std::vector<ShadowTile> newTiles(numLights);
+
+	for (size_t i : order)
+	{
+		int best = -1;
+		for (size_t f = 0; f < freeTiles.size(); f++)
+		{
+			if (freeTiles[f].size >= sizes[i] && (best < 0 || freeTiles[f].size < freeTiles[best].size))
+			{
+				best = f;
+			}
+		}
+
+		if (best < 0)
+		{
+			throw std::runtime_error("Shadow atlas is too small for the number of lights in the scene");
+		}
+
+		ShadowTile tile = freeTiles[best];
+		freeTiles.erase(freeTiles.begin() + best);
+
+		while (tile.size > sizes[i])
+		{
+			uint32_t half = tile.size / 2;
+			freeTiles.push_back({ tile.x + half, tile.y, half });
+			freeTiles.push_back({ tile.x, tile.y + half, half });
+			freeTiles.push_back({ tile.x + half, tile.y + half, half });
+			tile.size = half;
+		}
+
+		newTiles[i] = tile;
+	}
+
+	bool changed = tiles.size() != numLights;
+	for (size_t i = 0; i < numLights; i++)
+	{
+		if (tiles.size() != numLights || tiles[i] != newTiles[i])
+		{
+			dirtyMask |= 1 << i;
+			changed = true;
+		}
+
+		atlas.tileRects[i] = glm::vec4(newTiles[i].x, newTiles[i].y, newTiles[i].size, newTiles[i].size) / (float) atlas.size;
+	}
+
+	tiles = newTiles;
+
+	if (changed)
+	{
+		atlas.version++;
+	}
 }
 
-void ShadowPass::initBufferData()
+void ShadowPass::updateLightMatrices()
+{
+	std::vector<Mesh*>& meshes = VkEngine::getEngine().getScene()->getMeshes();
+	Camera* camera = VkEngine::getEngine().getScene()->getCamera();
+	glm::mat4 cameraViewProj = camera->getProjMatrix() * camera->getViewMatrix();
+
+	// Receivers are the meshes in view: only their shadows can end up on screen.
+	// The set changes rarely, so camera motion alone mostly leaves the fit, and the cache, untouched.
+	glm::vec3 receiversMin = glm::vec3(FLT_MAX);
+	glm::vec3 receiversMax = glm::vec3(-FLT_MAX);
+
+	for (const auto& mesh : meshes)
+	{
+		if (!isBoxInFrustum(cameraViewProj * mesh->getModelMatrix(), mesh->getBoundsMin(), mesh->getBoundsMax()))
+			continue;
+
+		glm::vec3 worldMin, worldMax;
+		mesh->getWorldBounds(worldMin, worldMax);
+		receiversMin = glm::min(receiversMin, worldMin);
+		receiversMax = glm::max(receiversMax, worldMax);
+	}
+
+	// Nothing in view, keep the previous fit
+	if (receiversMin.x > receiversMax.x)
+		return;
+
+	glm::vec3 center = (receiversMin + receiversMax) * .5f;
+	float radius = glm::length(receiversMax - receiversMin) * .5f;
+
+	bool changed = false;
+
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		glm::vec3 toCenter = center - lights[i]->position;
+		float dist = glm::length(toCenter);
+
+		// Cone around the receivers' bounding sphere, every caster that can shadow them lies inside it
+		float fovy = dist > radius ? 2.f * std::asin(radius / dist) : SHADOW_MAX_FOVY;
+		fovy = MIN(fovy, SHADOW_MAX_FOVY);
+
+		float zFar = dist + radius;
+		float zNear = MAX(dist - radius, SHADOW_MIN_NEAR);
+
+		glm::vec3 up = lightUp;
+		if (glm::length(glm::cross(toCenter, up)) < 1e-4f * dist)
+		{
+			up = glm::vec3(1, 0, 0);
+		}
+
+		glm::mat4 view = lights[i]->getViewMatrix(center, up);
+		glm::mat4 coneViewProj = lights[i]->getProjMatrix(fovy, SHADOW_MIN_NEAR, zFar) * view;
+
+		// Casters in front of the receivers pull the near plane towards the light
+		for (const auto& mesh : meshes)
+		{
+			if (!isBoxInFrustum(coneViewProj * mesh->getModelMatrix(), mesh->getBoundsMin(), mesh->getBoundsMax()))
+				continue;
+
+			glm::vec3 worldMin, worldMax;
+			mesh->getWorldBounds(worldMin, worldMax);
+
+			float casterDist = glm::dot((worldMin + worldMax) * .5f - lights[i]->position, toCenter / dist);
+			float casterRadius = glm::length(worldMax - worldMin) * .5f;
+			zNear = MIN(zNear, MAX(casterDist - casterRadius, SHADOW_MIN_NEAR));
+		}
+
+		glm::mat4 lightMatrix = lights[i]->getProjMatrix(fovy, zNear, zFar) * view;
+
+		if (lightMatrix != atlas.lightMatrices[i])
+		{
+			atlas.lightMatrices[i] = lightMatrix;
+			atlas.depthRanges[i] = glm::vec2(zNear, zFar);
+			dirtyMask |= 1 << i;
+			changed = true;
+		}
+	}
+
+	if (changed)
+	{
+		atlas.version++;
+	}
+}
+
+uint32_t ShadowPass::getLightMask(const Mesh* mesh) const
 {
+	uint32_t lightMask = 0;
+
 	for (size_t i = 0; i < lights.size(); i++)
 	{
-		loadLightUniforms(i);
+		if ((dirtyMask & (1 << i)) &&
+			isBoxInFrustum(atlas.lightMatrices[i] * mesh->getModelMatrix(), mesh->getBoundsMin(), mesh->getBoundsMax()))
+		{
+			lightMask |= 1 << i;
+		}
 	}
+
+	return lightMask;
 }
 
-void ShadowPass::updateBufferData()
+void ShadowPass::updateMovedMeshes()
 {
-	/* NOP */
+	std::vector<Mesh*>& meshes = VkEngine::getEngine().getScene()->getMeshes();
+
+	for (size_t m = 0; m < meshes.size(); m++)
+	{
+		glm::mat4 model = meshes[m]->getModelMatrix();
+		if (model == cachedModelMatrices[m])
+			continue;
+
+		// Both the area the mesh left and the one it entered have to be redrawn
+		for (size_t i = 0; i < lights.size(); i++)
+		{
+			if (isBoxInFrustum(atlas.lightMatrices[i] * cachedModelMatrices[m], meshes[m]->getBoundsMin(), meshes[m]->getBoundsMax()) ||
+				isBoxInFrustum(atlas.lightMatrices[i] * model, meshes[m]->getBoundsMin(), meshes[m]->getBoundsMax()))
+			{
+				dirtyMask |= 1 << i;
+			}
+		}
+
+		cachedModelMatrices[m] = model;
+	}
 }
 
-void ShadowPass::loadLightUniforms(size_t lightIndex)
+void ShadowPass::loadLightUniforms()
 {
-	Camera* camera = VkEngine::getEngine().getScene()->getCamera();
+	SPLightsUniformBufferObject ubo = {};
+	ubo.numLights = lights.size();
 
-	CameraUniformBufferObject ubo = {};
-	ubo.view = lights[lightIndex]->getViewMatrix(camera);
-	ubo.proj = camera->getProjMatrix();
+	for (size_t i = 0; i < lights.size(); i++)
+	{
+		ubo.viewProj[i] = atlas.lightMatrices[i];
+	}
 
 	updateBuffer(
 		VkEngine::getEngine().getDevice(),
@@ -348,7 +599,7 @@ void ShadowPass::loadLightUniforms(size_t lightIndex)
 		VkEngine::getEngine().getGraphicsQueue(),
 		&ubo,
 		sizeof(ubo),
-		cameraUniformStagingBufferMemoryList[lightIndex],
-		cameraUniformBuffers[lightIndex],
-		cameraUniformStagingBuffers[lightIndex]);
+		lightsUniformStagingBufferMemory,
+		lightsUniformBuffer,
+		lightsUniformStagingBuffer);
 }
\ No newline at end of file
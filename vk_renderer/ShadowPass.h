@@ -8,8 +8,48 @@
 #include "Scene.h"
 
 
-#define DEPTH_BIAS_CONSTANT	1.25f
-#define DEPTH_BIAS_SLOPE	1.75f
+#define DEPTH_BIAS_CONSTANT		1.25f
+#define DEPTH_BIAS_SLOPE		1.75f
+#define SHADOW_MIN_TILE_SIZE	256
+#define SHADOW_MIN_NEAR			.01f
+#define SHADOW_MAX_FOVY			2.5f
+// Only the first lights of the scene cast shadows, the rest are shaded unoccluded
+#define MAX_NUM_SHADOWED_LIGHTS	4
+
+
+struct ShadowTile {
+	uint32_t x;
+	uint32_t y;
+	uint32_t size;
+
+	bool operator==(const ShadowTile& other) const { return x == other.x && y == other.y && size == other.size; }
+	bool operator!=(const ShadowTile& other) const { return !(*this == other); }
+};
+
+struct ShadowAtlas {
+	// Its sampler reads raw depth, compareSampler does hardware PCF for visibility
+	GBufferAttachment attachment;
+	VkSampler compareSampler;
+	uint32_t size;
+	std::vector<glm::mat4> lightMatrices;
+	// xy: tile offset, zw: tile scale, both in normalized atlas coordinates
+	std::vector<glm::vec4> tileRects;
+	// x: near, y: far of each light's fitted projection
+	std::vector<glm::vec2> depthRanges;
+	// Bumped whenever matrices or tiles change, so that consumers know when to reload them
+	uint32_t version = 0;
+};
+
+struct SPLightsUniformBufferObject {
+	glm::mat4 viewProj[MAX_NUM_SHADOWED_LIGHTS];
+	int numLights;
+};
+
+// Pushed before each mesh is drawn, the vertex stage reads the transform and the geometry stage the mask
+struct SPDrawPushConstants {
+	glm::mat4 model;
+	uint32_t lightMask;
+};
 
 
 class ShadowPass : public Pass {
@@ -19,30 +59,34 @@ public:
 	virtual void initBufferData() override;
 	virtual void updateBufferData() override;
 
-	ShadowPass(std::string vs, std::string fs) : Pass(vs, fs) 
-	{ lights = VkEngine::getEngine().getScene()->getLights(); attachments.resize(lights.size()); }
+	ShadowPass(std::string vs, std::string gs);
 	~ShadowPass() { }
 
 	size_t getNumLights() const { return lights.size(); }
-	VkSemaphore getSemaphoreAt(size_t index) const { return semaphores[index]; }
-	VkCommandBuffer getCmdBufferAt(size_t index) const { return commandBuffers[index]; }
-	GBufferAttachment* getMaps() { return attachments.data(); }
+	VkCommandBuffer getCurrentCmdBuffer() const { return commandBuffer; }
+	ShadowAtlas* getAtlas() { return &atlas; }
+	bool hasPendingUpdate() const { return dirtyMask != 0; }
+	void onSubmitted() { dirtyMask = 0; recordedMask = 0; atlasValid = true; }
 
 private:
-	VkRenderPass renderPass;
-	std::vector<VkCommandBuffer> commandBuffers;
-	std::vector<VkFramebuffer> framebuffers;
-	std::vector<GBufferAttachment> attachments;
-	std::vector<VkSemaphore> semaphores;
-
-	std::vector<VkBuffer> cameraUniformStagingBuffers;
-	std::vector<VkDeviceMemory> cameraUniformStagingBufferMemoryList;
-	std::vector<VkBuffer> cameraUniformBuffers;
-	std::vector<VkDeviceMemory> cameraUniformBufferMemoryList;
-	VkBuffer meshUniformStagingBuffer;
-	VkDeviceMemory meshUniformStagingBufferMemory;
-	VkBuffer meshUniformBuffer;
-	VkDeviceMemory meshUniformBufferMemory;
+	// Full refresh: every tile is cleared and redrawn
+	VkRenderPass clearRenderPass;
+	// Partial refresh: clean tiles are kept from previous frames
+	VkRenderPass loadRenderPass;
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	VkFramebuffer framebuffer;
+	ShadowAtlas atlas;
+	std::vector<ShadowTile> tiles;
+	std::vector<glm::mat4> cachedModelMatrices;
+	glm::vec3 lightUp;
+	int dirtyMask = 0;
+	int recordedMask = 0;
+	bool atlasValid = false;
+
+	VkBuffer lightsUniformStagingBuffer;
+	VkDeviceMemory lightsUniformStagingBufferMemory;
+	VkBuffer lightsUniformBuffer;
+	VkDeviceMemory lightsUniformBufferMemory;
 
 	std::vector<Light*> lights;
 
@@ -51,9 +95,14 @@ private:
 	virtual void initDescriptorSets() override;
 	virtual void initDescriptorSetLayout() override;
 	virtual void initGraphicsPipeline() override;
-	virtual void initSemaphores() override;
 	virtual void initUniformBuffer() override;
 
-	void loadMeshUniforms(const Mesh* mesh);
-	void loadLightUniforms(size_t lightIndex);
+	void refresh();
+	void updateTiles();
+	void updateLightMatrices();
+	uint32_t getLightMask(const Mesh* mesh) const;
+	void updateMovedMeshes();
+	void recordCommandBuffer();
+	void loadLightUniforms();
+	float computeImportance(const Light* light) const;
 };
\ No newline at end of file
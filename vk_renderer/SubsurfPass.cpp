@@ -4,69 +4,75 @@
 #include "VkPool.h"
 
 
+// Compute-only: the blur writes straight into a storage image, no render pass or framebuffer
+void SubsurfPass::initLayouts()
+{
+	initAttachments();
+	initDescriptorSetLayout();
+}
+
+void SubsurfPass::initPipelines()
+{
+	initComputePipeline();
+}
+
+void SubsurfPass::initResources()
+{
+	initUniformBuffer();
+	initDescriptorSets();
+	initCommandBuffers();
+}
+
 void SubsurfPass::initAttachments()
 {
-	VkAttachmentDescription attachmentDesc = {};
-	attachmentDesc.samples = VK_SAMPLE_COUNT_1_BIT;
-	attachmentDesc.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	attachmentDesc.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-	attachmentDesc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	attachmentDesc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	attachmentDesc.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	attachmentDesc.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	attachmentDesc.format = VK_FORMAT_R8G8B8A8_UNORM;
-
-	VkAttachmentReference colorAttachmentRef = {};
-	colorAttachmentRef.attachment = 0;
-	colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-	VkSubpassDescription subPass = {};
-	subPass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subPass.colorAttachmentCount = 1;
-	subPass.pColorAttachments = &colorAttachmentRef;
-
-	VkSubpassDependency dependency = {};
-	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-	dependency.dstSubpass = 0;
-	dependency.srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-	dependency.srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-	VkRenderPassCreateInfo renderPassInfo = {};
-	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	renderPassInfo.attachmentCount = 1;
-	renderPassInfo.pAttachments = &attachmentDesc;
-	renderPassInfo.subpassCount = 1;
-	renderPassInfo.pSubpasses = &subPass;
-	renderPassInfo.dependencyCount = 1;
-	renderPassInfo.pDependencies = &dependency;
-
-	renderPass = VkEngine::getEngine().getPool()->createRenderPass(renderPassInfo);
+	attachment = VkEngine::getEngine().getPool()->createGBufferAttachment(GBufferAttachmentType::COLOR, true, true, downsample);
+}
 
-	VkCommandBufferAllocateInfo allocInfo = {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.commandPool = VkEngine::getEngine().getCommandPool();
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandBufferCount = 1;
+void SubsurfPass::initComputePipeline()
+{
+	std::string csPath = this->csPath;
+	VkDescriptorSetLayout descriptorSetLayout = this->descriptorSetLayout;
 
-	VK_CHECK(vkAllocateCommandBuffers(VkEngine::getEngine().getDevice(), &allocInfo, &commandBuffer));
+	pipelinePermutations = PipelinePermutations([csPath, descriptorSetLayout](const SpecializationConstants& constants)
+	{
+		return VkEngine::getEngine().getPool()->createComputePipeline(descriptorSetLayout, readFile(csPath), constants);
+	});
+
+	// Taps used, then the stride of the kernel table rows
+	PipelineData pipelineData = pipelinePermutations.get({ numSamples, SS_MAX_SAMPLES });
+
+	pipeline = pipelineData.pipeline;
+	pipelineLayout = pipelineData.pipelineLayout;
+}
+
+void SubsurfPass::setNumSamples(uint32_t numSamples)
+{
+	numSamples = clampNumSamples(numSamples);
+
+	if (numSamples == this->numSamples)
+		return;
+
+	// The previous recording may still be in flight, and reads the table about to be re-baked
+	vkQueueWaitIdle(VkEngine::getEngine().getGraphicsQueue());
+	vkFreeCommandBuffers(
+		VkEngine::getEngine().getDevice(),
+		VkEngine::getEngine().getCommandPool(),
+		1,
+		&commandBuffer);
 
-	attachment = VkEngine::getEngine().getPool()->createGBufferAttachment(GBufferAttachmentType::COLOR);
+	this->numSamples = numSamples;
 
-	VkExtent2D extent = VkEngine::getEngine().getSwapchainExtent();
+	if (ownsKernelTable())
+	{
+		bakeKernelTable();
+	}
 
-	VkFramebufferCreateInfo framebufferCreateInfo = {};
-	framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-	framebufferCreateInfo.pNext = NULL;
-	framebufferCreateInfo.renderPass = renderPass;
-	framebufferCreateInfo.pAttachments = &attachment.imageView;
-	framebufferCreateInfo.attachmentCount = 1;
-	framebufferCreateInfo.width = extent.width;
-	framebufferCreateInfo.height = extent.height;
-	framebufferCreateInfo.layers = 1;
+	PipelineData pipelineData = pipelinePermutations.get({ numSamples, SS_MAX_SAMPLES });
 
-	framebuffer = VkEngine::getEngine().getPool()->createFramebuffer(framebufferCreateInfo);
+	pipeline = pipelineData.pipeline;
+	pipelineLayout = pipelineData.pipelineLayout;
+
+	initCommandBuffers();
 }
 
 void SubsurfPass::initCommandBuffers()
@@ -84,34 +90,36 @@ void SubsurfPass::initCommandBuffers()
 	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
 	beginInfo.pInheritanceInfo = nullptr;
 
-	std::array<VkClearValue, 2> clearValues = {};
-	clearValues[0].color = TRANSPARENT_BLACK_CLEAR;
-	clearValues[1].depthStencil = DEPTH_STENCIL_CLEAR;
-
-	VkRenderPassBeginInfo renderPassInfo = {};
-	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	renderPassInfo.renderPass = renderPass;
-	renderPassInfo.renderArea.offset = { 0, 0 };
-	renderPassInfo.renderArea.extent = VkEngine::getEngine().getSwapchainExtent();
-	renderPassInfo.clearValueCount = clearValues.size();
-	renderPassInfo.pClearValues = clearValues.data();
-
-	std::vector<VkFramebuffer> framebuffers = VkEngine::getEngine().getSwapchainFramebuffers();
-
 	vkBeginCommandBuffer(commandBuffer, &beginInfo);
 
-	renderPassInfo.framebuffer = framebuffer;
-
-	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+	// Every texel gets overwritten, previous contents can be discarded
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = attachment.image;
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0,
+		0,
+		nullptr,
+		0,
+		nullptr,
+		1,
+		&barrier);
 
-	VkBuffer vertexBuffers[] = { quad->getVertexBuffer() };
-	VkDeviceSize offsets[] = { 0 };
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-	vkCmdBindIndexBuffer(commandBuffer, quad->getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
 	vkCmdBindDescriptorSets(
 		commandBuffer,
-		VK_PIPELINE_BIND_POINT_GRAPHICS,
+		VK_PIPELINE_BIND_POINT_COMPUTE,
 		pipelineLayout,
 		0,
 		1,
@@ -119,9 +127,27 @@ void SubsurfPass::initCommandBuffers()
 		0,
 		nullptr);
 
-	vkCmdDrawIndexed(commandBuffer, quad->indices.size(), 1, 0, 0, 1);
+	// Workgroups cover segments of rows (or columns) along the blur direction.
+	// The classification pass lists the ones with translucent pixels and writes the workgroup count
+	vkCmdDispatchIndirect(commandBuffer, tiles->sssWorkBuffers[blurDirection.x != 0 ? 0 : 1], 0);
 
-	vkCmdEndRenderPass(commandBuffer);
+	// Hand the result over to the next blur or to the merge pass
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	vkCmdPipelineBarrier(
+		commandBuffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		0,
+		0,
+		nullptr,
+		0,
+		nullptr,
+		1,
+		&barrier);
 
 	VK_CHECK(vkEndCommandBuffer(commandBuffer));
 }
@@ -159,7 +185,7 @@ void SubsurfPass::initDescriptorSets()
 	descriptorWrites.push_back(colorDescriptorSet);
 
 	VkDescriptorImageInfo depthImageInfo = {};
-	depthImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	depthImageInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
 	depthImageInfo.imageView = gBuffer->attachments[GBUFFER_DEPTH_ATTACH_ID].imageView;
 	depthImageInfo.sampler = gBuffer->attachments[GBUFFER_DEPTH_ATTACH_ID].imageSampler;
 
@@ -222,31 +248,105 @@ void SubsurfPass::initDescriptorSets()
 
 	descriptorWrites.push_back(instanceDescriptorSet);
 
-	vkUpdateDescriptorSets(VkEngine::getEngine().getDevice(), descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
-}
-
-void SubsurfPass::initGraphicsPipeline()
-{
-	std::vector<char> vs = readFile(vsPath);
-	std::vector<char> fs = readFile(fsPath);
-	std::vector<char> gs;
+	VkDescriptorImageInfo outputImageInfo = {};
+	outputImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+	outputImageInfo.imageView = attachment.imageView;
+	outputImageInfo.sampler = VK_NULL_HANDLE;
+
+	VkWriteDescriptorSet outputDescriptorSet = {};
+	outputDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	outputDescriptorSet.dstSet = descriptorSets[0];
+	outputDescriptorSet.dstBinding = bindingIndex++;
+	outputDescriptorSet.dstArrayElement = 0;
+	outputDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	outputDescriptorSet.descriptorCount = 1;
+	outputDescriptorSet.pImageInfo = &outputImageInfo;
+
+	descriptorWrites.push_back(outputDescriptorSet);
+
+	VkDescriptorImageInfo stencilImageInfo = {};
+	stencilImageInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	stencilImageInfo.imageView = gBuffer->attachments[GBUFFER_DEPTH_ATTACH_ID].stencilView;
+	stencilImageInfo.sampler = gBuffer->attachments[GBUFFER_DEPTH_ATTACH_ID].imageSampler;
+
+	VkWriteDescriptorSet stencilDescriptorSet = {};
+	stencilDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	stencilDescriptorSet.dstSet = descriptorSets[0];
+	stencilDescriptorSet.dstBinding = bindingIndex++;
+	stencilDescriptorSet.dstArrayElement = 0;
+	stencilDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	stencilDescriptorSet.descriptorCount = 1;
+	stencilDescriptorSet.pImageInfo = &stencilImageInfo;
+
+	descriptorWrites.push_back(stencilDescriptorSet);
+
+	VkDescriptorImageInfo unblurredImageInfo = {};
+	unblurredImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	unblurredImageInfo.imageView = unblurredAttachment->imageView;
+	unblurredImageInfo.sampler = unblurredAttachment->imageSampler;
+
+	VkWriteDescriptorSet unblurredDescriptorSet = {};
+	unblurredDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	unblurredDescriptorSet.dstSet = descriptorSets[0];
+	unblurredDescriptorSet.dstBinding = bindingIndex++;
+	unblurredDescriptorSet.dstArrayElement = 0;
+	unblurredDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	unblurredDescriptorSet.descriptorCount = 1;
+	unblurredDescriptorSet.pImageInfo = &unblurredImageInfo;
+
+	descriptorWrites.push_back(unblurredDescriptorSet);
+
+	VkDescriptorBufferInfo kernelsBufferInfo = {};
+	kernelsBufferInfo.buffer = kernelTable->buffer;
+	kernelsBufferInfo.offset = 0;
+	kernelsBufferInfo.range = kernelTable->bufferSize;
+
+	VkWriteDescriptorSet kernelsDescriptorSet = {};
+	kernelsDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	kernelsDescriptorSet.dstSet = descriptorSets[0];
+	kernelsDescriptorSet.dstBinding = bindingIndex++;
+	kernelsDescriptorSet.dstArrayElement = 0;
+	kernelsDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	kernelsDescriptorSet.descriptorCount = 1;
+	kernelsDescriptorSet.pBufferInfo = &kernelsBufferInfo;
+
+	descriptorWrites.push_back(kernelsDescriptorSet);
+
+	uint32_t workIndex = blurDirection.x != 0 ? 0 : 1;
+
+	VkDescriptorBufferInfo workBufferInfo = {};
+	workBufferInfo.buffer = tiles->sssWorkBuffers[workIndex];
+	workBufferInfo.offset = 0;
+	workBufferInfo.range = tiles->sssWorkBufferSizes[workIndex];
+
+	VkWriteDescriptorSet workDescriptorSet = {};
+	workDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	workDescriptorSet.dstSet = descriptorSets[0];
+	workDescriptorSet.dstBinding = bindingIndex++;
+	workDescriptorSet.dstArrayElement = 0;
+	workDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	workDescriptorSet.descriptorCount = 1;
+	workDescriptorSet.pBufferInfo = &workBufferInfo;
+
+	descriptorWrites.push_back(workDescriptorSet);
+
+	VkDescriptorImageInfo noiseImageInfo = {};
+	noiseImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	noiseImageInfo.imageView = noiseTexture->getImageView();
+	noiseImageInfo.sampler = noiseTexture->getSampler();
+
+	VkWriteDescriptorSet noiseDescriptorSet = {};
+	noiseDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	noiseDescriptorSet.dstSet = descriptorSets[0];
+	noiseDescriptorSet.dstBinding = bindingIndex++;
+	noiseDescriptorSet.dstArrayElement = 0;
+	noiseDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	noiseDescriptorSet.descriptorCount = 1;
+	noiseDescriptorSet.pImageInfo = &noiseImageInfo;
+
+	descriptorWrites.push_back(noiseDescriptorSet);
 
-	if (!gsPath.empty())
-	{
-		gs = readFile(gsPath);
-	}
-
-	PipelineData pipelineData = VkEngine::getEngine().getPool()->createPipeline(
-		renderPass,
-		descriptorSetLayout,
-		VkEngine::getEngine().getSwapchainExtent(),
-		vs,
-		fs,
-		gs,
-		1);
-
-	pipeline = pipelineData.pipeline;
-	pipelineLayout = pipelineData.pipelineLayout;
+	vkUpdateDescriptorSets(VkEngine::getEngine().getDevice(), descriptorWrites.size(), descriptorWrites.data(), 0, nullptr);
 }
 
 void SubsurfPass::initDescriptorSetLayout()
@@ -260,7 +360,7 @@ void SubsurfPass::initDescriptorSetLayout()
 	colorSamplerLayoutBinding.descriptorCount = 1;
 	colorSamplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	colorSamplerLayoutBinding.pImmutableSamplers = nullptr;
-	colorSamplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	colorSamplerLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
 	bindings.push_back(colorSamplerLayoutBinding);
 
@@ -269,7 +369,7 @@ void SubsurfPass::initDescriptorSetLayout()
 	depthSamplerLayoutBinding.descriptorCount = 1;
 	depthSamplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	depthSamplerLayoutBinding.pImmutableSamplers = nullptr;
-	depthSamplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	depthSamplerLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
 	bindings.push_back(depthSamplerLayoutBinding);
 
@@ -278,7 +378,7 @@ void SubsurfPass::initDescriptorSetLayout()
 	materialSamplerLayoutBinding.descriptorCount = 1;
 	materialSamplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	materialSamplerLayoutBinding.pImmutableSamplers = nullptr;
-	materialSamplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	materialSamplerLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
 	bindings.push_back(materialSamplerLayoutBinding);
 
@@ -287,7 +387,7 @@ void SubsurfPass::initDescriptorSetLayout()
 	cameraLayoutBinding.descriptorCount = 1;
 	cameraLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 	cameraLayoutBinding.pImmutableSamplers = nullptr;
-	cameraLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	cameraLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
 	bindings.push_back(cameraLayoutBinding);
 
@@ -296,10 +396,64 @@ void SubsurfPass::initDescriptorSetLayout()
 	instanceLayoutBinding.descriptorCount = 1;
 	instanceLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 	instanceLayoutBinding.pImmutableSamplers = nullptr;
-	instanceLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	instanceLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
 	bindings.push_back(instanceLayoutBinding);
 
+	VkDescriptorSetLayoutBinding outputLayoutBinding = {};
+	outputLayoutBinding.binding = bindingIndex++;
+	outputLayoutBinding.descriptorCount = 1;
+	outputLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	outputLayoutBinding.pImmutableSamplers = nullptr;
+	outputLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings.push_back(outputLayoutBinding);
+
+	VkDescriptorSetLayoutBinding stencilLayoutBinding = {};
+	stencilLayoutBinding.binding = bindingIndex++;
+	stencilLayoutBinding.descriptorCount = 1;
+	stencilLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	stencilLayoutBinding.pImmutableSamplers = nullptr;
+	stencilLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings.push_back(stencilLayoutBinding);
+
+	VkDescriptorSetLayoutBinding unblurredLayoutBinding = {};
+	unblurredLayoutBinding.binding = bindingIndex++;
+	unblurredLayoutBinding.descriptorCount = 1;
+	unblurredLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	unblurredLayoutBinding.pImmutableSamplers = nullptr;
+	unblurredLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings.push_back(unblurredLayoutBinding);
+
+	VkDescriptorSetLayoutBinding kernelsLayoutBinding = {};
+	kernelsLayoutBinding.binding = bindingIndex++;
+	kernelsLayoutBinding.descriptorCount = 1;
+	kernelsLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	kernelsLayoutBinding.pImmutableSamplers = nullptr;
+	kernelsLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings.push_back(kernelsLayoutBinding);
+
+	VkDescriptorSetLayoutBinding workLayoutBinding = {};
+	workLayoutBinding.binding = bindingIndex++;
+	workLayoutBinding.descriptorCount = 1;
+	workLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	workLayoutBinding.pImmutableSamplers = nullptr;
+	workLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings.push_back(workLayoutBinding);
+
+	VkDescriptorSetLayoutBinding noiseLayoutBinding = {};
+	noiseLayoutBinding.binding = bindingIndex++;
+	noiseLayoutBinding.descriptorCount = 1;
+	noiseLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	noiseLayoutBinding.pImmutableSamplers = nullptr;
+	noiseLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	bindings.push_back(noiseLayoutBinding);
+
 	descriptorSetLayout = VkEngine::getEngine().getPool()->createDescriptorSetLayout(bindings);
 }
 
@@ -320,13 +474,23 @@ void SubsurfPass::initUniformBuffer()
 	instanceUniformStagingBufferMemory = instanceBufferDataVec[0].bufferMemory;
 	instanceUniformBuffer = instanceBufferDataVec[1].buffer;
 	instanceUniformBufferMemory = instanceBufferDataVec[1].bufferMemory;
+
+	if (ownsKernelTable())
+	{
+		kernelTable->bufferSize = sizeof(kernelTable->kernels);
+
+		std::vector<BufferData> kernelsBufferDataVec = VkEngine::getEngine().getPool()->createStorageBuffer(kernelTable->bufferSize, true);
+		kernelTable->stagingBuffer = kernelsBufferDataVec[0].buffer;
+		kernelTable->stagingBufferMemory = kernelsBufferDataVec[0].bufferMemory;
+		kernelTable->buffer = kernelsBufferDataVec[1].buffer;
+		kernelTable->bufferMemory = kernelsBufferDataVec[1].bufferMemory;
+	}
 }
 
 void SubsurfPass::loadInstanceUniforms()
 {
 	SSSPInstanceUniformBufferObject ubo = {};
 	ubo.blurDirection = blurDirection;
-	for (size_t i = 0; i < SS_NUM_SAMPLES; i++) ubo.kernel[i] = kernel[i];
 
 	updateBuffer(
 		VkEngine::getEngine().getDevice(),
@@ -365,34 +529,142 @@ void SubsurfPass::loadCameraUniforms()
 		cameraUniformStagingBuffer);
 }
 
+void SubsurfPass::bakeProfile(uint32_t profileId)
+{
+	std::vector<SubsurfProfile>& profiles = VkEngine::getEngine().getScene()->getSubsurfProfiles();
+
+	if (!ownsKernelTable() || profileId >= profiles.size() || profileId >= SS_MAX_PROFILES)
+	{
+		return;
+	}
+
+	bakeKernelRow(profileId, profiles[profileId].strength, profiles[profileId].falloff);
+}
+
+void SubsurfPass::bakeKernelRow(uint32_t row, glm::vec3 strength, glm::vec3 falloff)
+{
+	const SSSKernel& kernel = getKernel(strength, falloff, numSamples);
+	std::copy(kernel.begin(), kernel.end(), kernelTable->kernels[row]);
+
+	updateBuffer(
+		VkEngine::getEngine().getDevice(),
+		VkEngine::getEngine().getCommandPool(),
+		VkEngine::getEngine().getGraphicsQueue(),
+		kernelTable->kernels[row],
+		sizeof(kernelTable->kernels[row]),
+		kernelTable->stagingBufferMemory,
+		kernelTable->buffer,
+		kernelTable->stagingBuffer,
+		row * sizeof(kernelTable->kernels[row]));
+}
+
+// With the debug HUD, strength and falloff sliders drive the default profile, which every material then uses
+void SubsurfPass::updateKernelOverrides()
+{
+	if (!ownsKernelTable() || !VkEngine::getEngine().isDebugHUDEnabled())
+	{
+		return;
+	}
+
+	glm::vec3 strength = VkEngine::getEngine().getSubsurfStrengthOverride();
+	glm::vec3 falloff = VkEngine::getEngine().getSubsurfFalloffOverride();
+
+	if (strength != bakedStrengthOverride || falloff != bakedFalloffOverride)
+	{
+		bakeKernelRow(0, strength, falloff);
+
+		bakedStrengthOverride = strength;
+		bakedFalloffOverride = falloff;
+	}
+}
+
 void SubsurfPass::initBufferData()
 {
 	loadInstanceUniforms();
+
+	if (ownsKernelTable())
+	{
+		if (VkEngine::getEngine().getScene()->getSubsurfProfiles().size() > SS_MAX_PROFILES)
+		{
+			std::cerr << "Only the first " << SS_MAX_PROFILES << " subsurface profiles are used." << std::endl;
+		}
+
+		bakeKernelTable();
+	}
+}
+
+void SubsurfPass::bakeKernelTable()
+{
+	std::vector<SubsurfProfile>& profiles = VkEngine::getEngine().getScene()->getSubsurfProfiles();
+
+	// Rows past the scene's profiles are never indexed, they just get the default kernel
+	for (size_t i = 0; i < SS_MAX_PROFILES; i++)
+	{
+		const SSSKernel& kernel = i < profiles.size() ? 
+			getKernel(profiles[i].strength, profiles[i].falloff, numSamples) : 
+			getKernel(profiles[0].strength, profiles[0].falloff, numSamples);
+		std::copy(kernel.begin(), kernel.end(), kernelTable->kernels[i]);
+	}
+
+	updateBuffer(
+		VkEngine::getEngine().getDevice(),
+		VkEngine::getEngine().getCommandPool(),
+		VkEngine::getEngine().getGraphicsQueue(),
+		kernelTable->kernels,
+		kernelTable->bufferSize,
+		kernelTable->stagingBufferMemory,
+		kernelTable->buffer,
+		kernelTable->stagingBuffer);
+
+	bakedStrengthOverride = profiles[0].strength;
+	bakedFalloffOverride = profiles[0].falloff;
 }
 
 void SubsurfPass::updateBufferData()
 {
 	loadCameraUniforms();
+	updateKernelOverrides();
+}
+
+const SSSKernel& SubsurfPass::getKernel(glm::vec3 strength, glm::vec3 falloff, uint32_t numSamples)
+{
+	static std::map<SSSKernelKey, SSSKernel> kernelCache;
+
+	SSSKernelKey key = { strength, falloff, numSamples };
+	std::map<SSSKernelKey, SSSKernel>::iterator it = kernelCache.find(key);
+
+	if (it == kernelCache.end())
+	{
+		if (kernelCache.size() >= SS_KERNEL_CACHE_SIZE)
+		{
+			kernelCache.clear();
+		}
+
+		it = kernelCache.insert(std::make_pair(key, SSSKernel())).first;
+		computeKernel(strength, falloff, numSamples, it->second.data());
+	}
+
+	return it->second;
 }
 
-void SubsurfPass::computeKernel(glm::vec3 strength, glm::vec3 falloff)
+void SubsurfPass::computeKernel(glm::vec3 strength, glm::vec3 falloff, uint32_t numSamples, glm::vec4* kernel)
 {
 	static const float range = 2;
 	static const float exponent = 2;
 
-	float step = 2 * range / (SS_NUM_SAMPLES - 1);
+	float step = 2 * range / (numSamples - 1);
 
-	for (int i = 0; i < SS_NUM_SAMPLES; i++)
+	for (uint32_t i = 0; i < numSamples; i++)
 	{
 		float o = -range + float(i) * step;
 		float sign = o < 0 ? -1.f : 1.f;
 		kernel[i].w = range * sign * abs(pow(o, exponent)) / pow(range, exponent);
 	}
 
-	for (int i = 0; i < SS_NUM_SAMPLES; i++)
+	for (uint32_t i = 0; i < numSamples; i++)
 	{
 		float w0 = i > 0 ? abs(kernel[i].w - kernel[i - 1].w) : 0;
-		float w1 = i < SS_NUM_SAMPLES - 1 ? abs(kernel[i].w - kernel[i + 1].w) : 0;
+		float w1 = i < numSamples - 1 ? abs(kernel[i].w - kernel[i + 1].w) : 0;
 		float area = (w0 + w1) / 2.f;
 		glm::vec3 t = area * profile(falloff, kernel[i].w);
 		kernel[i].x = t.x;
@@ -400,16 +672,16 @@ void SubsurfPass::computeKernel(glm::vec3 strength, glm::vec3 falloff)
 		kernel[i].z = t.z;
 	}
 
-	glm::vec4 t = kernel[SS_NUM_SAMPLES / 2];
-	for (int i = SS_NUM_SAMPLES / 2; i > 0; i--)
+	glm::vec4 t = kernel[numSamples / 2];
+	for (uint32_t i = numSamples / 2; i > 0; i--)
 		kernel[i] = kernel[i - 1];
 	kernel[0] = t;
 
 	glm::vec3 sum = glm::vec3(0);
-	for (int i = 0; i < SS_NUM_SAMPLES; i++)
+	for (uint32_t i = 0; i < numSamples; i++)
 		sum += glm::vec3(kernel[i].x, kernel[i].y, kernel[i].z);
 
-	for (int i = 0; i < SS_NUM_SAMPLES; i++)
+	for (uint32_t i = 0; i < numSamples; i++)
 	{
 		kernel[i].x /= sum.x;
 		kernel[i].y /= sum.y;
@@ -420,7 +692,7 @@ void SubsurfPass::computeKernel(glm::vec3 strength, glm::vec3 falloff)
 	kernel[0].y = (1.f - strength.y) + strength.y * kernel[0].y;
 	kernel[0].z = (1.f - strength.z) + strength.z * kernel[0].z;
 
-	for (int i = 1; i < SS_NUM_SAMPLES; i++)
+	for (uint32_t i = 1; i < numSamples; i++)
 	{
 		kernel[i].x *= strength.x;
 		kernel[i].y *= strength.y;
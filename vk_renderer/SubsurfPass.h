@@ -1,12 +1,28 @@
 #pragma once
 
+#include <array>
+#include <map>
+#include <tuple>
+
+#include "ClassifyPass.h"
 #include "Pass.h"
-#include "Quad.h"
 #include "Scene.h"
+#include "VkPool.h"
 
+// Default taps per blur direction, the blur is specialized with the count of the quality preset
 #define SS_NUM_SAMPLES	17
-#define SS_STRENGTH		{	.48f,	.41f,	.28f	}
-#define SS_FALLOFF		{	1.f,	.37f,	.3f		}
+// Stride of the kernel table rows, the most taps a preset can ask for
+#define SS_MAX_SAMPLES	25
+// Rows of the kernel table, profiles beyond it fall back to the default one
+#define SS_MAX_PROFILES	16
+// Kernels memoized before the cache is dropped, slider drags go through many values
+#define SS_KERNEL_CACHE_SIZE	64
+// One workgroup blurs a run of pixels along the blur direction, caching it in shared memory
+#define SS_TILE_SIZE	128
+// Extra pixels cached on each side of the run, taps reaching further read the textures instead
+#define SS_TILE_APRON	64
+// Downsampling factor of the reduced-resolution SSS mode
+#define SS_HALF_RES_FACTOR	2
 
 
 struct SSSPCameraUniformBufferObject {
@@ -14,43 +30,96 @@ struct SSSPCameraUniformBufferObject {
 };
 
 struct SSSPInstanceUniformBufferObject {
-	glm::vec4 kernel[SS_NUM_SAMPLES];
 	glm::vec2 blurDirection;
 };
 
+struct SSSKernelKey {
+	glm::vec3 strength;
+	glm::vec3 falloff;
+	uint32_t numSamples;
+
+	bool operator<(const SSSKernelKey& other) const
+	{
+		return std::tie(strength.x, strength.y, strength.z, falloff.x, falloff.y, falloff.z, numSamples) <
+			std::tie(other.strength.x, other.strength.y, other.strength.z, other.falloff.x, other.falloff.y, other.falloff.z, other.numSamples);
+	}
+};
+
+typedef std::array<glm::vec4, SS_MAX_SAMPLES> SSSKernel;
+
+// One kernel row per subsurface profile, shared by both blur directions. Only the first taps of each row are baked
+struct SSSKernelTable {
+	VkBuffer buffer;
+	VkDeviceMemory bufferMemory;
+	VkBuffer stagingBuffer;
+	VkDeviceMemory stagingBufferMemory;
+	VkDeviceSize bufferSize;
+	glm::vec4 kernels[SS_MAX_PROFILES][SS_MAX_SAMPLES];
+};
+
 
 class SubsurfPass : public Pass {
 public:
-	SubsurfPass(std::string vsPath, std::string fsPath, glm::vec2 blurDirection, GBuffer* gBuffer) :
-		vsPath(vsPath), fsPath(fsPath), gBuffer(gBuffer), blurDirection(blurDirection) 
-	{ quad = new Quad(); computeKernel(SS_STRENGTH, SS_FALLOFF); inColorAttachment = &gBuffer->attachments[GBUFFER_COLOR_ATTACH_ID]; }
-	SubsurfPass(std::string vsPath, std::string fsPath, glm::vec2 blurDirection, GBuffer* gBuffer, GBufferAttachment* inColorAttachment) :
-		vsPath(vsPath), fsPath(fsPath), gBuffer(gBuffer), blurDirection(blurDirection), inColorAttachment(inColorAttachment)
-	{ quad = new Quad(); computeKernel(SS_STRENGTH, SS_FALLOFF); }
-	~SubsurfPass() { delete quad; }
+	SubsurfPass(std::string csPath, glm::vec2 blurDirection, GBuffer* gBuffer, TileClassification* tiles, Texture* noiseTexture, 
+		uint32_t numSamples = SS_NUM_SAMPLES) :
+		csPath(csPath), gBuffer(gBuffer), tiles(tiles), noiseTexture(noiseTexture), blurDirection(blurDirection), 
+		numSamples(clampNumSamples(numSamples)) 
+	{ 
+		inColorAttachment = &gBuffer->attachments[GBUFFER_COLOR_ATTACH_ID]; 
+		unblurredAttachment = inColorAttachment; 
+		kernelTable = &ownKernelTable;
+	}
+	// The output is downsample times smaller than the swapchain on each axis, inColorAttachment can be either size.
+	// Without a sharedKernelTable the pass owns and bakes its own, otherwise the owner has to be initialized first.
+	// Only the segments listed by the tile classification for the blur direction are dispatched.
+	// The first layer of the shared blue noise jitters the kernel width per pixel.
+	// Passes sharing a kernel table must be given the same number of samples
+	SubsurfPass(std::string csPath, glm::vec2 blurDirection, GBuffer* gBuffer, TileClassification* tiles, Texture* noiseTexture,
+		GBufferAttachment* inColorAttachment, GBufferAttachment* unblurredAttachment = nullptr, uint32_t downsample = 1, 
+		SSSKernelTable* sharedKernelTable = nullptr, uint32_t numSamples = SS_NUM_SAMPLES) :
+		csPath(csPath), gBuffer(gBuffer), tiles(tiles), noiseTexture(noiseTexture), blurDirection(blurDirection), inColorAttachment(inColorAttachment),
+		unblurredAttachment(unblurredAttachment ? unblurredAttachment : inColorAttachment), downsample(downsample),
+		kernelTable(sharedKernelTable ? sharedKernelTable : &ownKernelTable), numSamples(clampNumSamples(numSamples)) { }
+	~SubsurfPass() { }
+
+	virtual void initLayouts() override;
+	virtual void initPipelines() override;
+	virtual void initResources() override;
+	virtual void initBufferData() override;
+	virtual void updateBufferData() override;
 
 	VkCommandBuffer getCurrentCmdBuffer() const { return commandBuffer; }
 	GBufferAttachment* getColorAttachment() { return &attachment; }
-
-	virtual void initBufferData() override;
-	virtual void updateBufferData() override;
+	SSSKernelTable* getKernelTable() { return kernelTable; }
+	// Re-bakes and uploads the kernel row of a single profile, the owner of the table has to do it
+	void bakeProfile(uint32_t profileId);
+	// Switches to the blur specialized with that many taps, the owner of the table re-bakes it
+	void setNumSamples(uint32_t numSamples);
 
 private:
-	std::string vsPath;
-	std::string fsPath;
+	std::string csPath;
 
-	VkRenderPass renderPass;
-	VkSemaphore mainPassSemaphore;
 	VkCommandBuffer commandBuffer;
-	VkFramebuffer framebuffer;
 
 	glm::vec2 blurDirection;
-	glm::vec4 kernel[SS_NUM_SAMPLES];
 
-	Quad* quad;
+	// Written as a storage image, sampled by whatever comes next.
+	// Only pixels tagged GBUFFER_STENCIL_SUBSURF_BIT are written, readers take the others from the unblurred input
 	GBufferAttachment attachment;
 	GBuffer* gBuffer;
+	TileClassification* tiles;
+	Texture* noiseTexture;
 	GBufferAttachment* inColorAttachment;
+	// Lighting output before any blur, source of the pixels outside the mask
+	GBufferAttachment* unblurredAttachment;
+	uint32_t downsample = 1;
+	SSSKernelTable ownKernelTable;
+	SSSKernelTable* kernelTable;
+	uint32_t numSamples;
+	PipelinePermutations pipelinePermutations;
+	// Debug HUD values the default profile was last baked with
+	glm::vec3 bakedStrengthOverride;
+	glm::vec3 bakedFalloffOverride;
 	SSSPCameraUniformBufferObject cameraUBO;
 	SSSPInstanceUniformBufferObject instanceUBO;
 	VkBuffer cameraUniformStagingBuffer;
@@ -66,10 +135,20 @@ private:
 	virtual void initCommandBuffers() override;
 	virtual void initDescriptorSets() override;
 	virtual void initDescriptorSetLayout() override;
-	virtual void initGraphicsPipeline() override;
+	virtual void initGraphicsPipeline() override { /*NOP*/ }
 	virtual void initUniformBuffer() override;
 
-	void computeKernel(glm::vec3 strength, glm::vec3 falloff);
+	void initComputePipeline();
+	bool ownsKernelTable() const { return kernelTable == &ownKernelTable; }
+
+	void bakeKernelTable();
+	void bakeKernelRow(uint32_t row, glm::vec3 strength, glm::vec3 falloff);
+	void updateKernelOverrides();
+
+	static const SSSKernel& getKernel(glm::vec3 strength, glm::vec3 falloff, uint32_t numSamples);
+	static void computeKernel(glm::vec3 strength, glm::vec3 falloff, uint32_t numSamples, glm::vec4* kernel);
+	// Odd, so that the center tap has as many on each side
+	static uint32_t clampNumSamples(uint32_t numSamples) { return glm::clamp(numSamples | 1u, 3u, uint32_t(SS_MAX_SAMPLES)); }
 	void loadCameraUniforms();
 	void loadInstanceUniforms();
 
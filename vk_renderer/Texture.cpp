@@ -16,8 +16,20 @@
 #include <stb\stb_image.h>
 
 
-void Texture::init()
+Texture::~Texture()
+{
+	// Pixels handed to the constructor belong to the caller
+	if (!path.empty())
+	{
+		stbi_image_free(pixels);
+	}
+}
+
+void Texture::load()
 {
+	if (pixels)
+		return;
+
 	int texChannels;
 	pixels = stbi_load(path.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
 
@@ -25,15 +37,17 @@ void Texture::init()
 	{
 		throw std::runtime_error("Failed to load texture image!");
 	}
+}
 
+void Texture::init()
+{
+	load();
 	initResources();
-
-	stbi_image_free(pixels);
 }
 
 void Texture::initResources()
 {
-	ImageData imageData = VkEngine::getEngine().getPool()->createTextureResources(pixels, texWidth, texHeight, highPrec);
+	ImageData imageData = VkEngine::getEngine().getPool()->createTextureResources(pixels, texWidth, texHeight, format);
 	image = imageData.image;
 	imageView = imageData.imageView;
 	imageMemory = imageData.imageMemory;
@@ -5,11 +5,13 @@
 
 struct Texture {
 public:
-	Texture(std::string path) : path(path) { }
-	Texture(void* pixels, unsigned int texWidth, unsigned int texHeight) : 
-		pixels(pixels), texWidth(texWidth), texHeight(texHeight) { highPrec = true; initResources(); }
-	~Texture() { }
+	Texture(std::string path) : path(path), pixels(nullptr) { }
+	Texture(void* pixels, unsigned int texWidth, unsigned int texHeight, VkFormat format = VK_FORMAT_R32G32B32A32_SFLOAT) : 
+		pixels(pixels), texWidth(texWidth), texHeight(texHeight), format(format) { initResources(); }
+	~Texture();
 	
+	// Decodes the file, on any thread. The pixels are kept, so that pool recreations only upload them again
+	void load();
 	void init();
 
 	std::string getName() const { return name; }
@@ -21,7 +23,7 @@ private:
 	std::string path;
 	void* pixels;
 	int texWidth, texHeight;
-	bool highPrec = false;
+	VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
 
 	VkImage image;
 	VkImageView imageView;
@@ -1,6 +1,10 @@
 #include "VkEngine.h"
 
+#include <algorithm>
 #include <chrono>
+#include <fstream>
+#include <future>
+#include <iomanip>
 #include <iostream>
 #include <set>
 
@@ -28,10 +32,22 @@ void VkEngine::init(int argc, char** argv)
 
 void VkEngine::run()
 {
-	loadScene();
-	initWindow();
-	initVulkan();
-	initImGui();
+	startupTime = std::chrono::steady_clock::now();
+
+	// Parsing the scene and decoding its textures needs neither the window nor the device
+	std::future<void> sceneLoaded = std::async(std::launch::async, [this]()
+	{
+		timeStartupStage("Scene", [this]() { loadScene(); });
+	});
+
+	timeStartupStage("Window", [this]() { initWindow(); });
+	timeStartupStage("Vulkan", [this]() { initVulkan(); });
+
+	// Passes upload the meshes and textures
+	sceneLoaded.get();
+
+	timeStartupStage("Passes", [this]() { initOffscreenRenderPasses(); });
+	timeStartupStage("HUD", [this]() { initImGui(); });
 	initCamera();
 	setupInputCallbacks();
 	mainLoop();
@@ -75,7 +91,7 @@ void VkEngine::initImGui()
 	init_data.gpu = physicalDevice;
 	init_data.device = device;
 	init_data.render_pass = renderPass;
-	init_data.pipeline_cache = VK_NULL_HANDLE;
+	init_data.pipeline_cache = VkEngine::getPool()->getPipelineCache();
 	init_data.descriptor_pool = descriptorPool;
 	init_data.check_vk_result = checkVkResult;
 	ImGui_ImplGlfwVulkan_Init(window, true, &init_data);
@@ -203,13 +219,60 @@ void VkEngine::initVulkan()
 	initDescriptorPool();
 	initSemaphores();
 	initFramebuffers();
-	initOffscreenRenderPasses();
+}
+
+void VkEngine::timeStartupStage(const std::string& name, std::function<void()> stage)
+{
+	if (startupReported)
+	{
+		stage();
+		return;
+	}
+
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	stage();
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+	std::lock_guard<std::mutex> lock(startupStagesMutex);
+	startupStages.push_back({
+		name,
+		std::chrono::duration<double, std::milli>(begin - startupTime).count(),
+		std::chrono::duration<double, std::milli>(end - startupTime).count()
+	});
+}
+
+void VkEngine::printStartupReport()
+{
+	double firstFrame = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupTime).count();
+
+	// Nested stages are recorded as they end, list them as they begin
+	std::sort(startupStages.begin(), startupStages.end(), [](const StartupStage& a, const StartupStage& b) { return a.begin < b.begin; });
+
+	std::cout << "Startup (ms, stages may overlap):" << std::endl;
+	std::cout << std::fixed << std::setprecision(1);
+
+	for (const StartupStage& stage : startupStages)
+	{
+		std::cout << "  " << std::left << std::setw(16) << stage.name << std::right
+			<< std::setw(9) << stage.begin << " - " << std::setw(9) << stage.end
+			<< " (" << stage.end - stage.begin << ")" << std::endl;
+	}
+
+	std::cout << "  First frame at " << firstFrame << std::endl;
+	std::cout << std::defaultfloat;
+
+	startupReported = true;
 }
 
 void VkEngine::mainLoop()
 {
 	initBufferData();
 
+	if (config->aoBenchmark)
+	{
+		runAOBenchmark();
+	}
+
 	while (!glfwWindowShouldClose(window))
 	{
 		glfwPollEvents();
@@ -283,6 +346,58 @@ void VkEngine::mainLoop()
 	ImGui_ImplGlfwVulkan_Shutdown();
 }
 
+void VkEngine::runAOBenchmark()
+{
+	Camera* camera = scene->getCamera();
+	Frame startFrame = camera->frame;
+	float startFocus = camera->focus;
+
+	std::ofstream outFile(AO_BENCHMARK_REPORT_PATH, std::ofstream::out | std::ofstream::trunc);
+
+	for (int i = 0; i < AO_NUM_ALGORITHMS && !glfwWindowShouldClose(window); i++)
+	{
+		gfxPipeline->setAOAlgorithm((AOAlgorithm) i);
+
+		// Same path for every algorithm
+		camera->frame = startFrame;
+		camera->focus = startFocus;
+
+		double totalTime = 0;
+
+		for (int frame = 0; frame < AO_BENCHMARK_WARMUP_FRAMES + AO_BENCHMARK_FRAMES && !glfwWindowShouldClose(window); frame++)
+		{
+			glfwPollEvents();
+
+#if SHOW_HUD
+			ImGui_ImplGlfwVulkan_NewFrame();
+#endif
+
+			if (frame >= AO_BENCHMARK_WARMUP_FRAMES)
+			{
+				camera->rotateAroundTarget(glm::vec2(2 * glm::pi<float>() / AO_BENCHMARK_FRAMES, 0));
+			}
+
+			updateBufferData();
+			draw();
+
+			// Waits for the frame, timestamps are read back right away
+			float aoTime = gfxPipeline->getAOTime();
+
+			if (frame >= AO_BENCHMARK_WARMUP_FRAMES)
+			{
+				totalTime += aoTime;
+			}
+		}
+
+		std::string result = std::string(AO_ALGORITHM_NAMES[i]) + " : " + std::to_string(totalTime / AO_BENCHMARK_FRAMES) + " ms";
+		std::cout << result << std::endl;
+		outFile << result << std::endl;
+	}
+
+	outFile.close();
+	glfwSetWindowShouldClose(window, GLFW_TRUE);
+}
+
 void VkEngine::drawDebugHUD()
 {
 	VK_CHECK(vkResetCommandPool(device, debugCmdPool, 0));
@@ -310,15 +425,30 @@ void VkEngine::drawDebugHUD()
 	else ImGui::Checkbox("Toggle", &sssEnabled);
 	ImGui::SliderFloat("Translucency", &translucencyOverride, .0f, .9f);
 	ImGui::SliderFloat("Kernel Width", &subsurfWidthOverride, 0, .05f);
-	// These attributes are static in the current implementation, no way to tweak them
-	// ImGui::SliderFloat3("Strength", (float*)&subsurfStrengthOverride, 0, 1);
-	// ImGui::SliderFloat3("Falloff", (float*) &subsurfFalloffOverride, 0, 1);
+	ImGui::SliderFloat3("Strength", (float*) &subsurfStrengthOverride, 0, 1);
+	ImGui::SliderFloat3("Falloff", (float*) &subsurfFalloffOverride, 0, 1);
 	ImGui::PopID();
 
 	ImGui::PushID("Ambient Occlusion");
 	ImGui::CollapsingHeader("Ambient Occlusion");
 	if (firstFrame) { ImGui::Checkbox("Toggle", &firstFrame); }
 	else ImGui::Checkbox("Toggle", &ssaoEnabled);
+	int aoAlgorithm = config->aoAlgorithm;
+	if (ImGui::Combo("Algorithm", &aoAlgorithm, AO_ALGORITHM_NAMES, AO_NUM_ALGORITHMS))
+	{
+		config->aoAlgorithm = (AOAlgorithm) aoAlgorithm;
+		gfxPipeline->setAOAlgorithm(config->aoAlgorithm);
+	}
+	ImGui::PopID();
+
+	ImGui::PushID("Quality");
+	ImGui::CollapsingHeader("Quality");
+	int quality = config->quality;
+	if (ImGui::Combo("Preset", &quality, QUALITY_PRESET_NAMES, NUM_QUALITY_PRESETS))
+	{
+		config->quality = (QualityPreset) quality;
+		gfxPipeline->setQuality(config->quality);
+	}
 	ImGui::PopID();
 
 	ImGui::PushID("Stats");
@@ -534,6 +664,10 @@ void VkEngine::draw()
 		recreateSwapchain();
 	}
 
+	if (!startupReported)
+	{
+		printStartupReport();
+	}
 }
 
 void VkEngine::initSemaphores()
@@ -556,6 +690,8 @@ void VkEngine::recreateSwapchain()
 	initSemaphores();
 	initFramebuffers();
 	initOffscreenRenderPasses();
+	// The passes are new, so whatever they only upload once has to be uploaded again
+	initBufferData();
 }
 
 void VkEngine::initBufferData()
@@ -582,6 +718,9 @@ void VkEngine::initOffscreenRenderPasses()
 
 void VkEngine::cleanup()
 {
+	// Only once at shutdown, the pool is also deleted whenever the swapchain is recreated
+	pool->printObjectCacheStats();
+
 	delete pool;
 	delete gfxPipeline;
 	delete config;
@@ -1,6 +1,10 @@
 #pragma once
 
 #include <array>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <string>
 #include <vector>
 
 #include "VkUtils.h"
@@ -21,6 +25,10 @@
 #define DEFAULT_SUBSURF_WIDTH	.012f
 #define HUD_FONT_SCALE 1.1f
 #define HUD_AREA_SCALE .18f
+// Each AO algorithm first renders the starting view a few frames, then one full orbit around the target
+#define AO_BENCHMARK_WARMUP_FRAMES	60
+#define AO_BENCHMARK_FRAMES			600
+#define AO_BENCHMARK_REPORT_PATH	"ao_benchmark.txt"
 
 #ifdef NDEBUG
 #define SHOW_HUD 0
@@ -46,6 +54,9 @@ public:
 	void run();
 
 	bool isDebugHUDEnabled() { return SHOW_HUD; }
+	// Runs a stage of startup and records its span for the report printed after the first frame.
+	// Stages may run concurrently; once the report is out, they just run
+	void timeStartupStage(const std::string& name, std::function<void()> stage);
 
 	VkInstance getInstance() { return instance; }
 	VkDevice getDevice() { return device; }
@@ -121,6 +132,17 @@ private:
 
 	Scene* scene;
 
+	struct StartupStage {
+		std::string name;
+		double begin;
+		double end;
+	};
+
+	std::chrono::steady_clock::time_point startupTime;
+	std::vector<StartupStage> startupStages;
+	std::mutex startupStagesMutex;
+	bool startupReported = false;
+
 	void initWindow();
 	void initVulkan();
 	void initImGui();
@@ -137,6 +159,7 @@ private:
 	void initOffscreenRenderPasses();
 
 	void draw();
+	void runAOBenchmark();
 	void recreateSwapchain();
 	void initBufferData();
 	void updateBufferData();
@@ -148,6 +171,8 @@ private:
 
 	static void onWindowResized(GLFWwindow* window, int width, int height);
 
+	void printStartupReport();
+
 	void endDebugFrame();
 	void drawDebugHUD();
 
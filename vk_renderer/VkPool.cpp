@@ -1,12 +1,69 @@
 #include "VkPool.h"
 
 #include <array>
+#include <cstdio>
+#include <cstring>
 
 #include "VkUtils.h"
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+// Contents of a create info, appended field by field: whole structs can carry padding and pointers,
+// neither of which says anything about the object described. Chained pNext structures are not keyed
+class ObjectKey {
+public:
+	template<typename T>
+	ObjectKey& operator<<(const T& value)
+	{
+		bytes.append(reinterpret_cast<const char*>(&value), sizeof(T));
+
+		return *this;
+	}
+
+	// Only for arrays of structs without padding or pointers, preceded by their count
+	template<typename T>
+	ObjectKey& append(const T* values, uint32_t count)
+	{
+		*this << count;
+
+		if (values != nullptr)
+		{
+			bytes.append(reinterpret_cast<const char*>(values), sizeof(T) * count);
+		}
+
+		return *this;
+	}
+
+	const std::string& str() const { return bytes; }
+
+private:
+	std::string bytes;
+};
+
+template<typename T>
+static bool findCachedObject(ObjectCache<T>& cache, const std::string& key, T& object)
+{
+	typename std::unordered_map<std::string, T>::const_iterator it = cache.objects.find(key);
+
+	if (it == cache.objects.end())
+	{
+		cache.misses++;
+
+		return false;
+	}
+
+	cache.hits++;
+	object = it->second;
+
+	return true;
+}
 
 VkSemaphore VkPool::createSemaphore()
 {
@@ -31,6 +88,19 @@ VkFence VkPool::createFence()
 	return fences.back();
 }
 
+VkQueryPool VkPool::createQueryPool(VkQueryType type, uint32_t queryCount)
+{
+	VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+	queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolCreateInfo.queryType = type;
+	queryPoolCreateInfo.queryCount = queryCount;
+
+	queryPools.push_back(VK_NULL_HANDLE);
+	VK_CHECK(vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr, &queryPools.back()));
+
+	return queryPools.back();
+}
+
 VkDescriptorPool VkPool::createDescriptorPool(
 	uint32_t bufferDescriptorCount, 
 	uint32_t imageSamplerDescriptorCount,
@@ -38,11 +108,15 @@ VkDescriptorPool VkPool::createDescriptorPool(
 {
 	descriptorPools.push_back(VK_NULL_HANDLE);
 
-	std::array<VkDescriptorPoolSize, 2> poolSizes = {};
+	std::array<VkDescriptorPoolSize, 4> poolSizes = {};
 	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 	poolSizes[0].descriptorCount = bufferDescriptorCount;
 	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	poolSizes[1].descriptorCount = imageSamplerDescriptorCount;
+	poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[2].descriptorCount = POOL_STORAGE_BUFFER_SIZE;
+	poolSizes[3].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	poolSizes[3].descriptorCount = POOL_STORAGE_IMAGE_SIZE;
 
 	VkDescriptorPoolCreateInfo poolInfo = {};
 	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -55,6 +129,33 @@ VkDescriptorPool VkPool::createDescriptorPool(
 	return descriptorPools.back();
 }
 
+VkDescriptorPool VkPool::createBindlessDescriptorPool(
+	uint32_t bufferDescriptorCount,
+	uint32_t storageBufferDescriptorCount,
+	uint32_t textureDescriptorCount)
+{
+	descriptorPools.push_back(VK_NULL_HANDLE);
+
+	std::array<VkDescriptorPoolSize, 3> poolSizes = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	poolSizes[0].descriptorCount = bufferDescriptorCount;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[1].descriptorCount = storageBufferDescriptorCount;
+	poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	poolSizes[2].descriptorCount = textureDescriptorCount;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+	poolInfo.poolSizeCount = poolSizes.size();
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = 1;
+
+	VK_CHECK(vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPools.back()));
+
+	return descriptorPools.back();
+}
+
 std::vector<BufferData> VkPool::createUniformBuffer(VkDeviceSize bufferSize, bool createStaging)
 {
 	std::vector<BufferData> bufferDataVec;
@@ -95,10 +196,63 @@ std::vector<BufferData> VkPool::createUniformBuffer(VkDeviceSize bufferSize, boo
 	return bufferDataVec;
 }
 
+std::vector<BufferData> VkPool::createStorageBuffer(VkDeviceSize bufferSize, bool createStaging, bool indirect)
+{
+	std::vector<BufferData> bufferDataVec;
+
+	if (createStaging)
+	{
+		buffers.push_back(VK_NULL_HANDLE);
+		deviceMemoryList.push_back(VK_NULL_HANDLE);
+
+		createBuffer(
+			physicalDevice,
+			device,
+			bufferSize,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			buffers.back(),
+			deviceMemoryList.back());
+
+		bufferDataVec.push_back({ buffers.back(), deviceMemoryList.back() });
+	}
+
+	// Written either by a staging copy or by a compute pass, never mapped
+	buffers.push_back(VK_NULL_HANDLE);
+	deviceMemoryList.push_back(VK_NULL_HANDLE);
+
+	VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+	// Compute passes may also source their dispatch arguments from it
+	if (indirect)
+		usage |= VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+
+	createBuffer(
+		physicalDevice,
+		device,
+		bufferSize,
+		usage,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		buffers.back(),
+		deviceMemoryList.back());
+
+	bufferDataVec.push_back({ buffers.back(), deviceMemoryList.back() });
+
+	return bufferDataVec;
+}
+
 BufferData VkPool::createVertexBuffer(std::vector<Vertex> vertices)
 {
-	VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
+	return createVertexBuffer(vertices.data(), sizeof(vertices[0]) * vertices.size());
+}
+
+BufferData VkPool::createVertexBuffer(std::vector<glm::vec3> positions)
+{
+	return createVertexBuffer(positions.data(), sizeof(positions[0]) * positions.size());
+}
 
+BufferData VkPool::createVertexBuffer(const void* vertexData, VkDeviceSize bufferSize)
+{
 	vertexBuffers.push_back(VK_NULL_HANDLE);
 	vertexDeviceMemoryList.push_back(VK_NULL_HANDLE);
 
@@ -116,7 +270,7 @@ BufferData VkPool::createVertexBuffer(std::vector<Vertex> vertices)
 
 	void* data;
 	VK_CHECK(vkMapMemory(device, stagingVertexMemory, 0, bufferSize, 0, &data));
-	memcpy(data, vertices.data(), (size_t) bufferSize);
+	memcpy(data, vertexData, (size_t) bufferSize);
 	vkUnmapMemory(VkEngine::getEngine().getDevice(), stagingVertexMemory);
 
 	createBuffer(
@@ -206,7 +360,6 @@ ImageData VkPool::createDepthResources()
 	depthImages.push_back(VK_NULL_HANDLE);
 	depthImageViews.push_back(VK_NULL_HANDLE);
 	depthImageMemoryList.push_back(VK_NULL_HANDLE);
-	depthSamplers.push_back(VK_NULL_HANDLE);
 
 	createImage(
 		physicalDevice,
@@ -253,13 +406,13 @@ ImageData VkPool::createDepthResources()
 	samplerInfo.minLod = 0.f;
 	samplerInfo.maxLod = 0.f;
 
-	VK_CHECK(vkCreateSampler(device, &samplerInfo, nullptr, &depthSamplers.back()));
+	VkSampler sampler = getSampler(samplerInfo);
 
 	ImageData depthData = {
 		depthImages.back(),
 		depthImageViews.back(),
 		depthImageMemoryList.back(),
-		depthSamplers.back()
+		sampler
 	};
 
 	return depthData;
@@ -280,6 +433,29 @@ VkCommandPool VkPool::createCommandPool()
 	return commandPools.back();
 }
 
+// The map entries have to outlive the returned info
+static VkSpecializationInfo getSpecializationInfo(
+	const SpecializationConstants& constants, 
+	std::vector<VkSpecializationMapEntry>& mapEntries)
+{
+	mapEntries.resize(constants.size());
+
+	for (uint32_t i = 0; i < constants.size(); i++)
+	{
+		mapEntries[i].constantID = i;
+		mapEntries[i].offset = i * sizeof(uint32_t);
+		mapEntries[i].size = sizeof(uint32_t);
+	}
+
+	VkSpecializationInfo specializationInfo = {};
+	specializationInfo.mapEntryCount = mapEntries.size();
+	specializationInfo.pMapEntries = mapEntries.data();
+	specializationInfo.dataSize = constants.size() * sizeof(uint32_t);
+	specializationInfo.pData = constants.data();
+
+	return specializationInfo;
+}
+
 PipelineData VkPool::createPipeline(
 	VkRenderPass renderPass,
 	VkDescriptorSetLayout descriptorSetLayout, 
@@ -287,62 +463,63 @@ PipelineData VkPool::createPipeline(
 	std::vector<char> vs, 
 	std::vector<char> fs, 
 	std::vector<char> gs,
-	uint16_t numColorAttachments)
+	uint16_t numColorAttachments,
+	PipelineOptions options)
 {
-	pipelines.push_back(VK_NULL_HANDLE);
-	pipelineLayouts.push_back(VK_NULL_HANDLE);
-	
-	shaderModules.push_back(VK_NULL_HANDLE);
-	shaderModules.push_back(VK_NULL_HANDLE);
-
-	size_t vsIndex = shaderModules.size() - 2;
-	size_t fsIndex = shaderModules.size() - 1;
-
-	createShaderModule(VkEngine::getEngine().getDevice(), vs, shaderModules[vsIndex]);
-	createShaderModule(VkEngine::getEngine().getDevice(), fs, shaderModules[fsIndex]);
+	VkShaderModule vsModule = getShaderModule(vs);
 
 	VkPipelineShaderStageCreateInfo vsStageInfo = {};
 	vsStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	vsStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vsStageInfo.module = shaderModules[vsIndex];
+	vsStageInfo.module = vsModule;
 	vsStageInfo.pName = SHADER_MAIN;
 
-	VkPipelineShaderStageCreateInfo fsStageInfo = {};
-	fsStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fsStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	fsStageInfo.module = shaderModules[fsIndex];
-	fsStageInfo.pName = SHADER_MAIN;
-
-	std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
+	std::vector<VkPipelineShaderStageCreateInfo> shaderStages = { vsStageInfo };
 
 	if (!gs.empty())
 	{
-		shaderModules.push_back(VK_NULL_HANDLE);
-
-		createShaderModule(device, gs, shaderModules.back());
-
 		VkPipelineShaderStageCreateInfo gsStageInfo = {};
 		gsStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		gsStageInfo.stage = VK_SHADER_STAGE_GEOMETRY_BIT;
-		gsStageInfo.module = shaderModules.back();
+		gsStageInfo.module = getShaderModule(gs);
 		gsStageInfo.pName = SHADER_MAIN;
 
-		shaderStages = { vsStageInfo, gsStageInfo, fsStageInfo };
+		shaderStages.push_back(gsStageInfo);
 	}
-	else
+
+	// Depth-only pipelines can omit the fragment stage altogether
+	if (!fs.empty())
 	{
-		shaderStages = { vsStageInfo, fsStageInfo };
+		VkPipelineShaderStageCreateInfo fsStageInfo = {};
+		fsStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		fsStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		fsStageInfo.module = getShaderModule(fs);
+		fsStageInfo.pName = SHADER_MAIN;
+
+		shaderStages.push_back(fsStageInfo);
 	}
 
 	auto bindingDescription = Vertex::getBindingDescription();
 	auto attributeDescriptions = Vertex::getAttributeDescriptions();
+	auto positionBindingDescription = Vertex::getPositionBindingDescription();
+	auto positionAttributeDescriptions = Vertex::getPositionAttributeDescriptions();
 
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
 	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 	vertexInputInfo.vertexBindingDescriptionCount = 1;
-	vertexInputInfo.vertexAttributeDescriptionCount = attributeDescriptions.size();
-	vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+	if (options.positionOnly)
+	{
+		vertexInputInfo.vertexAttributeDescriptionCount = positionAttributeDescriptions.size();
+		vertexInputInfo.pVertexBindingDescriptions = &positionBindingDescription;
+		vertexInputInfo.pVertexAttributeDescriptions = positionAttributeDescriptions.data();
+	}
+	else
+	{
+		vertexInputInfo.vertexAttributeDescriptionCount = attributeDescriptions.size();
+		vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+	}
 
 	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
 	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -361,12 +538,15 @@ PipelineData VkPool::createPipeline(
 	scissor.offset = { 0, 0 };
 	scissor.extent = extent;
 
+	std::vector<VkViewport> viewports(options.viewportCount, viewport);
+	std::vector<VkRect2D> scissors(options.viewportCount, scissor);
+
 	VkPipelineViewportStateCreateInfo viewportState = {};
 	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportState.viewportCount = 1;
-	viewportState.pViewports = &viewport;
-	viewportState.scissorCount = 1;
-	viewportState.pScissors = &scissor;
+	viewportState.viewportCount = viewports.size();
+	viewportState.pViewports = viewports.data();
+	viewportState.scissorCount = scissors.size();
+	viewportState.pScissors = scissors.data();
 
 	VkPipelineRasterizationStateCreateInfo rasterizer = {};
 	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
@@ -392,21 +572,33 @@ PipelineData VkPool::createPipeline(
 
 	VkPipelineDepthStencilStateCreateInfo depthStencil = {};
 	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-	depthStencil.depthTestEnable = VK_TRUE;
-	depthStencil.depthWriteEnable = VK_TRUE;
-	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+	depthStencil.depthTestEnable = options.depthTest ? VK_TRUE : VK_FALSE;
+	depthStencil.depthWriteEnable = options.depthWrite ? VK_TRUE : VK_FALSE;
+	depthStencil.depthCompareOp = options.depthCompareOp;
 	depthStencil.depthBoundsTestEnable = VK_FALSE;
 	depthStencil.minDepthBounds = 0.f;
 	depthStencil.maxDepthBounds = 1.f;
-	depthStencil.stencilTestEnable = VK_FALSE;
-	depthStencil.front = {};
-	depthStencil.back = {};
+	depthStencil.stencilTestEnable = options.stencilTest ? VK_TRUE : VK_FALSE;
+	depthStencil.front = options.stencil;
+	depthStencil.back = options.stencil;
 
 	std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments(numColorAttachments);
 	for (VkPipelineColorBlendAttachmentState& colorBlendAttachment : colorBlendAttachments)
 	{
 		colorBlendAttachment.colorWriteMask = 0xf;
 		colorBlendAttachment.blendEnable = VK_FALSE;
+
+		// Color accumulates on top of what is already there, alpha is left untouched
+		if (options.additiveBlend)
+		{
+			colorBlendAttachment.blendEnable = VK_TRUE;
+			colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+			colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+			colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+			colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+			colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+			colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+		}
 	}
 
 	VkPipelineColorBlendStateCreateInfo colorBlending = {};
@@ -414,28 +606,13 @@ PipelineData VkPool::createPipeline(
 	colorBlending.attachmentCount = colorBlendAttachments.size();
 	colorBlending.pAttachments = colorBlendAttachments.data();
 
-	std::vector<VkDynamicState> dynamicStates = {
-		VK_DYNAMIC_STATE_VIEWPORT,
-		VK_DYNAMIC_STATE_LINE_WIDTH
-	};
-
-	// if (numColorAttachments == 0)
-	// {
-	// 	dynamicStates.push_back(VK_DYNAMIC_STATE_DEPTH_BIAS);
-	// }
-
+	// Passes that render into sub-rectangles (e.g. shadow atlas tiles, light volumes) set them per command buffer
 	VkPipelineDynamicStateCreateInfo dynamicState = {};
-	dynamicState.dynamicStateCount = dynamicStates.size();
-	dynamicState.pDynamicStates = dynamicStates.data();
-
-	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
-	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = 1;
-	pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-	pipelineLayoutInfo.pushConstantRangeCount = 0;
-	pipelineLayoutInfo.pPushConstantRanges = 0;
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = options.dynamicStates.size();
+	dynamicState.pDynamicStates = options.dynamicStates.data();
 
-	VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayouts.back()));
+	VkPipelineLayout pipelineLayout = getPipelineLayout(descriptorSetLayout, options.pushConstants);
 
 	VkGraphicsPipelineCreateInfo pipelineInfo = {};
 	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -448,45 +625,158 @@ PipelineData VkPool::createPipeline(
 	pipelineInfo.pMultisampleState = &multisampling;
 	pipelineInfo.pDepthStencilState = nullptr;
 	pipelineInfo.pColorBlendState = &colorBlending;
-	pipelineInfo.pDynamicState = nullptr;
-	pipelineInfo.layout = pipelineLayouts.back();
+	pipelineInfo.pDynamicState = options.dynamicStates.empty() ? nullptr : &dynamicState;
+	pipelineInfo.layout = pipelineLayout;
 	pipelineInfo.renderPass = renderPass;
 	pipelineInfo.subpass = 0;
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 	pipelineInfo.basePipelineIndex = -1;
 	pipelineInfo.pDepthStencilState = &depthStencil;
 
-	VK_CHECK(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipelines.back()));
+	// The cache is internally synchronized, only the list needs the lock
+	VkPipeline pipeline;
+	VK_CHECK(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline));
+
+	{
+		std::lock_guard<std::mutex> lock(objectMutex);
+		pipelines.push_back(pipeline);
+	}
+
+	PipelineData pipelineData = {
+		pipeline,
+		pipelineLayout
+	};
+
+	return pipelineData;
+}
+
+PipelineData VkPool::createComputePipeline(
+	VkDescriptorSetLayout descriptorSetLayout, 
+	std::vector<char> cs, 
+	const SpecializationConstants& specializationConstants)
+{
+	std::vector<VkSpecializationMapEntry> specializationMapEntries;
+	VkSpecializationInfo specializationInfo = getSpecializationInfo(specializationConstants, specializationMapEntries);
+
+	VkPipelineShaderStageCreateInfo csStageInfo = {};
+	csStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	csStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	csStageInfo.module = getShaderModule(cs);
+	csStageInfo.pName = SHADER_MAIN;
+	csStageInfo.pSpecializationInfo = specializationConstants.empty() ? nullptr : &specializationInfo;
+
+	VkPipelineLayout pipelineLayout = getPipelineLayout(descriptorSetLayout, {});
+
+	VkComputePipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage = csStageInfo;
+	pipelineInfo.layout = pipelineLayout;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineInfo.basePipelineIndex = -1;
+
+	VkPipeline pipeline;
+	VK_CHECK(vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline));
+
+	{
+		std::lock_guard<std::mutex> lock(objectMutex);
+		pipelines.push_back(pipeline);
+	}
 
 	PipelineData pipelineData = {
-		pipelines.back(),
-		pipelineLayouts.back()
+		pipeline,
+		pipelineLayout
 	};
 
 	return pipelineData;
 }
 
-VkDescriptorSetLayout VkPool::createDescriptorSetLayout(std::vector<VkDescriptorSetLayoutBinding>& bindings)
+VkDescriptorSetLayout VkPool::createDescriptorSetLayout(
+	std::vector<VkDescriptorSetLayoutBinding>& bindings,
+	const std::vector<VkDescriptorBindingFlagsEXT>& bindingFlags)
 {
-	descriptorSetLayouts.push_back(VK_NULL_HANDLE);
+	ObjectKey key;
+	key.append(bindingFlags.data(), uint32_t(bindingFlags.size()));
+	key << uint32_t(bindings.size());
 
-	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
-	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	layoutInfo.bindingCount = bindings.size();
-	layoutInfo.pBindings = bindings.data();
+	for (const VkDescriptorSetLayoutBinding& binding : bindings)
+	{
+		key << binding.binding
+			<< binding.descriptorType
+			<< binding.descriptorCount
+			<< binding.stageFlags;
+		key.append(binding.pImmutableSamplers, binding.pImmutableSamplers != nullptr ? binding.descriptorCount : 0);
+	}
+
+	VkDescriptorSetLayout descriptorSetLayout;
+
+	std::lock_guard<std::mutex> lock(objectMutex);
 
-	VK_CHECK(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayouts.back()));
+	if (!findCachedObject(descriptorSetLayoutCache, key.str(), descriptorSetLayout))
+	{
+		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = bindings.size();
+		layoutInfo.pBindings = bindings.data();
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+		bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+		bindingFlagsInfo.bindingCount = bindingFlags.size();
+		bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+		if (!bindingFlags.empty())
+		{
+			layoutInfo.pNext = &bindingFlagsInfo;
+
+			for (VkDescriptorBindingFlagsEXT flags : bindingFlags)
+			{
+				if (flags & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT)
+				{
+					layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+				}
+			}
+		}
+
+		VK_CHECK(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout));
+
+		descriptorSetLayoutCache.objects[key.str()] = descriptorSetLayout;
+	}
 
-	return descriptorSetLayouts.back();
+	return descriptorSetLayout;
 }
 
 VkRenderPass VkPool::createRenderPass(VkRenderPassCreateInfo createInfo)
 {
-	renderPasses.push_back(VK_NULL_HANDLE);
+	ObjectKey key;
+	key << createInfo.flags;
+	key.append(createInfo.pAttachments, createInfo.attachmentCount);
+	key << createInfo.subpassCount;
 
-	VK_CHECK(vkCreateRenderPass(device, &createInfo, nullptr, &renderPasses.back()));
+	for (uint32_t i = 0; i < createInfo.subpassCount; i++)
+	{
+		const VkSubpassDescription& subpass = createInfo.pSubpasses[i];
+
+		key << subpass.flags << subpass.pipelineBindPoint;
+		key.append(subpass.pInputAttachments, subpass.inputAttachmentCount);
+		key.append(subpass.pColorAttachments, subpass.colorAttachmentCount);
+		key.append(subpass.pResolveAttachments, subpass.pResolveAttachments != nullptr ? subpass.colorAttachmentCount : 0);
+		key.append(subpass.pDepthStencilAttachment, subpass.pDepthStencilAttachment != nullptr ? 1 : 0);
+		key.append(subpass.pPreserveAttachments, subpass.preserveAttachmentCount);
+	}
+
+	key.append(createInfo.pDependencies, createInfo.dependencyCount);
 
-	return renderPasses.back();
+	VkRenderPass renderPass;
+
+	std::lock_guard<std::mutex> lock(objectMutex);
+
+	if (!findCachedObject(renderPassCache, key.str(), renderPass))
+	{
+		VK_CHECK(vkCreateRenderPass(device, &createInfo, nullptr, &renderPass));
+
+		renderPassCache.objects[key.str()] = renderPass;
+	}
+
+	return renderPass;
 }
 
 VkFramebuffer VkPool::createFramebuffer(VkFramebufferCreateInfo createInfo)
@@ -512,20 +802,16 @@ VkImageView VkPool::createSwapchainImageView(VkImage swapchainImage)
 	return swapchainImageViews.back();
 }
 
-ImageData VkPool::createTextureResources(void* pixels, unsigned int texWidth, unsigned int texHeight, bool highPrec)
+ImageData VkPool::createTextureResources(void* pixels, unsigned int texWidth, unsigned int texHeight, VkFormat format)
 {
 	textureImages.push_back(VK_NULL_HANDLE);
 	textureImageViews.push_back(VK_NULL_HANDLE);
 	textureImageMemoryList.push_back(VK_NULL_HANDLE);
-	textureSamplers.push_back(VK_NULL_HANDLE);
-	
+
 	VkImage stagingTextureImage;
 	VkDeviceMemory stagingTextureImageMemory;
 
-	size_t vecSize = highPrec ? 16 : 4;
-	VkFormat format = highPrec ? VK_FORMAT_R32G32B32A32_SFLOAT : VK_FORMAT_R8G8B8A8_UNORM;
-
-	VkDeviceSize imageSize = texWidth * texHeight * vecSize;
+	size_t rowSize = texWidth * getTexelSize(format);
 	
 	createImage(
 		VkEngine::getEngine().getPhysicalDevice(),
@@ -539,9 +825,23 @@ ImageData VkPool::createTextureResources(void* pixels, unsigned int texWidth, un
 		stagingTextureImage,
 		stagingTextureImageMemory);
 
+	// Rows of a linear image can be padded, narrow textures most of all
+	VkImageSubresource subresource = {};
+	subresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	subresource.mipLevel = 0;
+	subresource.arrayLayer = 0;
+
+	VkSubresourceLayout stagingLayout;
+	vkGetImageSubresourceLayout(VkEngine::getEngine().getDevice(), stagingTextureImage, &subresource, &stagingLayout);
+
 	void* data;
-	VK_CHECK(vkMapMemory(VkEngine::getEngine().getDevice(), stagingTextureImageMemory, 0, imageSize, 0, &data));
-	memcpy(data, pixels, (size_t) imageSize);
+	VK_CHECK(vkMapMemory(VkEngine::getEngine().getDevice(), stagingTextureImageMemory, 0, VK_WHOLE_SIZE, 0, &data));
+	
+	for (unsigned int row = 0; row < texHeight; row++)
+	{
+		memcpy((char*)data + stagingLayout.offset + row * stagingLayout.rowPitch, (char*)pixels + row * rowSize, rowSize);
+	}
+
 	vkUnmapMemory(VkEngine::getEngine().getDevice(), stagingTextureImageMemory);
 
 	createImage(
@@ -614,7 +914,7 @@ ImageData VkPool::createTextureResources(void* pixels, unsigned int texWidth, un
 	samplerInfo.minLod = 0.f;
 	samplerInfo.maxLod = 0.f;
 
-	VK_CHECK(vkCreateSampler(device, &samplerInfo, nullptr, &textureSamplers.back()));
+	VkSampler sampler = getSampler(samplerInfo);
 
 	vkDestroyImage(VkEngine::getEngine().getDevice(), stagingTextureImage, nullptr);
 	vkFreeMemory(VkEngine::getEngine().getDevice(), stagingTextureImageMemory, nullptr);
@@ -623,13 +923,13 @@ ImageData VkPool::createTextureResources(void* pixels, unsigned int texWidth, un
 		textureImages.back(),
 		textureImageViews.back(),
 		textureImageMemoryList.back(),
-		textureSamplers.back()
+		sampler
 	};
 
 	return imageData;
 }
 
-GBufferAttachment VkPool::createGBufferAttachment(GBufferAttachmentType type, bool toBeSampled)
+GBufferAttachment VkPool::createGBufferAttachment(GBufferAttachmentType type, bool toBeSampled, bool storage, uint32_t downsample)
 {
 	VkFormat format;
 	VkImageUsageFlagBits imageFlags;
@@ -638,12 +938,12 @@ GBufferAttachment VkPool::createGBufferAttachment(GBufferAttachmentType type, bo
 	offscreenImages.push_back(VK_NULL_HANDLE);
 	offscreenImageViews.push_back(VK_NULL_HANDLE);
 	offscreenImageMemoryList.push_back(VK_NULL_HANDLE);
-	offscreenImageSamplers.push_back(VK_NULL_HANDLE);
 
 	switch (type)
 	{
 	case DEPTH:
-		format = findDepthFormat(physicalDevice);
+		// Stencil marks covered pixels for the passes that only shade geometry
+		format = findDepthStencilFormat(physicalDevice);
 		imageFlags = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
 		imageViewFlags = VK_IMAGE_ASPECT_DEPTH_BIT;
 		break;
@@ -665,12 +965,14 @@ GBufferAttachment VkPool::createGBufferAttachment(GBufferAttachmentType type, bo
 	}
 
 	if (toBeSampled) imageFlags = (VkImageUsageFlagBits) (imageFlags | VK_IMAGE_USAGE_SAMPLED_BIT);
+	if (storage) imageFlags = (VkImageUsageFlagBits) (imageFlags | VK_IMAGE_USAGE_STORAGE_BIT);
 
+	// Reduced-resolution attachments round up, so that every full-resolution pixel has a texel
 	createImage(
 		physicalDevice,
 		device,
-		swapchainExtent.width,
-		swapchainExtent.height,
+		(swapchainExtent.width + downsample - 1) / downsample,
+		(swapchainExtent.height + downsample - 1) / downsample,
 		format,
 		VK_IMAGE_TILING_OPTIMAL,
 		imageFlags,
@@ -686,7 +988,9 @@ GBufferAttachment VkPool::createGBufferAttachment(GBufferAttachmentType type, bo
 			VkEngine::getEngine().getGraphicsQueue(),
 			offscreenImages.back(),
 			VK_IMAGE_LAYOUT_UNDEFINED, 
-			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+			1,
+			format);
 	}
 
 	createImageView(
@@ -696,6 +1000,36 @@ GBufferAttachment VkPool::createGBufferAttachment(GBufferAttachmentType type, bo
 		imageViewFlags,
 		offscreenImageViews.back());
 
+	VkImageView imageView = offscreenImageViews.back();
+	VkImageView depthStencilView = VK_NULL_HANDLE;
+	VkImageView stencilView = VK_NULL_HANDLE;
+
+	// Samplers can only read one aspect, framebuffers need both
+	if (type == GBufferAttachmentType::DEPTH && hasStencilComponent(format))
+	{
+		offscreenImageViews.push_back(VK_NULL_HANDLE);
+
+		createImageView(
+			device,
+			offscreenImages.back(),
+			format,
+			VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT,
+			offscreenImageViews.back());
+
+		depthStencilView = offscreenImageViews.back();
+
+		offscreenImageViews.push_back(VK_NULL_HANDLE);
+
+		createImageView(
+			device,
+			offscreenImages.back(),
+			format,
+			VK_IMAGE_ASPECT_STENCIL_BIT,
+			offscreenImageViews.back());
+
+		stencilView = offscreenImageViews.back();
+	}
+
 	VkSamplerCreateInfo samplerInfo = {};
 	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
 	samplerInfo.magFilter = VK_FILTER_LINEAR;
@@ -714,19 +1048,260 @@ GBufferAttachment VkPool::createGBufferAttachment(GBufferAttachmentType type, bo
 	samplerInfo.minLod = 0.f;
 	samplerInfo.maxLod = 0.f;
 
-	VK_CHECK(vkCreateSampler(device, &samplerInfo, nullptr, &offscreenImageSamplers.back()));
+	VkSampler sampler = getSampler(samplerInfo);
 
 	GBufferAttachment attachment = {
 		type,
 		offscreenImages.back(),
+		imageView,
+		offscreenImageMemoryList.back(),
+		sampler,
+		depthStencilView,
+		stencilView
+	};
+
+	return attachment;
+}
+
+GBufferAttachment VkPool::createShadowAtlas(uint32_t size)
+{
+	VkFormat format = findDepthFormat(physicalDevice);
+
+	offscreenImages.push_back(VK_NULL_HANDLE);
+	offscreenImageViews.push_back(VK_NULL_HANDLE);
+	offscreenImageMemoryList.push_back(VK_NULL_HANDLE);
+
+	createImage(
+		physicalDevice,
+		device,
+		size,
+		size,
+		format,
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		offscreenImages.back(),
+		offscreenImageMemoryList.back());
+
+	transitionImageLayout(
+		VkEngine::getEngine().getDevice(),
+		VkEngine::getEngine().getCommandPool(),
+		VkEngine::getEngine().getGraphicsQueue(),
+		offscreenImages.back(),
+		VK_IMAGE_LAYOUT_UNDEFINED,
+		VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+
+	createImageView(
+		device,
+		offscreenImages.back(),
+		format,
+		VK_IMAGE_ASPECT_DEPTH_BIT,
+		offscreenImageViews.back());
+
+	// Raw depth reads (transmittance thickness) go through a nearest-filter sampler
+	VkSampler sampler = createShadowSampler(false);
+
+	GBufferAttachment attachment = {
+		DEPTH,
+		offscreenImages.back(),
 		offscreenImageViews.back(),
 		offscreenImageMemoryList.back(),
-		offscreenImageSamplers.back()
+		sampler
 	};
 
 	return attachment;
 }
 
+DepthPyramid VkPool::createDepthPyramid(uint32_t numLevels, uint32_t downsample)
+{
+	VkFormat format = VK_FORMAT_R32_SFLOAT;
+
+	offscreenImages.push_back(VK_NULL_HANDLE);
+	offscreenImageViews.push_back(VK_NULL_HANDLE);
+	offscreenImageMemoryList.push_back(VK_NULL_HANDLE);
+
+	createImage(
+		physicalDevice,
+		device,
+		(swapchainExtent.width + downsample - 1) / downsample,
+		(swapchainExtent.height + downsample - 1) / downsample,
+		format,
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		offscreenImages.back(),
+		offscreenImageMemoryList.back(),
+		1,
+		numLevels);
+
+	createImageView(
+		device,
+		offscreenImages.back(),
+		format,
+		VK_IMAGE_ASPECT_COLOR_BIT,
+		offscreenImageViews.back(),
+		VK_IMAGE_VIEW_TYPE_2D,
+		1,
+		0,
+		numLevels);
+
+	VkImageView imageView = offscreenImageViews.back();
+	std::vector<VkImageView> levelViews;
+
+	for (uint32_t i = 0; i < numLevels; i++)
+	{
+		offscreenImageViews.push_back(VK_NULL_HANDLE);
+
+		createImageView(
+			device,
+			offscreenImages.back(),
+			format,
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			offscreenImageViews.back(),
+			VK_IMAGE_VIEW_TYPE_2D,
+			1,
+			i);
+
+		levelViews.push_back(offscreenImageViews.back());
+	}
+
+	// Levels are picked explicitly and read texel by texel, nothing gets filtered
+	VkSamplerCreateInfo samplerInfo = {};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_NEAREST;
+	samplerInfo.minFilter = VK_FILTER_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.anisotropyEnable = VK_FALSE;
+	samplerInfo.maxAnisotropy = 1;
+	samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+	samplerInfo.unnormalizedCoordinates = VK_FALSE;
+	samplerInfo.compareEnable = VK_FALSE;
+	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.mipLodBias = 0.f;
+	samplerInfo.minLod = 0.f;
+	samplerInfo.maxLod = float(numLevels - 1);
+
+	VkSampler sampler = getSampler(samplerInfo);
+
+	GBufferAttachment attachment = {
+		DEPTH,
+		offscreenImages.back(),
+		imageView,
+		offscreenImageMemoryList.back(),
+		sampler
+	};
+
+	return { attachment, levelViews };
+}
+
+VkSampler VkPool::createShadowSampler(bool depthCompare)
+{
+	// Clamp so that filtering never bleeds across neighbouring tiles at the atlas border.
+	// With depth compare on, each fetch returns the bilinearly weighted result of four comparisons.
+	VkSamplerCreateInfo samplerInfo = {};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = depthCompare ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+	samplerInfo.minFilter = depthCompare ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.anisotropyEnable = VK_FALSE;
+	samplerInfo.maxAnisotropy = 1;
+	samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+	samplerInfo.unnormalizedCoordinates = VK_FALSE;
+	samplerInfo.compareEnable = depthCompare ? VK_TRUE : VK_FALSE;
+	samplerInfo.compareOp = depthCompare ? VK_COMPARE_OP_LESS_OR_EQUAL : VK_COMPARE_OP_ALWAYS;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.mipLodBias = 0.f;
+	samplerInfo.minLod = 0.f;
+	samplerInfo.maxLod = 0.f;
+
+	return getSampler(samplerInfo);
+}
+
+VkSampler VkPool::getSampler(const VkSamplerCreateInfo& createInfo)
+{
+	ObjectKey key;
+	key << createInfo.flags
+		<< createInfo.magFilter
+		<< createInfo.minFilter
+		<< createInfo.mipmapMode
+		<< createInfo.addressModeU
+		<< createInfo.addressModeV
+		<< createInfo.addressModeW
+		<< createInfo.mipLodBias
+		<< createInfo.anisotropyEnable
+		<< createInfo.maxAnisotropy
+		<< createInfo.compareEnable
+		<< createInfo.compareOp
+		<< createInfo.minLod
+		<< createInfo.maxLod
+		<< createInfo.borderColor
+		<< createInfo.unnormalizedCoordinates;
+
+	VkSampler sampler;
+
+	std::lock_guard<std::mutex> lock(objectMutex);
+
+	if (!findCachedObject(samplerCache, key.str(), sampler))
+	{
+		VK_CHECK(vkCreateSampler(device, &createInfo, nullptr, &sampler));
+
+		samplerCache.objects[key.str()] = sampler;
+	}
+
+	return sampler;
+}
+
+VkShaderModule VkPool::getShaderModule(const std::vector<char>& code)
+{
+	// The SPIR-V itself: the same file loaded twice is the same module
+	std::string key(code.begin(), code.end());
+
+	VkShaderModule shaderModule;
+
+	std::lock_guard<std::mutex> lock(objectMutex);
+
+	if (!findCachedObject(shaderModuleCache, key, shaderModule))
+	{
+		createShaderModule(device, code, shaderModule);
+
+		shaderModuleCache.objects[key] = shaderModule;
+	}
+
+	return shaderModule;
+}
+
+VkPipelineLayout VkPool::getPipelineLayout(VkDescriptorSetLayout descriptorSetLayout, const VkPushConstantRange& pushConstants)
+{
+	// Set layouts are cached too, so the handle stands for their contents
+	ObjectKey key;
+	key << descriptorSetLayout << pushConstants;
+
+	VkPipelineLayout pipelineLayout;
+
+	std::lock_guard<std::mutex> lock(objectMutex);
+
+	if (!findCachedObject(pipelineLayoutCache, key.str(), pipelineLayout))
+	{
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = pushConstants.size > 0 ? 1 : 0;
+		pipelineLayoutInfo.pPushConstantRanges = pushConstants.size > 0 ? &pushConstants : nullptr;
+
+		VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout));
+
+		pipelineLayoutCache.objects[key.str()] = pipelineLayout;
+	}
+
+	return pipelineLayout;
+}
+
 void VkPool::setPhysicalDevice()
 {
 	physicalDevice = choosePhysicalDevice(instance, surface);
@@ -829,21 +1404,93 @@ void VkPool::createDevice()
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
 
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
+	// Shadow rendering has no path without these, so there is nothing to fall back to
+	if (!supportedFeatures.geometryShader || !supportedFeatures.multiViewport)
+	{
+		throw std::runtime_error("GPU does not support geometry shaders with multiple viewports, required for shadow rendering!");
+	}
+
 	VkPhysicalDeviceFeatures deviceFeatures = {};
 	// These make ImGui happy
 	deviceFeatures.shaderCullDistance = VK_TRUE;
 	deviceFeatures.shaderClipDistance = VK_TRUE;
+	// Shadow rendering routes each light to its atlas tile from the geometry shader
+	deviceFeatures.geometryShader = VK_TRUE;
+	deviceFeatures.multiViewport = VK_TRUE;
+
+	std::vector<const char*> extensions = deviceExtensions;
+
+	// Bindless material textures, enabled whenever the device has what they need
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+	indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+	// The entry points may be exported even when the instance extension they belong to was not enabled
+	if (physicalDeviceProperties2Enabled &&
+		checkDeviceExtensionSupport(physicalDevice, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) &&
+		checkDeviceExtensionSupport(physicalDevice, VK_KHR_MAINTENANCE3_EXTENSION_NAME))
+	{
+		PFN_vkGetPhysicalDeviceFeatures2KHR getPhysicalDeviceFeatures2 =
+			(PFN_vkGetPhysicalDeviceFeatures2KHR) vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR");
+		PFN_vkGetPhysicalDeviceProperties2KHR getPhysicalDeviceProperties2 =
+			(PFN_vkGetPhysicalDeviceProperties2KHR) vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceProperties2KHR");
+
+		if (getPhysicalDeviceFeatures2 != nullptr && getPhysicalDeviceProperties2 != nullptr)
+		{
+			VkPhysicalDeviceFeatures2KHR features = {};
+			features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+			features.pNext = &indexingFeatures;
+
+			getPhysicalDeviceFeatures2(physicalDevice, &features);
+
+			VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties = {};
+			indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+
+			VkPhysicalDeviceProperties2KHR properties = {};
+			properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+			properties.pNext = &indexingProperties;
+
+			getPhysicalDeviceProperties2(physicalDevice, &properties);
+
+			descriptorIndexingEnabled =
+				indexingFeatures.shaderSampledImageArrayNonUniformIndexing &&
+				indexingFeatures.descriptorBindingSampledImageUpdateAfterBind &&
+				indexingFeatures.descriptorBindingPartiallyBound &&
+				indexingFeatures.runtimeDescriptorArray;
+
+			maxUpdateAfterBindSampledImages = std::min(
+				indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+				indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages);
+		}
+	}
+
+	// Only what is used, everything else the query reported stays off
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT enabledIndexingFeatures = {};
+	enabledIndexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	enabledIndexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+	enabledIndexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+	enabledIndexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+	enabledIndexingFeatures.runtimeDescriptorArray = VK_TRUE;
+
+	if (descriptorIndexingEnabled)
+	{
+		extensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+		extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+	}
 
 	VkDeviceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	createInfo.pNext = descriptorIndexingEnabled ? &enabledIndexingFeatures : nullptr;
 
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 	createInfo.queueCreateInfoCount = (uint32_t) queueCreateInfos.size();
 
 	createInfo.pEnabledFeatures = &deviceFeatures;
 
-	createInfo.enabledExtensionCount = deviceExtensions.size();
-	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	createInfo.enabledExtensionCount = extensions.size();
+	createInfo.ppEnabledExtensionNames = extensions.data();
 
 	if (ENABLE_VALIDATION_LAYERS)
 	{
@@ -861,6 +1508,127 @@ void VkPool::createDevice()
 	vkGetDeviceQueue(device, indices.presentationFamily, 0, &presentationQueue);
 }
 
+void VkPool::createPipelineCache()
+{
+	std::vector<char> initialData = loadPipelineCacheData();
+
+	VkPipelineCacheCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	createInfo.initialDataSize = initialData.size();
+	createInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+
+	VK_CHECK(vkCreatePipelineCache(device, &createInfo, nullptr, &pipelineCache));
+}
+
+// Anything that does not match the current device and driver is dropped rather than handed over, as some drivers
+// do not validate the data themselves
+std::vector<char> VkPool::loadPipelineCacheData()
+{
+	std::ifstream file(PIPELINE_CACHE_PATH, std::ios::ate | std::ios::binary);
+
+	if (!file.is_open())
+	{
+		return std::vector<char>();
+	}
+
+	size_t fileSize = (size_t) file.tellg();
+	PipelineCacheFileHeader fileHeader = {};
+
+	if (fileSize < sizeof(fileHeader))
+	{
+		std::cerr << "Ignoring truncated pipeline cache." << std::endl;
+		return std::vector<char>();
+	}
+
+	file.seekg(0);
+	file.read((char*) &fileHeader, sizeof(fileHeader));
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+	if (fileHeader.magic != PIPELINE_CACHE_MAGIC ||
+		fileHeader.vendorID != properties.vendorID ||
+		fileHeader.deviceID != properties.deviceID ||
+		fileHeader.driverVersion != properties.driverVersion ||
+		memcmp(fileHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0 ||
+		fileHeader.dataSize != fileSize - sizeof(fileHeader))
+	{
+		std::cerr << "Ignoring pipeline cache from another device or driver." << std::endl;
+		return std::vector<char>();
+	}
+
+	std::vector<char> data((size_t) fileHeader.dataSize);
+	file.read(data.data(), data.size());
+
+	// The data itself starts with the Vulkan header, version one: length, version, vendor, device, then the UUID
+	const uint32_t* vkHeader = (const uint32_t*) data.data();
+
+	if (data.size() < 4 * sizeof(uint32_t) + VK_UUID_SIZE ||
+		vkHeader[1] != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+		vkHeader[2] != properties.vendorID ||
+		vkHeader[3] != properties.deviceID ||
+		memcmp(&vkHeader[4], properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+	{
+		std::cerr << "Ignoring pipeline cache with a mismatching header." << std::endl;
+		return std::vector<char>();
+	}
+
+	return data;
+}
+
+// Written next to the previous cache then moved over it, so that a crash halfway never leaves a corrupt file behind
+void VkPool::savePipelineCache()
+{
+	size_t dataSize = 0;
+	VK_CHECK(vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr));
+
+	std::vector<char> data(dataSize);
+	VK_CHECK(vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()));
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+	PipelineCacheFileHeader fileHeader = {};
+	fileHeader.magic = PIPELINE_CACHE_MAGIC;
+	fileHeader.vendorID = properties.vendorID;
+	fileHeader.deviceID = properties.deviceID;
+	fileHeader.driverVersion = properties.driverVersion;
+	memcpy(fileHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+	fileHeader.dataSize = dataSize;
+
+	std::string tempPath = std::string(PIPELINE_CACHE_PATH) + ".tmp";
+	std::ofstream file(tempPath, std::ios::out | std::ios::binary | std::ios::trunc);
+
+	if (!file.is_open())
+	{
+		std::cerr << "Failed to write the pipeline cache." << std::endl;
+		return;
+	}
+
+	file.write((const char*) &fileHeader, sizeof(fileHeader));
+	file.write(data.data(), dataSize);
+	file.close();
+
+	if (file.fail())
+	{
+		std::cerr << "Failed to write the pipeline cache." << std::endl;
+		std::remove(tempPath.c_str());
+		return;
+	}
+
+#ifdef _WIN32
+	bool moved = MoveFileExA(tempPath.c_str(), PIPELINE_CACHE_PATH, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	bool moved = std::rename(tempPath.c_str(), PIPELINE_CACHE_PATH) == 0;
+#endif
+
+	if (!moved)
+	{
+		std::cerr << "Failed to replace the pipeline cache." << std::endl;
+		std::remove(tempPath.c_str());
+	}
+}
+
 void VkPool::createInstance()
 {
 	if (ENABLE_VALIDATION_LAYERS && !checkValidationLayerSupport())
@@ -870,6 +1638,10 @@ void VkPool::createInstance()
 
 	auto extensions = getRequiredExtensions();
 
+	physicalDeviceProperties2Enabled = std::find_if(extensions.begin(), extensions.end(), [](const char* extension) {
+		return strcmp(extension, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0;
+	}) != extensions.end();
+
 	VkApplicationInfo appInfo = {};
 	appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
 	appInfo.pApplicationName = APPLICATION_NAME;
@@ -897,11 +1669,31 @@ void VkPool::createInstance()
 	VK_CHECK(vkCreateInstance(&createInfo, nullptr, &instance));
 }
 
+template<typename T>
+static void printObjectCacheStats(const char* name, const ObjectCache<T>& cache)
+{
+	std::cout << "  " << name << ": " << cache.hits << " hits, " << cache.misses << " misses" << std::endl;
+}
+
+void VkPool::printObjectCacheStats()
+{
+	std::cout << "Object cache:" << std::endl;
+	::printObjectCacheStats("Samplers", samplerCache);
+	::printObjectCacheStats("Shader modules", shaderModuleCache);
+	::printObjectCacheStats("Descriptor set layouts", descriptorSetLayoutCache);
+	::printObjectCacheStats("Pipeline layouts", pipelineLayoutCache);
+	::printObjectCacheStats("Render passes", renderPassCache);
+}
+
 void VkPool::freeResources()
 {
-	for (VkShaderModule shader : shaderModules) { vkDestroyShaderModule(device, shader, nullptr); }
+	savePipelineCache();
+	vkDestroyPipelineCache(device, pipelineCache, nullptr);
+
+	for (auto& shader : shaderModuleCache.objects) { vkDestroyShaderModule(device, shader.second, nullptr); }
 	for (VkSemaphore semaphore : semaphores) { vkDestroySemaphore(device, semaphore, nullptr); }
 	for (VkFence fence : fences) { vkDestroyFence(device, fence, nullptr); }
+	for (VkQueryPool queryPool : queryPools) { vkDestroyQueryPool(device, queryPool, nullptr); }
 	for (VkDescriptorPool descriptorPool : descriptorPools) { vkDestroyDescriptorPool(device, descriptorPool, nullptr); }
 	for (VkDeviceMemory deviceMemory : deviceMemoryList) { vkFreeMemory(device, deviceMemory, nullptr); }
 	for (VkBuffer buffer : buffers) { vkDestroyBuffer(device, buffer, nullptr); }
@@ -909,22 +1701,20 @@ void VkPool::freeResources()
 	for (VkBuffer buffer : indexBuffers) { vkDestroyBuffer(device, buffer, nullptr); }
 	for (VkDeviceMemory deviceMemory : vertexDeviceMemoryList) { vkFreeMemory(device, deviceMemory, nullptr); }
 	for (VkBuffer buffer : vertexBuffers) { vkDestroyBuffer(device, buffer, nullptr); }
-	for (VkSampler sampler : textureSamplers) { vkDestroySampler(device, sampler, nullptr); }
+	for (auto& sampler : samplerCache.objects) { vkDestroySampler(device, sampler.second, nullptr); }
 	for (VkImageView imageView : textureImageViews) { vkDestroyImageView(device, imageView, nullptr); }
 	for (VkDeviceMemory deviceMemory : textureImageMemoryList) { vkFreeMemory(device, deviceMemory, nullptr); }
 	for (VkImage image : textureImages) { vkDestroyImage(device, image, nullptr); }
-	for (VkSampler sampler : depthSamplers) { vkDestroySampler(device, sampler, nullptr); }
 	for (VkImage depthImage : depthImages) { vkDestroyImage(device, depthImage, nullptr); }
 	for (VkImageView depthImageView : depthImageViews) { vkDestroyImageView(device, depthImageView, nullptr); }
 	for (VkDeviceMemory depthImageMemory : depthImageMemoryList) { vkFreeMemory(device, depthImageMemory, nullptr); }
-	for (VkSampler sampler : offscreenImageSamplers) { vkDestroySampler(device, sampler, nullptr); }
 	for (VkImage image : offscreenImages) { vkDestroyImage(device, image, nullptr); }
 	for (VkImageView imageView : offscreenImageViews) { vkDestroyImageView(device, imageView, nullptr); }
 	for (VkDeviceMemory imageMemory : offscreenImageMemoryList) { vkFreeMemory(device, imageMemory, nullptr); }\
 	for (VkPipeline pipeline : pipelines) { vkDestroyPipeline(device, pipeline, nullptr); }
-	for (VkPipelineLayout pipelineLayout : pipelineLayouts) { vkDestroyPipelineLayout(device, pipelineLayout, nullptr); }
-	for (VkDescriptorSetLayout descriptorSetLayout : descriptorSetLayouts) { vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr); }
-	for (VkRenderPass renderPass : renderPasses) { vkDestroyRenderPass(device, renderPass, nullptr); }
+	for (auto& pipelineLayout : pipelineLayoutCache.objects) { vkDestroyPipelineLayout(device, pipelineLayout.second, nullptr); }
+	for (auto& descriptorSetLayout : descriptorSetLayoutCache.objects) { vkDestroyDescriptorSetLayout(device, descriptorSetLayout.second, nullptr); }
+	for (auto& renderPass : renderPassCache.objects) { vkDestroyRenderPass(device, renderPass.second, nullptr); }
 	for (VkFramebuffer framebuffer : framebuffers) { vkDestroyFramebuffer(device, framebuffer, nullptr); }
 	for (VkCommandPool commandPool : commandPools) { vkDestroyCommandPool(device, commandPool, nullptr); }
 	for (VkImageView swapchainImageView : swapchainImageViews) { vkDestroyImageView(device, swapchainImageView, nullptr); }
@@ -1,5 +1,10 @@
 #pragma once
 
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "vulkan\vulkan.h"
@@ -7,9 +12,14 @@
 #include "Config.h"
 #include "GBuffer.h"
 
-#define MAX_DESCRIPTOR_SETS			32
-#define POOL_UNIFORM_BUFFER_SIZE	40
-#define POOL_COMBINED_SAMPLER_SIZE	40
+#define MAX_DESCRIPTOR_SETS			48
+#define POOL_UNIFORM_BUFFER_SIZE	48
+#define POOL_COMBINED_SAMPLER_SIZE	80
+#define POOL_STORAGE_BUFFER_SIZE	16
+#define POOL_STORAGE_IMAGE_SIZE		32
+// Written back on shutdown, next to the executable's working directory
+#define PIPELINE_CACHE_PATH			"pipeline_cache.bin"
+#define PIPELINE_CACHE_MAGIC		0x50435643
 
 struct BufferData {
 	VkBuffer buffer;
@@ -23,11 +33,72 @@ struct ImageData {
 	VkSampler sampler;
 };
 
+// Prefixed to the cache data on disk: the data is only handed back to the driver it came from
+struct PipelineCacheFileHeader {
+	uint32_t magic;
+	uint32_t vendorID;
+	uint32_t deviceID;
+	uint32_t driverVersion;
+	uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+	uint64_t dataSize;
+};
+
 struct PipelineData {
 	VkPipeline pipeline;
 	VkPipelineLayout pipelineLayout;
 };
 
+// constant_id i of the shaders takes the i-th value, ids past the end keep the default of the shader
+typedef std::vector<uint32_t> SpecializationConstants;
+
+struct PipelineOptions {
+	bool positionOnly = false;
+	bool depthWrite = true;
+	VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
+	bool depthTest = true;
+	bool stencilTest = false;
+	// Used for both front and back faces
+	VkStencilOpState stencil = {};
+	bool additiveBlend = false;
+	uint32_t viewportCount = 1;
+	std::vector<VkDynamicState> dynamicStates;
+	// Left at a size of 0 for pipelines without push constants
+	VkPushConstantRange pushConstants = {};
+};
+
+// Pipelines of the same shaders specialized with different constants, each one created the first time it is asked for.
+// The pool still owns them, so that switching back and forth between presets never compiles anything twice
+class PipelinePermutations {
+public:
+	PipelinePermutations() { }
+	PipelinePermutations(std::function<PipelineData(const SpecializationConstants&)> createPermutation) :
+		createPermutation(createPermutation) { }
+
+	PipelineData get(const SpecializationConstants& constants)
+	{
+		std::map<SpecializationConstants, PipelineData>::iterator it = permutations.find(constants);
+
+		if (it == permutations.end())
+		{
+			it = permutations.insert(std::make_pair(constants, createPermutation(constants))).first;
+		}
+
+		return it->second;
+	}
+
+private:
+	std::function<PipelineData(const SpecializationConstants&)> createPermutation;
+	std::map<SpecializationConstants, PipelineData> permutations;
+};
+
+// Objects created once per distinct create info, the key being its contents serialized field by field.
+// Handed out as many times as asked for, destroyed with the pool
+template<typename T>
+struct ObjectCache {
+	std::unordered_map<std::string, T> objects;
+	uint32_t hits = 0;
+	uint32_t misses = 0;
+};
 
 class VkPool {
 public:
@@ -38,6 +109,7 @@ public:
 		createSurface(window);
 		setPhysicalDevice();
 		createDevice();  
+		createPipelineCache();
 		createSwapchain(config->resolution); 
 	}
 
@@ -51,6 +123,12 @@ public:
 	VkInstance getInstance() { return instance; };
 	VkQueue getGraphicsQueue() { return graphicsQueue; }
 	VkQueue getPresentationQueue() { return presentationQueue; }
+	// Shared by every pipeline, including the HUD's
+	VkPipelineCache getPipelineCache() { return pipelineCache; }
+	// Partially bound, update-after-bind arrays of sampled images, indexed non-uniformly
+	bool isDescriptorIndexingEnabled() { return descriptorIndexingEnabled; }
+	// Largest update-after-bind texture array a set and a stage can hold, 0 without descriptor indexing
+	uint32_t getMaxUpdateAfterBindSampledImages() { return maxUpdateAfterBindSampledImages; }
 	std::vector<VkImage>& getSwapchainImages() { return swapchainImages; }
 	VkFormat getSwapchainFormat() { return swapchainFormat; }
 	VkExtent2D getSwapchainExtent() { return swapchainExtent; }
@@ -60,8 +138,15 @@ public:
 		uint32_t bufferDescriptorCount,
 		uint32_t imageSamplerDescriptorCount,
 		uint32_t maxSets = MAX_DESCRIPTOR_SETS);
+	// A single set with a texture array that can be written after it has been bound
+	VkDescriptorPool createBindlessDescriptorPool(
+		uint32_t bufferDescriptorCount,
+		uint32_t storageBufferDescriptorCount,
+		uint32_t textureDescriptorCount);
 	std::vector<BufferData> createUniformBuffer(VkDeviceSize bufferSize, bool createStaging);
+	std::vector<BufferData> createStorageBuffer(VkDeviceSize bufferSize, bool createStaging, bool indirect = false);
 	BufferData createVertexBuffer(std::vector<Vertex> vertices);
+	BufferData createVertexBuffer(std::vector<glm::vec3> positions);
 	BufferData createIndexBuffer(std::vector<uint32_t> indices);
 	ImageData createDepthResources();
 	VkCommandPool createCommandPool();
@@ -72,14 +157,28 @@ public:
 		std::vector<char> vs,
 		std::vector<char> fs,
 		std::vector<char> gs = std::vector<char>(),
-		uint16_t numColorAttachments = GBufferAttachmentType::NUM_TYPES - 1);
-	VkDescriptorSetLayout createDescriptorSetLayout(std::vector<VkDescriptorSetLayoutBinding>& bindings);
+		uint16_t numColorAttachments = GBufferAttachmentType::NUM_TYPES - 1,
+		PipelineOptions options = PipelineOptions());
+	PipelineData createComputePipeline(VkDescriptorSetLayout descriptorSetLayout, std::vector<char> cs,
+		const SpecializationConstants& specializationConstants = SpecializationConstants());
+	// Cached: identical bindings give back the same layout. Binding flags require descriptor indexing,
+	// update-after-bind ones make the layout only allocatable from a bindless pool
+	VkDescriptorSetLayout createDescriptorSetLayout(
+		std::vector<VkDescriptorSetLayoutBinding>& bindings,
+		const std::vector<VkDescriptorBindingFlagsEXT>& bindingFlags = std::vector<VkDescriptorBindingFlagsEXT>());
+	// Cached: identical attachments, subpasses and dependencies give back the same render pass
 	VkRenderPass createRenderPass(VkRenderPassCreateInfo createInfo);
 	VkFramebuffer createFramebuffer(VkFramebufferCreateInfo createInfo);
 	VkImageView createSwapchainImageView(VkImage swapchainImage);
-	ImageData createTextureResources(void* pixels, unsigned int texWidth, unsigned int texHeight, bool highPrec = false);
-	GBufferAttachment createGBufferAttachment(GBufferAttachmentType type, bool toBeSampled = true);
+	ImageData createTextureResources(void* pixels, unsigned int texWidth, unsigned int texHeight, VkFormat format = VK_FORMAT_R8G8B8A8_UNORM);
+	GBufferAttachment createGBufferAttachment(GBufferAttachmentType type, bool toBeSampled = true, bool storage = false, uint32_t downsample = 1);
+	GBufferAttachment createShadowAtlas(uint32_t size);
+	DepthPyramid createDepthPyramid(uint32_t numLevels, uint32_t downsample = 1);
+	VkSampler createShadowSampler(bool depthCompare);
+	VkSampler getSampler(const VkSamplerCreateInfo& createInfo);
+	VkShaderModule getShaderModule(const std::vector<char>& code);
 	VkFence createFence();
+	VkQueryPool createQueryPool(VkQueryType type, uint32_t queryCount);
 
 	void createSwapchain(glm::ivec2 resolution);
 	void createDebugCallback();
@@ -88,6 +187,9 @@ public:
 	void createDevice();
 	void createInstance();
 
+	// Hits and misses since the pool was created, i.e. since the last swapchain recreation
+	void printObjectCacheStats();
+
 private:
 	std::vector<VkSemaphore> semaphores;
 	std::vector<VkDescriptorPool> descriptorPools;
@@ -97,29 +199,32 @@ private:
 	std::vector<VkBuffer> indexBuffers;
 	std::vector<VkDeviceMemory> vertexDeviceMemoryList;
 	std::vector<VkDeviceMemory> indexDeviceMemoryList;
-	std::vector<VkSampler> depthSamplers;
 	std::vector<VkImage> depthImages;
 	std::vector<VkImageView> depthImageViews;
 	std::vector<VkDeviceMemory> depthImageMemoryList;
 	std::vector<VkCommandPool> commandPools;
 	std::vector<VkPipeline> pipelines;
-	std::vector<VkPipelineLayout> pipelineLayouts;
-	std::vector<VkDescriptorSetLayout> descriptorSetLayouts;
-	std::vector<VkRenderPass> renderPasses;
 	std::vector<VkFramebuffer> framebuffers;
 	std::vector<VkImageView> swapchainImageViews;
-	std::vector<VkSampler> textureSamplers;
 	std::vector<VkImage> textureImages;
 	std::vector<VkImageView> textureImageViews;
 	std::vector<VkDeviceMemory> textureImageMemoryList;
 	std::vector<VkImage> offscreenImages;
 	std::vector<VkImageView> offscreenImageViews;
 	std::vector<VkDeviceMemory> offscreenImageMemoryList;
-	std::vector<VkSampler> offscreenImageSamplers;
-	std::vector<VkShaderModule> shaderModules;
 	std::vector<VkFence> fences;
+	std::vector<VkQueryPool> queryPools;
+
+	ObjectCache<VkSampler> samplerCache;
+	ObjectCache<VkShaderModule> shaderModuleCache;
+	ObjectCache<VkDescriptorSetLayout> descriptorSetLayoutCache;
+	ObjectCache<VkPipelineLayout> pipelineLayoutCache;
+	ObjectCache<VkRenderPass> renderPassCache;
+	// Pipelines are compiled from several threads at startup, which all go through the caches and the pipeline list
+	std::mutex objectMutex;
 
 	VkSwapchainKHR swapchain;
+	VkPipelineCache pipelineCache;
 	VkDevice device;
 	VkSurfaceKHR surface;
 	VkDebugReportCallbackEXT debugCallback;
@@ -132,6 +237,14 @@ private:
 	VkExtent2D swapchainExtent;
 	VkQueue graphicsQueue;
 	VkQueue presentationQueue;
-
+	bool physicalDeviceProperties2Enabled = false;
+	bool descriptorIndexingEnabled = false;
+	uint32_t maxUpdateAfterBindSampledImages = 0;
+
+	BufferData createVertexBuffer(const void* vertexData, VkDeviceSize bufferSize);
+	VkPipelineLayout getPipelineLayout(VkDescriptorSetLayout descriptorSetLayout, const VkPushConstantRange& pushConstants);
+	void createPipelineCache();
+	std::vector<char> loadPipelineCacheData();
+	void savePipelineCache();
 	void freeResources();
 };
\ No newline at end of file
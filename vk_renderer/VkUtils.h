@@ -104,6 +104,21 @@ inline std::vector<const char*> getRequiredExtensions()
 		extensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
 	}
 
+	// Optional: needed to query extension features, such as descriptor indexing, on a 1.0 instance
+	uint32_t extensionCount;
+	vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr);
+
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, availableExtensions.data());
+
+	for (const auto& extension : availableExtensions)
+	{
+		if (strcmp(extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0)
+		{
+			extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+		}
+	}
+
 	return extensions;
 }
 
@@ -232,6 +247,23 @@ inline bool checkDeviceExtensionSupport(VkPhysicalDevice device)
 	return requiredExtensions.empty();
 }
 
+inline bool checkDeviceExtensionSupport(VkPhysicalDevice device, const char* extensionName)
+{
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	VK_CHECK(vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data()));
+
+	for (const auto& extension : availableExtensions)
+	{
+		if (strcmp(extension.extensionName, extensionName) == 0)
+			return true;
+	}
+
+	return false;
+}
+
 inline VkSurfaceFormatKHR pickSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats)
 {
 	if (availableFormats.size() == 1 && availableFormats[0].format == VK_FORMAT_UNDEFINED)
@@ -362,7 +394,7 @@ inline std::vector<char> readFile(const std::string& filename)
 
 	if (!file.is_open())
 	{
-		throw std::runtime_error("Failed to open file!");
+		throw std::runtime_error("Failed to open file " + filename + "!");
 	}
 
 	size_t fileSize = (size_t) file.tellg();
@@ -472,11 +504,14 @@ inline void copyBuffer(
 	VkQueue queue, 
 	VkBuffer srcBuffer, 
 	VkBuffer dstBuffer, 
-	VkDeviceSize size)
+	VkDeviceSize size,
+	VkDeviceSize offset = 0)
 {
 	VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
 
 	VkBufferCopy copyRegion = {};
+	copyRegion.srcOffset = offset;
+	copyRegion.dstOffset = offset;
 	copyRegion.size = size;
 	vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
 
@@ -493,7 +528,9 @@ inline void createImage(
 	VkImageUsageFlags usage, 
 	VkMemoryPropertyFlags properties, 
 	VkImage& image, 
-	VkDeviceMemory& imageMemory)
+	VkDeviceMemory& imageMemory,
+	uint32_t arrayLayers = 1,
+	uint32_t mipLevels = 1)
 {
 	VkImageCreateInfo imageInfo = {};
 	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -501,8 +538,8 @@ inline void createImage(
 	imageInfo.extent.width = width;
 	imageInfo.extent.height = height;
 	imageInfo.extent.depth = 1;
-	imageInfo.mipLevels = 1;
-	imageInfo.arrayLayers = 1;
+	imageInfo.mipLevels = mipLevels;
+	imageInfo.arrayLayers = arrayLayers;
 	imageInfo.format = format;
 	imageInfo.tiling = tiling;
 	imageInfo.initialLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
@@ -524,13 +561,36 @@ inline void createImage(
 	VK_CHECK(vkBindImageMemory(device, image, imageMemory, 0));
 }
 
+inline bool hasStencilComponent(VkFormat format)
+{
+	return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
+}
+
+// Only the formats textures are uploaded with
+inline size_t getTexelSize(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_R32G32B32A32_SFLOAT:
+		return 16;
+	case VK_FORMAT_R8G8_SNORM:
+		return 2;
+	case VK_FORMAT_R8G8B8A8_UNORM:
+		return 4;
+	default:
+		throw std::runtime_error("Unsupported texture format!");
+	}
+}
+
 inline void transitionImageLayout(
 	VkDevice device, 
 	VkCommandPool commandPool, 
 	VkQueue queue, 
 	VkImage image, 
 	VkImageLayout oldLayout, 
-	VkImageLayout newLayout)
+	VkImageLayout newLayout,
+	uint32_t layerCount = 1,
+	VkFormat format = VK_FORMAT_UNDEFINED)
 {
 	VkCommandBuffer commandBuffer = beginSingleTimeCommands(device, commandPool);
 
@@ -545,6 +605,11 @@ inline void transitionImageLayout(
 	if (newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL)
 	{
 		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+
+		if (hasStencilComponent(format))
+		{
+			barrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+		}
 	}
 	else
 	{
@@ -554,7 +619,7 @@ inline void transitionImageLayout(
 	barrier.subresourceRange.baseMipLevel = 0;
 	barrier.subresourceRange.levelCount = 1;
 	barrier.subresourceRange.baseArrayLayer = 0;
-	barrier.subresourceRange.layerCount = 1;
+	barrier.subresourceRange.layerCount = layerCount;
 	
 	if (oldLayout == VK_IMAGE_LAYOUT_PREINITIALIZED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)
 	{
@@ -576,6 +641,11 @@ inline void transitionImageLayout(
 		barrier.srcAccessMask = 0;
 		barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 	}
+	else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+	{
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	}
 	else
 	{
 		throw std::invalid_argument("unsupported layout transition!");
@@ -640,19 +710,23 @@ inline void createImageView(
 	VkImage image, 
 	VkFormat format, 
 	VkImageAspectFlags aspectFlags, 
-	VkImageView& imageView)
+	VkImageView& imageView,
+	VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D,
+	uint32_t layerCount = 1,
+	uint32_t baseMipLevel = 0,
+	uint32_t levelCount = 1)
 {
 	VkImageViewCreateInfo viewInfo = {};
 	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	viewInfo.image = image;
-	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.viewType = viewType;
 	viewInfo.format = format;
 	viewInfo.subresourceRange = {};
 	viewInfo.subresourceRange.aspectMask = aspectFlags;
-	viewInfo.subresourceRange.baseMipLevel = 0;
-	viewInfo.subresourceRange.levelCount = 1;
+	viewInfo.subresourceRange.baseMipLevel = baseMipLevel;
+	viewInfo.subresourceRange.levelCount = levelCount;
 	viewInfo.subresourceRange.baseArrayLayer = 0;
-	viewInfo.subresourceRange.layerCount = 1;
+	viewInfo.subresourceRange.layerCount = layerCount;
 
 	VK_CHECK(vkCreateImageView(device, &viewInfo, nullptr, &imageView));
 }
@@ -690,6 +764,15 @@ inline VkFormat findDepthFormat(VkPhysicalDevice physicalDevice)
 		VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
 }
 
+inline VkFormat findDepthStencilFormat(VkPhysicalDevice physicalDevice)
+{
+	return findSupportedFormat(
+		physicalDevice, 
+		{ VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT }, 
+		VK_IMAGE_TILING_OPTIMAL, 
+		VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
+}
+
 inline void updateBuffer(
 	VkDevice device, 
 	VkCommandPool commandPool, 
@@ -698,10 +781,11 @@ inline void updateBuffer(
 	size_t bufferSize,
 	VkDeviceMemory stagingMemory, 
 	VkBuffer buffer,
-	VkBuffer stagingBuffer)
+	VkBuffer stagingBuffer,
+	VkDeviceSize offset = 0)
 {
 	void* data;
-	VK_CHECK(vkMapMemory(device, stagingMemory, 0, bufferSize, 0, &data));
+	VK_CHECK(vkMapMemory(device, stagingMemory, offset, bufferSize, 0, &data));
 	memcpy(data, bufferObject, bufferSize);
 	vkUnmapMemory(device, stagingMemory);
 
@@ -711,7 +795,8 @@ inline void updateBuffer(
 		queue,
 		stagingBuffer,
 		buffer,
-		bufferSize);
+		bufferSize,
+		offset);
 }
 
 inline std::array<VkSubpassDependency, 2> getSubpassDependency(VkAccessFlags accessFlags)
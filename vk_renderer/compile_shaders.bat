@@ -1,35 +1,53 @@
-%cd%\glslangValidator.exe -V shaders/geometry/shader.vert
-%cd%\glslangValidator.exe -V shaders/geometry/shader.frag
+%cd%\glslangValidator.exe -V shaders/geometry/shader.vert || exit /b 1
+%cd%\glslangValidator.exe -V shaders/geometry/shader.frag || exit /b 1
 move /y %cd%\vert.spv %cd%\shaders\geometry\vert.spv
 move /y %cd%\frag.spv %cd%\shaders\geometry\frag.spv
+%cd%\glslangValidator.exe -V shaders/geometry-bindless/shader.vert || exit /b 1
+%cd%\glslangValidator.exe -V shaders/geometry-bindless/shader.frag || exit /b 1
+move /y %cd%\vert.spv %cd%\shaders\geometry-bindless\vert.spv
+move /y %cd%\frag.spv %cd%\shaders\geometry-bindless\frag.spv
 
-%cd%\glslangValidator.exe -V shaders/lighting/shader.vert
-%cd%\glslangValidator.exe -V shaders/lighting/shader.frag
+%cd%\glslangValidator.exe -V shaders/lighting/shader.vert || exit /b 1
+%cd%\glslangValidator.exe -V shaders/lighting/shader.frag || exit /b 1
 move /y %cd%\vert.spv %cd%\shaders\lighting\vert.spv
 move /y %cd%\frag.spv %cd%\shaders\lighting\frag.spv
 
-%cd%\glslangValidator.exe -V shaders/shadow/shader.vert
-%cd%\glslangValidator.exe -V shaders/shadow/shader.frag
+%cd%\glslangValidator.exe -V shaders/cluster/shader.comp || exit /b 1
+move /y %cd%\comp.spv %cd%\shaders\cluster\comp.spv
+
+%cd%\glslangValidator.exe -V shaders/shadow/shader.vert || exit /b 1
+%cd%\glslangValidator.exe -V shaders/shadow/shader.geom || exit /b 1
 move /y %cd%\vert.spv %cd%\shaders\shadow\vert.spv
-move /y %cd%\frag.spv %cd%\shaders\shadow\frag.spv
+move /y %cd%\geom.spv %cd%\shaders\shadow\geom.spv
+
+%cd%\glslangValidator.exe -V shaders/depth/shader.vert || exit /b 1
+move /y %cd%\vert.spv %cd%\shaders\depth\vert.spv
+
+%cd%\glslangValidator.exe -V shaders/ssao-downsample/shader.comp || exit /b 1
+move /y %cd%\comp.spv %cd%\shaders\ssao-downsample\comp.spv
+%cd%\glslangValidator.exe -V shaders/ssao-depth-mips/shader.comp || exit /b 1
+move /y %cd%\comp.spv %cd%\shaders\ssao-depth-mips\comp.spv
+
+%cd%\glslangValidator.exe -V shaders/ssao-main/shader.comp || exit /b 1
+move /y %cd%\comp.spv %cd%\shaders\ssao-main\comp.spv
+%cd%\glslangValidator.exe -V shaders/ssao-hbao/shader.comp || exit /b 1
+move /y %cd%\comp.spv %cd%\shaders\ssao-hbao\comp.spv
+%cd%\glslangValidator.exe -V shaders/ssao-gtao/shader.comp || exit /b 1
+move /y %cd%\comp.spv %cd%\shaders\ssao-gtao\comp.spv
+%cd%\glslangValidator.exe -V shaders/ssao-temporal/shader.comp || exit /b 1
+move /y %cd%\comp.spv %cd%\shaders\ssao-temporal\comp.spv
 
-%cd%\glslangValidator.exe -V shaders/ssao-main/shader.vert
-%cd%\glslangValidator.exe -V shaders/ssao-main/shader.frag
-move /y %cd%\vert.spv %cd%\shaders\ssao-main\vert.spv
-move /y %cd%\frag.spv %cd%\shaders\ssao-main\frag.spv
+%cd%\glslangValidator.exe -V shaders/ssao-blur/shader.comp || exit /b 1
+move /y %cd%\comp.spv %cd%\shaders\ssao-blur\comp.spv
 
-%cd%\glslangValidator.exe -V shaders/ssao-blur/shader.vert
-%cd%\glslangValidator.exe -V shaders/ssao-blur/shader.frag
-move /y %cd%\vert.spv %cd%\shaders\ssao-blur\vert.spv
-move /y %cd%\frag.spv %cd%\shaders\ssao-blur\frag.spv
+%cd%\glslangValidator.exe -V shaders/classify/shader.comp || exit /b 1
+move /y %cd%\comp.spv %cd%\shaders\classify\comp.spv
 
-%cd%\glslangValidator.exe -V shaders/subsurf/shader.vert
-%cd%\glslangValidator.exe -V shaders/subsurf/shader.frag
-move /y %cd%\vert.spv %cd%\shaders\subsurf\vert.spv
-move /y %cd%\frag.spv %cd%\shaders\subsurf\frag.spv
+%cd%\glslangValidator.exe -V shaders/subsurf/shader.comp || exit /b 1
+move /y %cd%\comp.spv %cd%\shaders\subsurf\comp.spv
 
-%cd%\glslangValidator.exe -V shaders/merge/shader.vert
-%cd%\glslangValidator.exe -V shaders/merge/shader.frag
+%cd%\glslangValidator.exe -V shaders/merge/shader.vert || exit /b 1
+%cd%\glslangValidator.exe -V shaders/merge/shader.frag || exit /b 1
 move /y %cd%\vert.spv %cd%\shaders\merge\vert.spv
 move /y %cd%\frag.spv %cd%\shaders\merge\frag.spv
 
@@ -14,6 +14,7 @@ layout (binding = 4) uniform Material {
 	float		opacity;
 	float		translucency;
 	float		subsurfWidth;
+	int			subsurfProfile;
 } material;
 
 layout (location = 0) in vec4 inColor;
@@ -47,5 +48,5 @@ void main()
 	outNormal = vec4(normal, 0);
 	outTangent = vec4(t, 0);
 	outSpecular = vec4(material.ks.xyz, material.ns);
-	outMaterial = vec4(material.translucency, material.subsurfWidth, 0, 0);
+	outMaterial = vec4(material.translucency, material.subsurfWidth, material.subsurfProfile, 0);
 }
@@ -21,8 +21,9 @@ layout(location = 2) out vec2 outTexCoord;
 layout(location = 3) out vec3 outNormal;
 layout(location = 4) out vec3 outTangent;
 
+// Must match bit-for-bit between the depth pre-pass and the G-buffer pass
 out gl_PerVertex {
-    vec4 gl_Position;
+    invariant vec4 gl_Position;
 };
 
 void main() {
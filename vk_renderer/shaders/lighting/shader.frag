@@ -4,15 +4,48 @@
 
 #define PI 3.14159265359
 
-#define MAX_NUM_LIGHTS	4
+#define MAX_NUM_SHADOWED_LIGHTS	4
+
+#define CLUSTER_GRID_X			16
+#define CLUSTER_GRID_Y			9
+#define CLUSTER_GRID_Z			24
+#define MAX_LIGHTS_PER_CLUSTER	128
+
+#define CAMERA_NEAR	1.f
+#define CAMERA_FAR	10.f
 
 #define TRANSMIT_INV_SCALE	180.f
 #define SHRINKING_SCALE		.005f
 
+#define SHADOW_NORMAL_OFFSET	.005f
+
+#define TRANSMIT_LUT_MAX_DIST	8.f
+
+// Bilateral weights of the reduced-resolution AO upsample
+#define AO_UPSAMPLE_DEPTH_TOLERANCE	.05f
+#define AO_UPSAMPLE_NORMAL_POWER	8.f
+// Keeps texels the bilinear footprint misses as a fallback when the others are rejected
+#define AO_UPSAMPLE_MIN_WEIGHT		.0001f
+
+#define CLASSIFY_TILE_SIZE		16
+#define TILE_CLASS_BACKGROUND	0
+#define TILE_CLASS_TRANSLUCENT	2
+
 struct Light {
 	vec4 pos;
 	vec4 ke;
+};
+
+struct ShadowedLight {
 	mat4 mat;
+	vec4 atlasRect;
+	// Fitted near and far planes, then the range the transmittance scale is measured in
+	vec4 depthRange;
+};
+
+struct Cluster {
+	uint numLights;
+	uint lightIndices[MAX_LIGHTS_PER_CLUSTER];
 };
 
 layout(binding = 0) uniform sampler2D samplerColor;
@@ -24,44 +57,186 @@ layout(binding = 5) uniform sampler2D samplerMaterial;
 layout(binding = 6) uniform sampler2D samplerDepth;
 layout(binding = 7) uniform Camera {
 	vec4 pos;
+	mat4 view;
+	mat4 proj;
 } camera;
 layout(binding = 8) uniform Scene {
 	vec4 ka;
-	Light lights[MAX_NUM_LIGHTS];
+	ShadowedLight shadows[MAX_NUM_SHADOWED_LIGHTS];
 	int numLights;
+	int pcfRadius;
+	int lightVolumes;
 } scene;
-layout(binding = 9) uniform sampler2D samplerShadows[MAX_NUM_LIGHTS];
+layout(binding = 9) uniform sampler2D samplerShadows;
 layout(binding = 10) uniform sampler2D samplerVisibility;
+layout(binding = 11) uniform sampler2DShadow samplerShadowsCompare;
+layout(std430, binding = 12) readonly buffer Lights {
+	Light lights[];
+};
+layout(std430, binding = 13) readonly buffer Clusters {
+	Cluster clusters[];
+};
+// Rows: subsurface profiles, columns: square root of the scaled distance over TRANSMIT_LUT_MAX_DIST
+layout(binding = 14) uniform sampler2D samplerTransmittance;
+// Written by the classification pass, one class per screen tile
+layout(std430, binding = 15) readonly buffer TileClasses {
+	uint tileClasses[];
+};
 
 layout(location = 0) in vec2 inTexCoord;
+layout(location = 1) in flat int inLightIndex;
 layout(location = 0) out vec4 outColor;
 layout(location = 1) out vec4 outSpeculars;
 
-vec3 convolute(float scaledDist) {
-	float dd = -scaledDist * scaledDist;
+vec3 convolute(float scaledDist, float lutRow) {
+	float lutSize = float(textureSize(samplerTransmittance, 0).x);
+	float u = clamp(sqrt(scaledDist / TRANSMIT_LUT_MAX_DIST), 0.5f / lutSize, 1.f - 0.5f / lutSize);
 
-	return	vec3(0.233f, 0.455f, 0.649f) * exp(dd / 0.0064f) +
-			vec3(0.1f,   0.336f, 0.344f) * exp(dd / 0.0484f) +
-			vec3(0.118f, 0.198f, 0.0f)   * exp(dd / 0.187f)  +
-			vec3(0.113f, 0.007f, 0.007f) * exp(dd / 0.567f)  +
-			vec3(0.358f, 0.004f, 0.0f)   * exp(dd / 1.99f)   +
-			vec3(0.078f, 0.0f,   0.0f)   * exp(dd / 7.41f);
+	return texture(samplerTransmittance, vec2(u, lutRow)).rgb;
 }
 
-vec3 transmittance(vec3 pos, vec3 norm, vec3 l, mat4 lightMat, sampler2D shadowMap, float translucency, float subsurfWidth) {
+// Each light has its own fitted projection: bring its depth back to the reference range
+// so that thickness is measured the same way for every light
+float toReferenceDepth(float depth, vec4 depthRange) {
+	float near = depthRange.x;
+	float far = depthRange.y;
+	float linearDepth = near * far / (far - depth * (far - near));
+
+	float refNear = depthRange.z;
+	float refFar = depthRange.w;
+
+	return refFar * (linearDepth - refNear) / (linearDepth * (refFar - refNear));
+}
+
+// Each tap is a hardware 2x2 PCF fetch, taps are kept inside the light's atlas tile
+float shadowVisibility(vec3 pos, vec3 norm, mat4 lightMat, vec4 atlasRect) {
+	vec4 shadowPos = lightMat * vec4(pos + norm * SHADOW_NORMAL_OFFSET, 1);
+	vec3 shadowCoords = shadowPos.xyz / shadowPos.w;
+
+	if (any(greaterThan(abs(shadowCoords.xy), vec2(1))) || shadowCoords.z > 1)
+		return 1;
+
+	vec2 texelSize = 1.f / vec2(textureSize(samplerShadowsCompare, 0));
+	vec2 tileMin = atlasRect.xy + texelSize * 0.5;
+	vec2 tileMax = atlasRect.xy + atlasRect.zw - texelSize * 0.5;
+	vec2 uv = (shadowCoords.xy * 0.5 + 0.5) * atlasRect.zw + atlasRect.xy;
+
+	float visibility = 0;
+	for (int x = -scene.pcfRadius; x <= scene.pcfRadius; x++) {
+		for (int y = -scene.pcfRadius; y <= scene.pcfRadius; y++) {
+			vec2 tapUV = clamp(uv + vec2(x, y) * texelSize, tileMin, tileMax);
+			visibility += texture(samplerShadowsCompare, vec3(tapUV, shadowCoords.z));
+		}
+	}
+
+	float diameter = 2 * scene.pcfRadius + 1;
+
+	return visibility / (diameter * diameter);
+}
+
+vec3 transmittance(vec3 pos, vec3 norm, vec3 l, mat4 lightMat, vec4 atlasRect, vec4 depthRange, float translucency, float subsurfWidth,
+	float lutRow) {
 	float scale = TRANSMIT_INV_SCALE * (1.f - translucency) / subsurfWidth;
 	vec4 shadowPos = lightMat * vec4(pos - norm * SHRINKING_SCALE, 1);
 	vec3 shadowCoords = shadowPos.xyz / shadowPos.w;
 
-	float d1 = texture(shadowMap, shadowCoords.xy * 0.5 + 0.5).r;
-	float d2 = shadowCoords.z;
+	// Stay inside the light's tile, neighbouring tiles belong to other lights
+	vec2 shadowUV = clamp(shadowCoords.xy * 0.5 + 0.5, 0.f, 1.f) * atlasRect.zw + atlasRect.xy;
+
+	float d1 = toReferenceDepth(texture(samplerShadows, shadowUV).r, depthRange);
+	float d2 = toReferenceDepth(shadowCoords.z, depthRange);
 	float scaledDist = scale * abs(d1 - d2);
 
-	vec3 profile = convolute(scaledDist);
+	vec3 profile = convolute(scaledDist, lutRow);
 
 	return profile * clamp(0.3f + dot(l, -norm), 0.f, 1.f);
 }
 
+// Same froxel layout the cluster pass binned the lights into
+uint clusterIndex(vec2 texCoord, vec3 position) {
+	float depth = -(camera.view * vec4(position, 1)).z;
+	int slice = int(floor(log(depth / CAMERA_NEAR) / log(CAMERA_FAR / CAMERA_NEAR) * CLUSTER_GRID_Z));
+	uvec2 tile = min(uvec2(texCoord * vec2(CLUSTER_GRID_X, CLUSTER_GRID_Y)), uvec2(CLUSTER_GRID_X - 1, CLUSTER_GRID_Y - 1));
+
+	return tile.x + tile.y * CLUSTER_GRID_X + uint(clamp(slice, 0, CLUSTER_GRID_Z - 1)) * CLUSTER_GRID_X * CLUSTER_GRID_Y;
+}
+
+// Each reduced-resolution AO texel stands for the first full-resolution pixel of its block, whose G-buffer data
+// is compared to the current pixel's. Texels across a depth or normal discontinuity get no weight
+float upsampleVisibility(vec3 position, vec3 normal) {
+	ivec2 lowSize = textureSize(samplerVisibility, 0);
+	ivec2 fullSize = textureSize(samplerDepth, 0);
+
+	if (lowSize == fullSize)
+		return texture(samplerVisibility, inTexCoord).r;
+
+	ivec2 scale = (fullSize + lowSize - 1) / lowSize;
+	float depth = -(camera.view * vec4(position, 1)).z;
+
+	vec2 coord = vec2(ivec2(gl_FragCoord.xy)) / vec2(scale);
+	ivec2 base = ivec2(floor(coord));
+	vec2 f = coord - vec2(base);
+
+	float sum = 0;
+	float weightSum = 0;
+
+	for (int y = 0; y < 2; y++) {
+		for (int x = 0; x < 2; x++) {
+			ivec2 lowPixel = min(base + ivec2(x, y), lowSize - 1);
+			ivec2 guidePixel = min(lowPixel * scale, fullSize - 1);
+
+			float bilinear = (x == 0 ? 1 - f.x : f.x) * (y == 0 ? 1 - f.y : f.y);
+			float guideDepth = -(camera.view * vec4(texelFetch(samplerPosition, guidePixel, 0).xyz, 1)).z;
+			float depthWeight = exp(-abs(guideDepth - depth) / (AO_UPSAMPLE_DEPTH_TOLERANCE * depth));
+			float normalWeight = pow(max(dot(texelFetch(samplerNormal, guidePixel, 0).xyz, normal), 0), AO_UPSAMPLE_NORMAL_POWER);
+			float weight = max(bilinear, AO_UPSAMPLE_MIN_WEIGHT) * depthWeight * normalWeight;
+
+			sum += weight * texelFetch(samplerVisibility, lowPixel, 0).r;
+			weightSum += weight;
+		}
+	}
+
+	return weightSum > 0 ? sum / weightSum : texture(samplerVisibility, inTexCoord).r;
+}
+
+uint tileClass() {
+	uint numTilesX = (textureSize(samplerDepth, 0).x + CLASSIFY_TILE_SIZE - 1) / CLASSIFY_TILE_SIZE;
+	uvec2 tile = uvec2(gl_FragCoord.xy) / CLASSIFY_TILE_SIZE;
+
+	return tileClasses[tile.y * numTilesX + tile.x];
+}
+
+void shadeLight(uint i, vec3 position, vec3 normal, vec3 kd, vec3 ks, float ns, float translucency, float subsurfWidth,
+	float lutRow, bool transmits, inout vec3 color, inout vec3 speculars) {
+	vec3 lightPos = lights[i].pos.xyz;
+
+	// Past the attenuation radius, which is also what light volumes and clusters are sized with
+	if (length(lightPos - position) > lights[i].pos.w)
+		return;
+
+	vec3 lightKe = lights[i].ke.rgb / pow(length(lightPos - position), 2);
+	int shadowIndex = int(lights[i].ke.w);
+	vec3 lightVec = normalize(lightPos - position);
+	vec3 viewVec = normalize(camera.pos.xyz - position);
+	vec3 h = normalize(viewVec + lightVec);
+	float shadow = 1;
+	vec3 kt = vec3(0);
+
+	// Lights past the shadow budget are neither occluded nor transmitted
+	if (shadowIndex >= 0) {
+		ShadowedLight shadowed = scene.shadows[shadowIndex];
+		shadow = shadowVisibility(position, normal, shadowed.mat, shadowed.atlasRect);
+
+		if (transmits)
+			kt = transmittance(position, normal, lightVec, shadowed.mat, shadowed.atlasRect, shadowed.depthRange, translucency, subsurfWidth, lutRow);
+	}
+
+	vec3 lightScale = shadow * lightKe * max(0.0, dot(lightVec, normal));
+	speculars += lightScale * (ks * (ns + 8) / (8 * PI) * pow(max(0.0, dot(h, normal)), ns));
+	vec3 lightMult = lightScale * (kd / PI) + lightKe * kt;
+	color += lightMult;
+}
+
 void main() {
 	vec3 kd = texture(samplerColor, inTexCoord).rgb;
     vec3 position = texture(samplerPosition, inTexCoord).xyz;
@@ -71,23 +246,41 @@ void main() {
 	float ns = texture(samplerSpecular, inTexCoord).a;
 	float translucency = texture(samplerMaterial, inTexCoord).r;
 	float subsurfWidth = texture(samplerMaterial, inTexCoord).g;
-	float visibility = texture(samplerVisibility, inTexCoord).r;
-	vec3 color = kd * scene.ka.rgb;
+	// Profiles the LUT has no row for fall back to the default one
+	int profile = int(texture(samplerMaterial, inTexCoord).b + 0.5f);
+	int lutRows = textureSize(samplerTransmittance, 0).y;
+	float lutRow = (float(profile < lutRows ? profile : 0) + 0.5f) / float(lutRows);
+	float visibility = upsampleVisibility(position, normal);
+	vec3 color = vec3(0);
 	vec3 speculars = vec3(0);
 
-    for(int i = 0; i < scene.numLights; i++) {
-		vec3 lightPos = scene.lights[i].pos.xyz;
-		vec3 lightKe = scene.lights[i].ke.rgb / pow(length(lightPos - position), 2);
-		mat4 lightMat = scene.lights[i].mat;
-        vec3 lightVec = normalize(lightPos - position);
-        vec3 viewVec = normalize(camera.pos.xyz - position);
-        vec3 h = normalize(viewVec + lightVec);
-		vec3 lightScale = lightKe * max(0.0, dot(lightVec, normal));
-		vec3 kt = transmittance(position, normal, lightVec, lightMat, samplerShadows[i], translucency, subsurfWidth);
-		speculars += lightScale * (ks * (ns + 8) / (8 * PI) * pow(max(0.0, dot(h, normal)), ns));
-		vec3 lightMult = lightScale * (kd / PI) + lightKe * kt;
-		color += lightMult;
-    }
+	// Whole tiles take the same path: no geometry means no lights, no translucent pixel means no transmittance
+	uint tile = tileClass();
+	bool transmits = tile == TILE_CLASS_TRANSLUCENT && subsurfWidth > 0;
+
+	if (scene.lightVolumes == 0) {
+		color = kd * scene.ka.rgb;
+
+		if (tile == TILE_CLASS_BACKGROUND) {
+			outColor = vec4(color * visibility, 1);
+			outSpeculars = vec4(0, 0, 0, 1);
+			return;
+		}
+
+		// Only the lights binned into this pixel's cluster can reach it
+		uint cluster = clusterIndex(inTexCoord, position);
+
+		for(uint c = 0; c < clusters[cluster].numLights; c++) {
+			shadeLight(clusters[cluster].lightIndices[c], position, normal, kd, ks, ns, translucency, subsurfWidth, lutRow, transmits, color, speculars);
+		}
+	}
+	else if (inLightIndex == 0) {
+		color = kd * scene.ka.rgb;
+	}
+	else if (tile != TILE_CLASS_BACKGROUND) {
+		// Blended on top of the ambient term, one volume per light
+		shadeLight(uint(inLightIndex - 1), position, normal, kd, ks, ns, translucency, subsurfWidth, lutRow, transmits, color, speculars);
+	}
 
 	outColor = vec4(color * visibility, 1);
 	outSpeculars = vec4(speculars * visibility, 1);
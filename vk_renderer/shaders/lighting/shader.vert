@@ -1,18 +1,103 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+#define CAMERA_NEAR	1.f
+#define CAMERA_FAR	10.f
+
+struct Light {
+	vec4 pos;
+	vec4 ke;
+};
+
+layout(binding = 7) uniform Camera {
+	vec4 pos;
+	mat4 view;
+	mat4 proj;
+} camera;
+layout(std430, binding = 12) readonly buffer Lights {
+	Light lights[];
+};
+
 layout (location = 1) in vec3 inPosition;
 layout (location = 2) in vec2 inTexCoord;
 
 layout (location = 0) out vec2 outTexCoord;
+// 0: ambient (and clustered lights), otherwise 1 + index of the light whose volume is drawn
+layout (location = 1) out flat int outLightIndex;
 
 out gl_PerVertex {
 	vec4 gl_Position;
 };
 
+// Screen rectangle covered by the light's attenuation sphere and the depth of its nearest point,
+// false if it cannot affect any pixel
+bool lightVolume(Light light, out vec2 ndcMin, out vec2 ndcMax, out float nearDepth) {
+	vec3 lightPos = light.pos.xyz;
+	float radius = light.pos.w;
+	float depth = -(camera.view * vec4(lightPos, 1)).z;
+
+	ndcMin = vec2(-1);
+	ndcMax = vec2(1);
+	nearDepth = 0;
+
+	if (depth + radius < CAMERA_NEAR || depth - radius > CAMERA_FAR)
+		return false;
+
+	// Stored depth is the projected one, so project the sphere's nearest view depth
+	vec4 nearClip = camera.proj * vec4(0, 0, -max(depth - radius, CAMERA_NEAR), 1);
+	nearDepth = nearClip.z / nearClip.w;
+
+	// The rectangle is only meaningful when the whole sphere lies in front of the camera
+	if (depth - radius < CAMERA_NEAR)
+		return true;
+
+	mat4 viewProj = camera.proj * camera.view;
+	vec2 cornerMin = vec2(1);
+	vec2 cornerMax = vec2(-1);
+
+	for (int c = 0; c < 8; c++) {
+		vec3 corner = lightPos + radius * vec3((c & 1) != 0 ? 1 : -1, (c & 2) != 0 ? 1 : -1, (c & 4) != 0 ? 1 : -1);
+		vec4 clip = viewProj * vec4(corner, 1);
+
+		// A corner of the bounding cube can still be behind the camera
+		if (clip.w < CAMERA_NEAR)
+			return true;
+
+		vec2 ndc = clip.xy / clip.w;
+		cornerMin = min(cornerMin, ndc);
+		cornerMax = max(cornerMax, ndc);
+	}
+
+	ndcMin = clamp(cornerMin, vec2(-1), vec2(1));
+	ndcMax = clamp(cornerMax, vec2(-1), vec2(1));
+
+	return all(lessThan(ndcMin, ndcMax));
+}
+
 void main() 
 {
-	outTexCoord = inTexCoord;
+	outLightIndex = gl_InstanceIndex;
+
+	if (gl_InstanceIndex == 0) {
+		outTexCoord = inTexCoord;
+		gl_Position = vec4(inPosition.xy, 0, 1);
+		return;
+	}
+
+	vec2 ndcMin;
+	vec2 ndcMax;
+	float nearDepth;
+
+	// Lights out of view collapse their quad, which then covers no pixel
+	if (!lightVolume(lights[gl_InstanceIndex - 1], ndcMin, ndcMax, nearDepth)) {
+		outTexCoord = vec2(0);
+		gl_Position = vec4(-1, -1, 0, 1);
+		return;
+	}
 
-	gl_Position = vec4(inPosition.xy, 0, 1);
-}
\ No newline at end of file
+	// The quad is shrunk to the light's rectangle and pushed to its nearest depth,
+	// so that the depth test rejects the pixels in front of the volume
+	vec2 ndc = mix(ndcMin, ndcMax, inPosition.xy * 0.5 + 0.5);
+	outTexCoord = ndc * 0.5 + 0.5;
+	gl_Position = vec4(ndc, nearDepth, 1);
+}
@@ -2,14 +2,81 @@
 #extension GL_ARB_separate_shader_objects : enable
 #extension GL_ARB_shading_language_420pack : enable
 
+#define STENCIL_SUBSURF_BIT	0x2
+// Bilateral weights of the reduced-resolution SSS upsample
+#define UPSAMPLE_NORMAL_POWER	8.0f
+#define UPSAMPLE_MIN_WIDTH		0.001f
+// Keeps texels the bilinear footprint misses as a fallback when the others are rejected
+#define UPSAMPLE_MIN_WEIGHT		0.0001f
+
 layout(location = 0) in vec2 inTexCoord;
 layout(location = 0) out vec4 outColor;
 
 layout(binding = 0) uniform sampler2D samplerColor;
 layout(binding = 1) uniform sampler2D samplerSpeculars;
+layout(binding = 2) uniform sampler2D samplerUnblurred;
+layout(binding = 3) uniform usampler2D samplerStencil;
+layout(binding = 4) uniform sampler2D samplerPosition;
+layout(binding = 5) uniform sampler2D samplerNormal;
+layout(binding = 6) uniform sampler2D samplerMaterial;
+
+bool isSubsurf(ivec2 pixel) {
+	return (texelFetch(samplerStencil, pixel, 0).r & STENCIL_SUBSURF_BIT) != 0;
+}
+
+// Each reduced-resolution texel stands for the first full-resolution pixel of its block, whose G-buffer data
+// is compared to the current pixel's. Texels across a depth or normal discontinuity, or that the blurs
+// left unwritten, get no weight
+vec3 upsample(ivec2 pixel, vec3 unblurred) {
+	ivec2 lowSize = textureSize(samplerColor, 0);
+	ivec2 scale = (textureSize(samplerUnblurred, 0) + lowSize - 1) / lowSize;
+
+	vec3 position = texelFetch(samplerPosition, pixel, 0).xyz;
+	vec3 normal = texelFetch(samplerNormal, pixel, 0).xyz;
+	// Distances are judged against the scattering width, the scale at which the blur itself works
+	float width = max(texelFetch(samplerMaterial, pixel, 0).g, UPSAMPLE_MIN_WIDTH);
+
+	vec2 coord = vec2(pixel) / vec2(scale);
+	ivec2 base = ivec2(floor(coord));
+	vec2 f = coord - vec2(base);
+
+	vec3 sum = vec3(0);
+	float weightSum = 0;
+
+	for (int y = 0; y < 2; y++) {
+		for (int x = 0; x < 2; x++) {
+			ivec2 lowPixel = min(base + ivec2(x, y), lowSize - 1);
+			ivec2 guidePixel = lowPixel * scale;
+
+			if (!isSubsurf(guidePixel))
+				continue;
+
+			float bilinear = (x == 0 ? 1 - f.x : f.x) * (y == 0 ? 1 - f.y : f.y);
+			float dist = length(texelFetch(samplerPosition, guidePixel, 0).xyz - position);
+			float depthWeight = exp(-dist / width);
+			float normalWeight = pow(max(dot(texelFetch(samplerNormal, guidePixel, 0).xyz, normal), 0), UPSAMPLE_NORMAL_POWER);
+			float weight = max(bilinear, UPSAMPLE_MIN_WEIGHT) * depthWeight * normalWeight;
+
+			sum += weight * texelFetch(samplerColor, lowPixel, 0).rgb;
+			weightSum += weight;
+		}
+	}
+
+	return weightSum > 0 ? sum / weightSum : unblurred;
+}
 
 void main() {
-	vec3 diffuse = texture(samplerColor, inTexCoord).rgb;
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	vec3 diffuse = texture(samplerUnblurred, inTexCoord).rgb;
+
+	// The blurs only write translucent pixels, everything else comes straight from lighting
+	if (isSubsurf(pixel)) {
+		if (textureSize(samplerColor, 0) == textureSize(samplerUnblurred, 0))
+			diffuse = texture(samplerColor, inTexCoord).rgb;
+		else
+			diffuse = upsample(pixel, diffuse);
+	}
+
 	vec3 speculars = texture(samplerSpeculars, inTexCoord).rgb;
 
 	outColor = vec4(diffuse + speculars, 1);
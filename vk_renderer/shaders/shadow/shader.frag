@@ -1,4 +0,0 @@
-#version 450
-#extension GL_ARB_separate_shader_objects : enable
-
-void main() { }
\ No newline at end of file
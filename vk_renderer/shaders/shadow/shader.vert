@@ -1,13 +1,11 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout(binding = 0) uniform Camera {
-	mat4 view;
-	mat4 proj;
-} camera;
-layout(binding = 1) uniform Mesh {
+// Shared with the geometry stage, which reads the light mask
+layout(push_constant) uniform Draw {
 	mat4 model;
-} mesh;
+	uint lightMask;
+} draw;
 
 layout(location = 1) in vec3 inPosition;
 
@@ -15,6 +13,7 @@ out gl_PerVertex {
     vec4 gl_Position;
 };
 
+// Light transforms are applied per tile in the geometry shader.
 void main() {
-	gl_Position = camera.proj * camera.view * mesh.model * vec4(inPosition, 1);
+	gl_Position = draw.model * vec4(inPosition, 1);
 }
\ No newline at end of file